@@ -11,15 +11,20 @@ namespace flexps {
 
 struct Control {};
 
-enum class Flag : char { kExit, kBarrier, kResetWorkerInModel, kClock, kAdd, kAddChunk, kGet, kGetChunk, kGetReply, kGetChunkReply, kOther };
-static const char* FlagName[] = {"kExit", "kBarrier", "kResetWorkerInModel", "kClock", "kAdd", "kAddChunk", "kGet", "kGetChunk", "kGetReply", "kGetChunkReply","kOther"};
+enum class Flag : char { kExit, kBarrier, kResetWorkerInModel, kClock, kAdd, kAddChunk, kGet, kGetChunk, kGetReply, kGetChunkReply, kGetReplica, kReplicaSync, kRepartition, kLoadReport, kMigrate, kQuorumClose, kLayout, kOther };
+static const char* FlagName[] = {"kExit", "kBarrier", "kResetWorkerInModel", "kClock", "kAdd", "kAddChunk", "kGet", "kGetChunk", "kGetReply", "kGetChunkReply", "kGetReplica", "kReplicaSync", "kRepartition", "kLoadReport", "kMigrate", "kQuorumClose", "kLayout", "kOther"};
 
 struct Meta {
   int sender;
   int recver;
   int model_id;
   Flag flag;  // {kExit, kBarrier, kResetWorkerInModel, kClock, kAdd, kGet}
-  uint32_t version;
+  // On a Get of a KVClientTable, the clock of the sender, see KVTableBox::GetClock
+  uint32_t version = 0;
+  // Set by the client on a Get to request a key-less reply: the reply carries this id and only the values
+  uint32_t req_id = 0;
+  // The version of the layout the request is sliced with, see KVEngine::EnableOnlineRebalance
+  uint32_t layout_version = 0;
 
   std::string DebugString() const {
     std::stringstream ss;
@@ -29,6 +34,8 @@ struct Meta {
     ss << ", model_id: " << model_id;
     ss << ", flag: " << FlagName[static_cast<int>(flag)];
     ss << ", version: " << version;
+    ss << ", req_id: " << req_id;
+    ss << ", layout_version: " << layout_version;
     ss << "}";
     return ss.str();
   }
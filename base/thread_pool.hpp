@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/threadsafe_queue.hpp"
+
+#include "glog/logging.h"
+
+namespace flexps {
+
+/*
+ * A fixed number of threads running the submitted tasks in FIFO order.
+ * The destructor waits for the submitted tasks to finish.
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(int num_threads) {
+    CHECK_GT(num_threads, 0);
+    for (int i = 0; i < num_threads; ++i) {
+      threads_.push_back(std::thread([this] { Main(); }));
+    }
+  }
+  ~ThreadPool() {
+    // An empty task stops one thread
+    for (size_t i = 0; i < threads_.size(); ++i) {
+      tasks_.Push(std::function<void()>());
+    }
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void Submit(std::function<void()> task) {
+    CHECK(task);
+    tasks_.Push(std::move(task));
+  }
+
+  int GetNumThreads() const { return threads_.size(); }
+
+  /*
+   * Run fn(0), ..., fn(num_tasks - 1) on the pool threads and the calling thread, and return when all are done.
+   * The tasks are taken one by one from a shared counter, so the threads that finish early take over the rest.
+   * Must not be called from a pool thread.
+   */
+  void ParallelFor(size_t num_tasks, const std::function<void(size_t)>& fn) {
+    struct State {
+      std::atomic<size_t> next{0};
+      std::atomic<size_t> done{0};
+      std::mutex mu;
+      std::condition_variable cv;
+    };
+    if (num_tasks == 0)
+      return;
+    // A helper that starts after all the tasks are taken only touches state, which it shares
+    auto state = std::make_shared<State>();
+    auto run = [state, &fn, num_tasks]() {
+      size_t i;
+      while ((i = state->next++) < num_tasks) {
+        fn(i);
+        if (++state->done == num_tasks) {
+          std::lock_guard<std::mutex> lk(state->mu);
+          state->cv.notify_all();
+        }
+      }
+    };
+    size_t num_helpers = std::min(threads_.size(), num_tasks - 1);
+    for (size_t i = 0; i < num_helpers; ++i) {
+      Submit(run);
+    }
+    run();
+    std::unique_lock<std::mutex> lk(state->mu);
+    state->cv.wait(lk, [&state, num_tasks]() { return state->done == num_tasks; });
+  }
+
+ private:
+  void Main() {
+    while (true) {
+      std::function<void()> task;
+      tasks_.WaitAndPop(&task);
+      if (!task)
+        break;
+      task();
+    }
+  }
+
+  ThreadsafeQueue<std::function<void()>> tasks_;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace flexps
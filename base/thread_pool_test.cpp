@@ -0,0 +1,53 @@
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "base/thread_pool.hpp"
+
+#include <atomic>
+
+namespace flexps {
+namespace {
+
+class TestThreadPool : public testing::Test {
+ public:
+  TestThreadPool() {}
+  ~TestThreadPool() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+TEST_F(TestThreadPool, Construct) {
+  ThreadPool pool(3);
+  EXPECT_EQ(pool.GetNumThreads(), 3);
+}
+
+TEST_F(TestThreadPool, Submit) {
+  std::atomic<int> count(0);
+  {
+    ThreadPool pool(4);
+    for (int i = 0; i < 100; ++i) {
+      pool.Submit([&count]() { count += 1; });
+    }
+  }  // waits for the tasks
+  EXPECT_EQ(count, 100);
+}
+
+TEST_F(TestThreadPool, ParallelFor) {
+  ThreadPool pool(3);
+  std::vector<int> hits(1000, 0);
+  for (int round = 0; round < 10; ++round) {
+    pool.ParallelFor(hits.size(), [&hits](size_t i) { hits[i] += 1; });
+  }
+  for (auto hit : hits)
+    EXPECT_EQ(hit, 10);
+  // Fewer tasks than threads
+  std::atomic<int> count(0);
+  pool.ParallelFor(1, [&count](size_t) { count += 1; });
+  pool.ParallelFor(0, [&count](size_t) { count += 1; });
+  EXPECT_EQ(count, 1);
+}
+
+}  // namespace
+}  // namespace flexps
@@ -31,6 +31,16 @@ class ThreadsafeQueue {
     queue_.pop();
   }
 
+  // Return false if the queue is empty
+  bool TryPop(T* elem) {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (queue_.empty())
+      return false;
+    *elem = std::move(queue_.front());
+    queue_.pop();
+    return true;
+  }
+
   int Size() {
     std::lock_guard<std::mutex> lk(mu_);
     return queue_.size();
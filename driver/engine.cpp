@@ -7,10 +7,11 @@
 
 namespace flexps {
 
-void Engine::StartEverything(int num_server_thread_per_node) {
+void Engine::StartEverything(int num_server_thread_per_node, int num_reader_threads_per_node,
+                             int num_executors_per_server_thread, int num_worker_helper_threads_per_node) {
   // Create IdMapper
   id_mapper_.reset(new SimpleIdMapper(node_, nodes_));
-  id_mapper_->Init(num_server_thread_per_node);
+  id_mapper_->Init(num_server_thread_per_node, num_worker_helper_threads_per_node);
   
   // Start mailbox
   mailbox_.reset(new Mailbox(node_, nodes_, id_mapper_.get()));
@@ -20,7 +21,8 @@ void Engine::StartEverything(int num_server_thread_per_node) {
 
   // Start KVEngine
   kv_engine_.reset(new KVEngine(node_, nodes_, id_mapper_.get(), mailbox_.get()));
-  kv_engine_->StartKVEngine();
+  kv_engine_->StartKVEngine(num_server_thread_per_node, num_reader_threads_per_node,
+                            num_executors_per_server_thread);
 
   // Barrier
   mailbox_->Barrier();
@@ -38,11 +40,26 @@ void Engine::StopEverything() {
   LOG(INFO) << "StopEverything in Node: " << node_.id;
 }
 
+std::vector<third_party::Range> Engine::PlanRanges(const RangePlanner& planner, double load_weight, bool dense) {
+  CHECK(id_mapper_);
+  return planner.Plan(id_mapper_->GetAllServerThreads().size(), load_weight, dense);
+}
+
 void Engine::Run(const MLTask& task) {
   CHECK(kv_engine_);
   kv_engine_->Run(task);
 }
 
+void Engine::RebalanceBetweenTasks(uint32_t table_id) {
+  CHECK(kv_engine_);
+  kv_engine_->RebalanceBetweenTasks(table_id);
+}
+
+void Engine::EnableOnlineRebalance(uint32_t table_id, int rebalance_clocks) {
+  CHECK(kv_engine_);
+  kv_engine_->EnableOnlineRebalance(table_id, rebalance_clocks);
+}
+
 void Engine::Barrier() {
   CHECK(mailbox_);
   mailbox_->Barrier();
@@ -9,6 +9,7 @@
 #include "comm/mailbox.hpp"
 #include "driver/simple_id_mapper.hpp"
 #include "driver/kv_engine.hpp"
+#include "driver/range_planner.hpp"
 
 namespace flexps {
 
@@ -16,18 +17,60 @@ class Engine {
  public:
   Engine(const Node& node, const std::vector<Node>& nodes) : node_(node), nodes_(nodes) {}
 
-  void StartEverything(int num_server_threads_per_node = 1);
+  // The reader threads serve Gets of the StorageType::SnapshotVector tables, see server/snapshot_reader.hpp
+  // The executor threads split the large requests of the Vector tables, see ServerThread
+  // The replies to the worker threads are handled by num_worker_helper_threads_per_node helper threads,
+  // the replies to one worker thread always by the same one
+  void StartEverything(int num_server_threads_per_node = 1, int num_reader_threads_per_node = 0,
+                       int num_executors_per_server_thread = 0, int num_worker_helper_threads_per_node = 1);
 
   void StopEverything();
 
   void Barrier();
 
+  // Plan one range per server thread from the key sample in planner, to be passed to CreateTable().
+  // All nodes must give the same sample. See driver/range_planner.hpp for load_weight and dense.
+  std::vector<third_party::Range> PlanRanges(const RangePlanner& planner, double load_weight = 0.5,
+                                             bool dense = true);
+
+  // The warm start file, the initializer, the hot key replication and the quorum of QuorumBSP are set
+  // in options, see TableOptions in driver/kv_engine.hpp.
   template <typename Val>
   void CreateTable(uint32_t table_id, const std::vector<third_party::Range>& ranges, ModelType model_type,
-                   StorageType storage_type, int model_staleness = 0, uint32_t chunk_size = 1);
+                   StorageType storage_type, int model_staleness = 0, uint32_t chunk_size = 1,
+                   const TableOptions<Val>& options = TableOptions<Val>());
+
+  // A table partitioned by consistent hashing on MapStorage, the keys of the requests need not be sorted
+  template <typename Val>
+  void CreateHashTable(uint32_t table_id, ModelType model_type, int model_staleness = 0, uint32_t chunk_size = 1,
+                       const Initializer<Val>& initializer = nullptr);
+
+  // The local worker threads share the Gets of an SSP table through a node cache, see worker/node_cache.hpp
+  template <typename Val>
+  void EnableNodeCache(uint32_t table_id);
+  // The local worker threads sum their Adds to a BSP, SSP or ASP table before sending, see worker/add_combiner.hpp
+  template <typename Val>
+  void EnableAddCombiner(uint32_t table_id, std::chrono::milliseconds deadline = std::chrono::milliseconds(10));
+  // The concurrent Gets of the local worker threads at the same clock are fetched together, see worker/get_combiner.hpp
+  template <typename Val>
+  void EnableGetCombiner(uint32_t table_id, std::chrono::microseconds window = std::chrono::microseconds(1000));
+  // The KVClientTables of a BSP, SSP or ASP table buffer their Adds and Clocks, see worker/update_buffer.hpp
+  void EnableUpdateBuffer(uint32_t table_id, const UpdateBufferOptions& options) {
+    CHECK(kv_engine_);
+    kv_engine_->EnableUpdateBuffer(table_id, options);
+  }
+  NodeCacheStats GetNodeCacheStats(uint32_t table_id) const {
+    CHECK(kv_engine_);
+    return kv_engine_->GetNodeCacheStats(table_id);
+  }
 
   void Run(const MLTask& task);
 
+  // Rebalance the key ranges of a table by the load of the previous tasks, called by all nodes between tasks
+  void RebalanceBetweenTasks(uint32_t table_id);
+  // Rebalance the key ranges of a table every rebalance_clocks clocks of its tasks, see KVEngine
+  void EnableOnlineRebalance(uint32_t table_id, int rebalance_clocks);
+
   SimpleIdMapper* GetIdMapper() { 
     CHECK(id_mapper_);
     return id_mapper_.get();
@@ -58,9 +101,35 @@ class Engine {
 
 template <typename Val>
 void Engine::CreateTable(uint32_t table_id, const std::vector<third_party::Range>& ranges, ModelType model_type,
-                         StorageType storage_type, int model_staleness, uint32_t chunk_size) {
+                         StorageType storage_type, int model_staleness, uint32_t chunk_size,
+                         const TableOptions<Val>& options) {
+  CHECK(kv_engine_);
+  kv_engine_->CreateTable<Val>(table_id, ranges, model_type, storage_type, model_staleness, chunk_size, options);
+}
+
+template <typename Val>
+void Engine::CreateHashTable(uint32_t table_id, ModelType model_type, int model_staleness, uint32_t chunk_size,
+                             const Initializer<Val>& initializer) {
+  CHECK(kv_engine_);
+  kv_engine_->CreateHashTable<Val>(table_id, model_type, model_staleness, chunk_size, initializer);
+}
+
+template <typename Val>
+void Engine::EnableNodeCache(uint32_t table_id) {
+  CHECK(kv_engine_);
+  kv_engine_->EnableNodeCache<Val>(table_id);
+}
+
+template <typename Val>
+void Engine::EnableAddCombiner(uint32_t table_id, std::chrono::milliseconds deadline) {
+  CHECK(kv_engine_);
+  kv_engine_->EnableAddCombiner<Val>(table_id, deadline);
+}
+
+template <typename Val>
+void Engine::EnableGetCombiner(uint32_t table_id, std::chrono::microseconds window) {
   CHECK(kv_engine_);
-  kv_engine_->CreateTable<Val>(table_id, ranges, model_type, storage_type, model_staleness, chunk_size);
+  kv_engine_->EnableGetCombiner<Val>(table_id, window);
 }
 
 template <typename Val>
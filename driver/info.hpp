@@ -9,7 +9,11 @@
 #include "worker/abstract_partition_manager.hpp"
 #include "worker/simple_range_manager.hpp"
 
+#include "worker/add_combiner.hpp"
+#include "worker/get_combiner.hpp"
 #include "worker/kv_client_table.hpp"
+#include "worker/node_cache.hpp"
+#include "worker/online_range_partition_manager.hpp"
 #include "worker/simple_kv_table.hpp"
 #include "worker/sparse_kv_client_table.hpp"
 
@@ -31,6 +35,10 @@ struct Info {
 
   // The wrapper function (helper) to create a KVClientTable, so that users
   // do not need to call the KVClientTable constructor with so many arguments.
+  // The table reads through the node cache if it is enabled, see KVEngine::EnableNodeCache,
+  // and its Adds and Gets go through the add and get combiners if they are enabled,
+  // see KVEngine::EnableAddCombiner and KVEngine::EnableGetCombiner. Its update buffer is enabled
+  // by KVEngine::EnableUpdateBuffer.
   template <typename Val>
   std::unique_ptr<KVClientTable<Val>> CreateKVClientTable(uint32_t table_id) const;
 
@@ -46,13 +54,38 @@ struct Info {
   std::map<uint32_t, AbstractPartitionManager*> partition_manager_map;
   AbstractCallbackRunner* callback_runner;
   AbstractMailbox* mailbox;
+  std::map<uint32_t, AbstractNodeCache*> node_cache_map;
+  std::map<uint32_t, AbstractAddCombiner*> add_combiner_map;
+  std::map<uint32_t, AbstractGetCombiner*> get_combiner_map;
+  std::map<uint32_t, UpdateBufferOptions> update_buffer_options_map;
 };
 
 template <typename Val>
 std::unique_ptr<KVClientTable<Val>> Info::CreateKVClientTable(uint32_t table_id) const {
   CHECK(partition_manager_map.find(table_id) != partition_manager_map.end());
+  NodeCache<Val>* node_cache = nullptr;
+  auto it = node_cache_map.find(table_id);
+  if (it != node_cache_map.end()) {
+    node_cache = dynamic_cast<NodeCache<Val>*>(it->second);
+    CHECK(node_cache) << "The node cache of table " << table_id << " has another value type";
+  }
+  AddCombiner<Val>* add_combiner = nullptr;
+  auto combiner_it = add_combiner_map.find(table_id);
+  if (combiner_it != add_combiner_map.end()) {
+    add_combiner = dynamic_cast<AddCombiner<Val>*>(combiner_it->second);
+    CHECK(add_combiner) << "The add combiner of table " << table_id << " has another value type";
+  }
+  GetCombiner<Val>* get_combiner = nullptr;
+  auto get_combiner_it = get_combiner_map.find(table_id);
+  if (get_combiner_it != get_combiner_map.end()) {
+    get_combiner = dynamic_cast<GetCombiner<Val>*>(get_combiner_it->second);
+    CHECK(get_combiner) << "The get combiner of table " << table_id << " has another value type";
+  }
   std::unique_ptr<KVClientTable<Val>> table(new KVClientTable<Val>(thread_id, table_id, send_queue, partition_manager_map.find(table_id)->second,
-                           callback_runner));
+                           callback_runner, node_cache, add_combiner, get_combiner));
+  auto buffer_it = update_buffer_options_map.find(table_id);
+  if (buffer_it != update_buffer_options_map.end())
+    table->EnableUpdateBuffer(buffer_it->second);
   return table;
 }
 
@@ -67,6 +100,8 @@ template <typename Val>
 std::unique_ptr<SparseKVClientTable<Val>> Info::CreateSparseKVClientTable(uint32_t table_id, uint32_t speculation,
                                                          const std::vector<third_party::SArray<Key>>& keys) const {
   CHECK(partition_manager_map.find(table_id) != partition_manager_map.end());
+  CHECK(!dynamic_cast<OnlineRangePartitionManager*>(partition_manager_map.find(table_id)->second))
+      << "SparseKVClientTable does not follow the layouts of the online rebalance";
   std::unique_ptr<SparseKVClientTable<Val>> table(new SparseKVClientTable<Val>(thread_id, table_id, send_queue, partition_manager_map.find(table_id)->second,
                                  callback_runner, speculation, keys));
   return table;
@@ -7,7 +7,10 @@
 
 namespace flexps {
 
-void KVEngine::StartKVEngine(int num_server_thread_per_node) {
+void KVEngine::StartKVEngine(int num_server_thread_per_node, int num_reader_threads_per_node,
+                             int num_executors_per_server_thread) {
+  num_reader_threads_per_node_ = num_reader_threads_per_node;
+  num_executors_per_server_thread_ = num_executors_per_server_thread;
   StartSender();
   StartServerThreads();
   StartWorkerHelperThreads();
@@ -23,12 +26,24 @@ void KVEngine::StartWorkerHelperThreads() {
   CHECK(id_mapper_);
   CHECK(mailbox_);
   auto worker_helper_thread_ids = id_mapper_->GetWorkerHelperThreadsForId(node_.id);
-  CHECK_EQ(worker_helper_thread_ids.size(), 1);
+  CHECK_GT(worker_helper_thread_ids.size(), 0);
   app_blocker_.reset(new AppBlocker());
-  worker_helper_thread_.reset(new WorkerHelperThread(worker_helper_thread_ids[0], app_blocker_.get()));
-  mailbox_->RegisterQueue(worker_helper_thread_->GetHelperId(), worker_helper_thread_->GetWorkQueue());
-  worker_helper_thread_->Start();
-  VLOG(1) << "worker_helper_thread:" << worker_helper_thread_ids[0] << " starts on node:" << node_.id;
+  for (auto id : worker_helper_thread_ids) {
+    std::unique_ptr<WorkerHelperThread> helper(new WorkerHelperThread(id, app_blocker_.get()));
+    mailbox_->RegisterQueue(helper->GetHelperId(), helper->GetWorkQueue());
+    helper->Start();
+    worker_helper_threads_.push_back(std::move(helper));
+  }
+  std::stringstream ss;
+  for (auto id : worker_helper_thread_ids) {
+    ss << id << " ";
+  }
+  VLOG(1) << "worker_helper_threads:" << ss.str() << " start on node:" << node_.id;
+}
+
+WorkerHelperThread* KVEngine::GetWorkerHelperThread(uint32_t thread_id) const {
+  CHECK(!worker_helper_threads_.empty());
+  return worker_helper_threads_[std::hash<uint32_t>()(thread_id) % worker_helper_threads_.size()].get();
 }
 
 void KVEngine::StartServerThreads() {
@@ -36,7 +51,9 @@ void KVEngine::StartServerThreads() {
   CHECK(mailbox_);
   auto server_thread_ids = id_mapper_->GetServerThreadsForId(node_.id);
   CHECK_GT(server_thread_ids.size(), 0);
-  server_thread_group_.reset(new ServerThreadGroup(server_thread_ids, sender_->GetMessageQueue()));
+  server_thread_group_.reset(
+      new ServerThreadGroup(server_thread_ids, sender_->GetMessageQueue(), num_reader_threads_per_node_,
+                            num_executors_per_server_thread_));
   for (auto& server_thread : *server_thread_group_) {
     mailbox_->RegisterQueue(server_thread->GetServerId(), server_thread->GetWorkQueue());
     server_thread->Start();
@@ -54,9 +71,11 @@ void KVEngine::StartSender() {
 }
 
 void KVEngine::StopWorkerHelperThreads() {
-  CHECK(worker_helper_thread_);
-  worker_helper_thread_->Stop();
-  VLOG(1) << "worker_helper_thread stops on node" << node_.id;
+  CHECK(!worker_helper_threads_.empty());
+  for (auto& helper : worker_helper_threads_) {
+    helper->Stop();
+  }
+  VLOG(1) << "worker_helper_threads stop on node" << node_.id;
 }
 
 void KVEngine::StopServerThreads() {
@@ -64,6 +83,7 @@ void KVEngine::StopServerThreads() {
   for (auto& server_thread : *server_thread_group_) {
     server_thread->Stop();
   }
+  server_thread_group_->StopReaderPool();
   VLOG(1) << "server_threads stop on node" << node_.id;
 }
 
@@ -97,6 +117,51 @@ void KVEngine::RegisterRangePartitionManager(uint32_t table_id, const std::vecto
   partition_manager_map_[table_id] = std::move(range_manager);
 }
 
+void KVEngine::RegisterModels(uint32_t table_id, std::vector<std::unique_ptr<AbstractStorage>>&& storages,
+                              ModelType model_type, int model_staleness, uint32_t num_hot_keys,
+                              const std::vector<uint32_t>& helper_ids, const QuorumBSPOptions& quorum_options) {
+  CHECK(server_thread_group_);
+  CHECK(id_mapper_);
+  model_types_[table_id] = model_type;
+  auto server_thread_ids = id_mapper_->GetAllServerThreads();
+  size_t storage_idx = 0;
+  for (auto& server_thread : *server_thread_group_) {
+    CHECK_LT(storage_idx, storages.size());
+    std::unique_ptr<AbstractStorage> storage = std::move(storages[storage_idx++]);
+    std::unique_ptr<AbstractModel> model;
+    // Set up model
+    if (model_type == ModelType::SSP) {
+      ssp_staleness_[table_id] = model_staleness;
+      SSPModel* ssp_model = new SSPModel(table_id, std::move(storage), model_staleness,
+                                         server_thread_group_->GetReplyQueue(), server_thread_group_->GetReaderPool());
+      if (num_hot_keys > 0) {
+        std::vector<uint32_t> replica_ids;
+        for (auto server_thread_id : server_thread_ids) {
+          if (server_thread_id != server_thread->GetServerId())
+            replica_ids.push_back(server_thread_id);
+        }
+        ssp_model->EnableHotKeyReplication(server_thread->GetServerId(), num_hot_keys, replica_ids, helper_ids);
+      }
+      model.reset(ssp_model);
+    } else if (model_type == ModelType::BSP) {
+      model.reset(new BSPModel(table_id, std::move(storage), server_thread_group_->GetReplyQueue(),
+                               server_thread_group_->GetReaderPool()));
+    } else if (model_type == ModelType::QuorumBSP) {
+      QuorumBSPModel* quorum_model = new QuorumBSPModel(table_id, std::move(storage),
+                                                        server_thread_group_->GetReplyQueue(), quorum_options,
+                                                        server_thread_group_->GetReaderPool());
+      quorum_model->SetServers(server_thread->GetServerId(), server_thread_ids);
+      model.reset(quorum_model);
+    } else if (model_type == ModelType::ASP) {
+      model.reset(new ASPModel(table_id, std::move(storage), server_thread_group_->GetReplyQueue(),
+                               server_thread_group_->GetReaderPool()));
+    } else {
+      CHECK(false) << "Unknown model_type";
+    }
+    server_thread->RegisterModel(table_id, std::move(model));
+  }
+}
+
 void KVEngine::InitTable(uint32_t table_id, const std::vector<uint32_t>& worker_ids) {
   CHECK(id_mapper_);
   CHECK(mailbox_);
@@ -118,21 +183,162 @@ void KVEngine::InitTable(uint32_t table_id, const std::vector<uint32_t>& worker_
     reset_msg.meta.recver = local_server;
     sender_->GetMessageQueue()->Push(reset_msg);
   }
-  // Wait for reply
+  // Wait for reply, a table rebalanced online also gets the layout version its server threads are at
+  auto* online_manager = dynamic_cast<OnlineRangePartitionManager*>(partition_manager_map_[table_id].get());
+  if (online_manager)
+    count *= 2;
+  uint32_t layout_version = 0;
   Message reply;
   while (count > 0) {
     queue.WaitAndPop(&reply);
-    CHECK(reply.meta.flag == Flag::kResetWorkerInModel);
+    CHECK(reply.meta.flag == Flag::kResetWorkerInModel || (online_manager && reply.meta.flag == Flag::kLayout));
     CHECK(reply.meta.model_id == table_id);
+    layout_version = std::max(layout_version, reply.meta.layout_version);
     --count;
   }
+  // The server threads switch in turn, the task starts from the last layout of the previous task
+  if (online_manager)
+    online_manager->StartTask(layout_version);
   // Free receiving queue
   mailbox_->DeregisterQueue(id);
   id_mapper_->DeallocateWorkerThread(node_.id, id);
 }
 
+void KVEngine::RebalanceBetweenTasks(uint32_t table_id) {
+  CHECK(id_mapper_);
+  CHECK(mailbox_);
+  CHECK(!task_running_) << "The requests of a running task would use the old layout";
+  auto it = partition_manager_map_.find(table_id);
+  CHECK(it != partition_manager_map_.end()) << "Unknown table: " << table_id;
+  auto* online_manager = dynamic_cast<OnlineRangePartitionManager*>(it->second.get());
+  const auto* range_manager = online_manager ? online_manager->GetLatestLayout()
+                                             : dynamic_cast<SimpleRangePartitionManager*>(it->second.get());
+  CHECK(range_manager) << "Only range partitioned tables can be repartitioned";
+  CHECK_EQ(range_manager->GetChunkSize(), 1) << "Chunked tables cannot be repartitioned";
+  // An online table may have switched past the latest layout announced here, its server threads repartition
+  // from their own layout and reply the version
+  uint32_t version = range_manager->GetVersion() + 1;
+  const auto& server_thread_ids = range_manager->GetServerThreadIds();
+  const auto& ranges = range_manager->GetRanges();
+
+  std::vector<uint32_t> local_servers = id_mapper_->GetServerThreadsForId(node_.id);
+  int count = local_servers.size();
+  std::vector<third_party::Range> new_ranges;
+  if (count > 0) {
+    // Register receiving queue
+    auto id = id_mapper_->AllocateWorkerThread(node_.id);
+    ThreadsafeQueue<Message> queue;
+    mailbox_->RegisterQueue(id, &queue);
+    Message repartition_msg;
+    repartition_msg.meta.flag = Flag::kRepartition;
+    repartition_msg.meta.model_id = table_id;
+    repartition_msg.meta.sender = id;
+    repartition_msg.meta.layout_version = version;
+    repartition_msg.AddData(third_party::SArray<uint32_t>(server_thread_ids));
+    repartition_msg.AddData(EncodeRanges(ranges));
+    for (auto local_server : local_servers) {
+      repartition_msg.meta.recver = local_server;
+      sender_->GetMessageQueue()->Push(repartition_msg);
+    }
+    // Wait for the local server threads to finish the migration, they all compute the same ranges
+    Message reply;
+    third_party::SArray<Key> encoded_new_ranges;
+    while (count > 0) {
+      queue.WaitAndPop(&reply);
+      CHECK(reply.meta.flag == Flag::kRepartition);
+      CHECK(reply.meta.model_id == table_id);
+      CHECK_EQ(reply.data.size(), 1);
+      third_party::SArray<Key> encoded(reply.data[0]);
+      CHECK_EQ(encoded.size(), ranges.size() * 2);
+      if (encoded_new_ranges.empty()) {
+        encoded_new_ranges = encoded;
+        if (online_manager)
+          version = reply.meta.layout_version;
+      }
+      CHECK_EQ(reply.meta.layout_version, version);
+      CHECK(std::equal(encoded.begin(), encoded.end(), encoded_new_ranges.begin()));
+      --count;
+    }
+    new_ranges = DecodeRanges(encoded_new_ranges);
+    // Free receiving queue
+    mailbox_->DeregisterQueue(id);
+    id_mapper_->DeallocateWorkerThread(node_.id, id);
+  }
+  // Wait until the keys are migrated on all nodes before the next task sends requests
+  mailbox_->Barrier();
+  CHECK(!new_ranges.empty()) << "Repartition needs a server thread on each node";
+  LOG(INFO) << "Repartitioned table " << table_id << " to version " << version;
+  if (online_manager) {
+    // The server threads have switched too, the next task starts from it (see InitTable)
+    online_manager->AddLayout(version, new_ranges);
+  } else {
+    it->second.reset(new SimpleRangePartitionManager(new_ranges, server_thread_ids, range_manager->GetChunkSize(),
+                                                      version));
+  }
+}
+
+void KVEngine::EnableOnlineRebalance(uint32_t table_id, int rebalance_clocks) {
+  CHECK(id_mapper_);
+  CHECK(server_thread_group_);
+  CHECK(!task_running_) << "The layout of a running task cannot change";
+  auto type_it = model_types_.find(table_id);
+  CHECK(type_it != model_types_.end()) << "Unknown table " << table_id;
+  CHECK(type_it->second == ModelType::SSP || type_it->second == ModelType::BSP || type_it->second == ModelType::ASP)
+      << "Online rebalance is only supported by BSP, SSP and ASP tables";
+  CHECK(add_combiner_map_.find(table_id) == add_combiner_map_.end() &&
+        get_combiner_map_.find(table_id) == get_combiner_map_.end())
+      << "The combined requests would mix the layouts of the online rebalance";
+  auto& manager = partition_manager_map_[table_id];
+  auto* range_manager = dynamic_cast<SimpleRangePartitionManager*>(manager.get());
+  CHECK(range_manager) << "Only range partitioned tables can be rebalanced online";
+  CHECK_EQ(range_manager->GetChunkSize(), 1) << "Chunked tables cannot be repartitioned";
+  CHECK(!worker_helper_threads_.empty());
+  CHECK(!id_mapper_->GetServerThreadsForId(node_.id).empty()) << "InitTable needs the layout version of a local server";
+
+  const uint32_t version = range_manager->GetVersion();
+  const std::vector<uint32_t> server_thread_ids = range_manager->GetServerThreadIds();
+  const std::vector<third_party::Range> ranges = range_manager->GetRanges();
+  std::unique_ptr<OnlineRangePartitionManager> online_manager(new OnlineRangePartitionManager(
+      std::unique_ptr<SimpleRangePartitionManager>(static_cast<SimpleRangePartitionManager*>(manager.release())),
+      rebalance_clocks));
+  OnlineRangePartitionManager* layouts = online_manager.get();
+  worker_helper_threads_[0]->RegisterLayoutHandle(table_id, [layouts](Message& msg) {
+    layouts->AddLayout(msg.meta.layout_version, DecodeRanges(third_party::SArray<Key>(msg.data[0])));
+  });
+  manager = std::move(online_manager);
+
+  // The layouts are announced to the first worker helper thread of each node
+  std::vector<uint32_t> helper_ids;
+  for (const auto& node : nodes_)
+    helper_ids.push_back(id_mapper_->GetWorkerHelperThreadsForId(node.id)[0]);
+  for (auto& server_thread : *server_thread_group_)
+    server_thread->EnableOnlineRebalance(table_id, rebalance_clocks, version, server_thread_ids, ranges, helper_ids);
+}
+
+void KVEngine::EnableUpdateBuffer(uint32_t table_id, const UpdateBufferOptions& options) {
+  auto it = model_types_.find(table_id);
+  CHECK(it != model_types_.end()) << "Unknown table " << table_id;
+  CHECK(it->second == ModelType::SSP || it->second == ModelType::BSP || it->second == ModelType::ASP)
+      << "The update buffer is only supported by BSP, SSP and ASP tables";
+  CHECK(it->second != ModelType::BSP || options.max_delay_clocks == 0)
+      << "A BSP table cannot delay its Adds past the Clock of their iteration";
+  CHECK_GE(options.max_delay_clocks, 0);
+  if (it->second == ModelType::SSP) {
+    CHECK_LE(options.max_delay_clocks, ssp_staleness_[table_id])
+        << "An SSP table cannot delay its Adds by more clocks than its staleness";
+  }
+  update_buffer_options_map_[table_id] = options;
+}
+
+NodeCacheStats KVEngine::GetNodeCacheStats(uint32_t table_id) const {
+  auto it = node_cache_map_.find(table_id);
+  CHECK(it != node_cache_map_.end()) << "The node cache is not enabled for table " << table_id;
+  return it->second->GetStats();
+}
+
 void KVEngine::Run(const MLTask& task) {
   CHECK(task.IsSetup());
+  task_running_ = true;
   WorkerSpec worker_spec = AllocateWorkers(task.GetWorkerAlloc());
 
   // Init tables
@@ -155,11 +361,41 @@ void KVEngine::Run(const MLTask& task) {
       CHECK(it != partition_manager_map_.end());
       partition_manager_map[table] = it->second.get();
     }
+    std::map<uint32_t, AbstractNodeCache*> node_cache_map;
+    for (auto& table : tables) {
+      auto it = node_cache_map_.find(table);
+      if (it != node_cache_map_.end()) {
+        it->second->Clear();
+        node_cache_map[table] = it->second.get();
+      }
+    }
+    std::map<uint32_t, AbstractAddCombiner*> add_combiner_map;
+    for (auto& table : tables) {
+      auto it = add_combiner_map_.find(table);
+      if (it != add_combiner_map_.end()) {
+        it->second->Reset(local_threads.size());
+        add_combiner_map[table] = it->second.get();
+      }
+    }
+    std::map<uint32_t, AbstractGetCombiner*> get_combiner_map;
+    for (auto& table : tables) {
+      auto it = get_combiner_map_.find(table);
+      if (it != get_combiner_map_.end()) {
+        it->second->Reset(local_threads.size());
+        get_combiner_map[table] = it->second.get();
+      }
+    }
+    std::map<uint32_t, UpdateBufferOptions> update_buffer_options_map;
+    for (auto& table : tables) {
+      auto it = update_buffer_options_map_.find(table);
+      if (it != update_buffer_options_map_.end())
+        update_buffer_options_map[table] = it->second;
+    }
     for (int i = 0; i < thread_group.size(); ++i) {
-      // TODO: Now I register the thread_id with the queue in worker_helper_thread to the mailbox.
-      // So that the message sent to thread_id will be pushed into worker_helper_thread_'s queue
-      // and worker_helper_thread_ is in charge of handling the message.
-      mailbox_->RegisterQueue(local_threads[i], worker_helper_thread_->GetWorkQueue());
+      // TODO: Now I register the thread_id with the queue of a worker_helper_thread to the mailbox.
+      // So that the message sent to thread_id will be pushed into that worker_helper_thread's queue
+      // and it is in charge of handling the message.
+      mailbox_->RegisterQueue(local_threads[i], GetWorkerHelperThread(local_threads[i])->GetWorkQueue());
       Info info;
       info.local_id = i;
       info.thread_id = local_threads[i];
@@ -168,14 +404,22 @@ void KVEngine::Run(const MLTask& task) {
       info.partition_manager_map = partition_manager_map;
       info.callback_runner = app_blocker_.get();
       info.mailbox = mailbox_;
+      info.node_cache_map = node_cache_map;
+      info.add_combiner_map = add_combiner_map;
+      info.get_combiner_map = get_combiner_map;
+      info.update_buffer_options_map = update_buffer_options_map;
       thread_group[i] = std::thread([&task, info]() { task.RunLambda(info); });
     }
     for (auto& th : thread_group) {
       th.join();
     }
+    for (auto& kv : add_combiner_map) {
+      kv.second->FlushAll();
+    }
   }
   // Let all the on-the-fly messages be recevied based on TCP/IP assumption
   mailbox_->Barrier();
+  task_running_ = false;
 }
 
 }  // namespace flexps
@@ -1,7 +1,11 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "base/node.hpp"
@@ -14,13 +18,19 @@
 #include "driver/worker_spec.hpp"
 #include "server/asp_model.hpp"
 #include "server/bsp_model.hpp"
+#include "server/quorum_bsp_model.hpp"
+#include "server/initializer.hpp"
 #include "server/map_storage.hpp"
+#include "server/model_file.hpp"
 #include "server/server_thread.hpp"
 #include "server/server_thread_group.hpp"
 #include "server/ssp_model.hpp"
 #include "server/vector_storage.hpp"
 #include "worker/abstract_partition_manager.hpp"
 #include "worker/app_blocker.hpp"
+#include "worker/hash_partition_manager.hpp"
+#include "worker/hot_key_partition_manager.hpp"
+#include "worker/online_range_partition_manager.hpp"
 #include "worker/simple_range_manager.hpp"
 #include "worker/worker_helper_thread.hpp"
 
@@ -29,12 +39,33 @@
 #include "server/sparsessp/sparse_ssp_model.hpp"
 #include "server/sparsessp/unordered_map_sparse_ssp_recorder.hpp"
 #include "server/sparsessp/vector_sparse_ssp_recorder.hpp"
+#include "server/sparsessp/compact_sparse_ssp_recorder.hpp"
 
 namespace flexps {
 
-enum class ModelType { SSP, BSP, ASP, SparseSSP };
-enum class StorageType { Map, Vector };
-enum class SparseSSPRecorderType { None, Map, Vector };
+enum class ModelType { SSP, BSP, ASP, SparseSSP, QuorumBSP };
+// SnapshotVector is a Vector storage whose Gets may be served from snapshots by the reader threads
+enum class StorageType { Map, Vector, SnapshotVector };
+// Compact is a Vector recorder with byte counters, see server/sparsessp/compact_sparse_ssp_recorder.hpp
+enum class SparseSSPRecorderType { None, Map, Vector, Compact };
+
+/*
+ * The optional settings of KVEngine::CreateTable:
+ * - If model_file is given, the table is warm started from it (see server/model_file.hpp):
+ *   each local server thread maps and loads its own range in parallel.
+ * - If initializer is given, keys start from the initializer value instead of Val()
+ *   (see server/initializer.hpp), values loaded from model_file take precedence.
+ * - If num_hot_keys > 0, each server thread replicates at most num_hot_keys hot keys to the other
+ *   server threads (see SSPModel::EnableHotKeyReplication), SSP only.
+ * - quorum_options is used by QuorumBSP only, see server/quorum_bsp_model.hpp.
+ */
+template <typename Val>
+struct TableOptions {
+  std::string model_file;
+  Initializer<Val> initializer;
+  uint32_t num_hot_keys = 0;
+  QuorumBSPOptions quorum_options;
+};
 
 /*
  * KVEngine handles the kvstore module
@@ -45,8 +76,15 @@ class KVEngine {
           SimpleIdMapper* const id_mapper, Mailbox* const mailbox) 
       : node_(node), nodes_(nodes), id_mapper_(id_mapper), mailbox_(mailbox) {}
 
-  void StartKVEngine(int num_server_threads_per_node = 1);
+  // The worker helper threads are given by the id mapper, see StartWorkerHelperThreads()
+  void StartKVEngine(int num_server_threads_per_node = 1, int num_reader_threads_per_node = 0,
+                     int num_executors_per_server_thread = 0);
   void StartServerThreads();
+  /*
+   * Start one WorkerHelperThread per helper id of the node. The replies to a local worker thread are
+   * all handled by the helper thread chosen by the hash of its id (see GetWorkerHelperThread), so that
+   * the replies to one thread keep their order.
+   */
   void StartWorkerHelperThreads();
   void StartSender();
 
@@ -55,9 +93,19 @@ class KVEngine {
   void StopWorkerHelperThreads();
   void StopSender();
 
+  // See TableOptions for the optional settings
   template <typename Val>
   void CreateTable(uint32_t table_id, const std::vector<third_party::Range>& ranges, ModelType model_type,
-                   StorageType storage_type, int model_staleness = 0, uint32_t chunk_size = 1);
+                   StorageType storage_type, int model_staleness = 0, uint32_t chunk_size = 1,
+                   const TableOptions<Val>& options = TableOptions<Val>());
+
+  /*
+   * Create a table partitioned by consistent hashing (see worker/hash_partition_manager.hpp) on MapStorage.
+   * The keys of the Gets and Adds need not be sorted. Cannot be repartitioned or use hot key replication.
+   */
+  template <typename Val>
+  void CreateHashTable(uint32_t table_id, ModelType model_type, int model_staleness = 0, uint32_t chunk_size = 1,
+                       const Initializer<Val>& initializer = nullptr, uint32_t num_virtual_nodes = 64);
 
   // Create SparseSSP Table, for testing sparsessp use only.
   template <typename Val>
@@ -65,14 +113,81 @@ class KVEngine {
                    StorageType storage_type, int model_staleness = 0, int speculation = 0,
                    SparseSSPRecorderType sparse_ssp_recorder_type = SparseSSPRecorderType::None);
 
+  /*
+   * Share the Gets of the local worker threads on an SSP table through a node cache, see worker/node_cache.hpp.
+   * A Get of a KVClientTable then only fetches the keys not cached fresh enough for the staleness
+   * of the table. The cache is cleared at the start of each task.
+   */
+  template <typename Val>
+  void EnableNodeCache(uint32_t table_id);
+  NodeCacheStats GetNodeCacheStats(uint32_t table_id) const;
+
+  /*
+   * Sum the Adds of the local worker threads to a BSP, SSP or ASP table per server and clock before they
+   * are sent, see worker/add_combiner.hpp. All the local threads of a task must Clock the table.
+   */
+  template <typename Val>
+  void EnableAddCombiner(uint32_t table_id, std::chrono::milliseconds deadline = std::chrono::milliseconds(10));
+
+  /*
+   * Fetch the concurrent Gets of the local worker threads to a table at the same clock together, see
+   * worker/get_combiner.hpp. A Get waits at most window for the Gets of the other threads to join.
+   */
+  template <typename Val>
+  void EnableGetCombiner(uint32_t table_id, std::chrono::microseconds window = std::chrono::microseconds(1000));
+
+  /*
+   * Buffer the Adds and Clocks of the KVClientTables of a BSP, SSP or ASP table, see worker/update_buffer.hpp.
+   * options.max_delay_clocks > 0 is rejected on BSP tables, and more than the staleness on SSP tables.
+   */
+  void EnableUpdateBuffer(uint32_t table_id, const UpdateBufferOptions& options);
+
   void Run(const MLTask& task);
+
+  /*
+   * Rebalance the ranges of a table created by CreateTable(), must be called by all nodes between tasks.
+   *
+   * The server threads exchange the load sampled from the Gets and Adds since the last rebalance,
+   * compute the same balanced ranges and migrate the keys to their new owners
+   * (see ServerThread::StartRepartition). The following tasks use the new ranges as the layout of the
+   * next version. As no task is running, there is no request in flight for the old layout.
+   * Not supported for chunked tables and tables with hot key replication.
+   */
+  void RebalanceBetweenTasks(uint32_t table_id);
+
+  /*
+   * Rebalance the ranges of a BSP, SSP or ASP table created by CreateTable() while its tasks run, every
+   * rebalance_clocks clocks. Must be called by all nodes before the first task using the table.
+   *
+   * A worker thread slices its requests at clock k with the layout of version base + k / rebalance_clocks,
+   * see worker/online_range_partition_manager.hpp, and tags them with it. The server threads switch to a
+   * version once all the worker threads have clocked to it, holding the requests for it received earlier,
+   * see ServerThread::OnlineLayout. RebalanceBetweenTasks() may still be called between tasks.
+   * Not supported for chunked tables, snapshot storages, hot key replication and the add and get combiners.
+   */
+  void EnableOnlineRebalance(uint32_t table_id, int rebalance_clocks);
  private:
   WorkerSpec AllocateWorkers(const std::vector<WorkerAlloc>& worker_alloc);
   void RegisterRangePartitionManager(uint32_t table_id, const std::vector<third_party::Range>& ranges, uint32_t chunk_size = 1);
+  // Wrap the storages of the local server threads (in the order of server_thread_group_) into models
+  void RegisterModels(uint32_t table_id, std::vector<std::unique_ptr<AbstractStorage>>&& storages,
+                      ModelType model_type, int model_staleness, uint32_t num_hot_keys = 0,
+                      const std::vector<uint32_t>& helper_ids = {},
+                      const QuorumBSPOptions& quorum_options = QuorumBSPOptions());
   void InitTable(uint32_t table_id, const std::vector<uint32_t>& worker_ids);
+  WorkerHelperThread* GetWorkerHelperThread(uint32_t thread_id) const;
 
  private:
   std::map<uint32_t, std::unique_ptr<AbstractPartitionManager>> partition_manager_map_;
+  // The staleness of the SSP tables, and their node caches if enabled
+  std::map<uint32_t, int> ssp_staleness_;
+  std::map<uint32_t, std::unique_ptr<AbstractNodeCache>> node_cache_map_;
+  std::map<uint32_t, ModelType> model_types_;
+  std::map<uint32_t, std::unique_ptr<AbstractAddCombiner>> add_combiner_map_;
+  std::map<uint32_t, std::unique_ptr<AbstractGetCombiner>> get_combiner_map_;
+  std::map<uint32_t, UpdateBufferOptions> update_buffer_options_map_;
+  // Set while Run() runs a task, RebalanceBetweenTasks() must not
+  std::atomic<bool> task_running_{false};
   // nodes
   Node node_;
   std::vector<Node> nodes_;
@@ -84,14 +199,21 @@ class KVEngine {
   std::unique_ptr<Sender> sender_;
   // worker elements
   std::unique_ptr<AppBlocker> app_blocker_;
-  std::unique_ptr<WorkerHelperThread> worker_helper_thread_;
+  // The first one also handles the hot key announcements of the servers
+  std::vector<std::unique_ptr<WorkerHelperThread>> worker_helper_threads_;
   // server elements
+  int num_reader_threads_per_node_ = 0;
+  int num_executors_per_server_thread_ = 0;
   std::unique_ptr<ServerThreadGroup> server_thread_group_;
 };
 
 template <typename Val>
 void KVEngine::CreateTable(uint32_t table_id, const std::vector<third_party::Range>& ranges, ModelType model_type,
-                         StorageType storage_type, int model_staleness, uint32_t chunk_size) {
+                         StorageType storage_type, int model_staleness, uint32_t chunk_size,
+                         const TableOptions<Val>& options) {
+  const std::string& model_file = options.model_file;
+  const Initializer<Val>& initializer = options.initializer;
+  const uint32_t num_hot_keys = options.num_hot_keys;
   RegisterRangePartitionManager(table_id, ranges, chunk_size);
   CHECK(server_thread_group_);
 
@@ -99,30 +221,78 @@ void KVEngine::CreateTable(uint32_t table_id, const std::vector<third_party::Ran
   auto server_thread_ids = id_mapper_->GetAllServerThreads();
   CHECK_EQ(ranges.size(), server_thread_ids.size());
 
+  // Hot key replication: the workers route the Gets of the hot keys announced by the servers to local replicas
+  std::vector<uint32_t> helper_ids;
+  if (num_hot_keys > 0) {
+    CHECK(model_type == ModelType::SSP) << "Hot key replication is only supported by SSP";
+    CHECK(!worker_helper_threads_.empty());
+    std::unique_ptr<HotKeyPartitionManager> hot_key_manager(new HotKeyPartitionManager(
+        std::move(partition_manager_map_[table_id]), id_mapper_->GetServerThreadsForId(node_.id)));
+    HotKeyPartitionManager* manager = hot_key_manager.get();
+    worker_helper_threads_[0]->RegisterReplicaSyncHandle(table_id, [manager](Message& msg) {
+      manager->UpdateHotKeys(msg.meta.sender, third_party::SArray<Key>(msg.data[0]));
+    });
+    partition_manager_map_[table_id] = std::move(hot_key_manager);
+    for (const auto& node : nodes_) {
+      helper_ids.push_back(id_mapper_->GetWorkerHelperThreadsForId(node.id)[0]);
+    }
+  }
+
+  // Set up storage
+  std::vector<std::unique_ptr<AbstractStorage>> storages;
+  std::vector<third_party::Range> local_ranges;
   for (auto& server_thread : *server_thread_group_) {
+    auto it = std::find(server_thread_ids.begin(), server_thread_ids.end(), server_thread->GetServerId());
+    CHECK(it != server_thread_ids.end());
+    const auto& range = ranges[it - server_thread_ids.begin()];
     std::unique_ptr<AbstractStorage> storage;
-    std::unique_ptr<AbstractModel> model;
-    // Set up storage
     if (storage_type == StorageType::Map) {
-      storage.reset(new MapStorage<Val>(chunk_size));
+      storage.reset(new MapStorage<Val>(chunk_size, initializer));
     } else if (storage_type == StorageType::Vector) {
-      auto it = std::find(server_thread_ids.begin(), server_thread_ids.end(), server_thread->GetServerId());
-      storage.reset(new VectorStorage<Val>(ranges[it - server_thread_ids.begin()], chunk_size));
+      storage.reset(new VectorStorage<Val>(range, chunk_size, initializer));
+    } else if (storage_type == StorageType::SnapshotVector) {
+      storage.reset(new VectorStorage<Val>(range, chunk_size, initializer, true));
     } else {
       CHECK(false) << "Unknown storage_type";
     }
-    // Set up model
-    if (model_type == ModelType::SSP) {
-      model.reset(new SSPModel(table_id, std::move(storage), model_staleness, server_thread_group_->GetReplyQueue()));
-    } else if (model_type == ModelType::BSP) {
-      model.reset(new BSPModel(table_id, std::move(storage), server_thread_group_->GetReplyQueue()));
-    } else if (model_type == ModelType::ASP) {
-      model.reset(new ASPModel(table_id, std::move(storage), server_thread_group_->GetReplyQueue()));
-    } else {
-      CHECK(false) << "Unknown model_type";
+    storages.push_back(std::move(storage));
+    local_ranges.push_back(range);
+  }
+
+  // Warm start: every storage loads its own range directly, bypassing the worker-server path
+  if (!model_file.empty()) {
+    MappedModelFile file(model_file);
+    CHECK_EQ(file.GetValSize(), sizeof(Val)) << "Value size mismatch in model file: " << model_file;
+    std::vector<std::thread> loaders;
+    for (size_t i = 0; i < storages.size(); ++i) {
+      loaders.push_back(std::thread([&file, &storages, &local_ranges, i]() {
+        storages[i]->LoadRange(local_ranges[i], file.MapRange(local_ranges[i]));
+      }));
     }
-    server_thread->RegisterModel(table_id, std::move(model));
+    for (auto& loader : loaders) {
+      loader.join();
+    }
+    VLOG(1) << "table " << table_id << " is loaded from " << model_file << " on node:" << node_.id;
+  }
+
+  RegisterModels(table_id, std::move(storages), model_type, model_staleness, num_hot_keys, helper_ids,
+                 options.quorum_options);
+}
+
+template <typename Val>
+void KVEngine::CreateHashTable(uint32_t table_id, ModelType model_type, int model_staleness, uint32_t chunk_size,
+                               const Initializer<Val>& initializer, uint32_t num_virtual_nodes) {
+  CHECK(server_thread_group_);
+  CHECK(id_mapper_);
+  CHECK(partition_manager_map_.find(table_id) == partition_manager_map_.end());
+  partition_manager_map_[table_id].reset(
+      new HashPartitionManager(id_mapper_->GetAllServerThreads(), num_virtual_nodes));
+
+  std::vector<std::unique_ptr<AbstractStorage>> storages;
+  for (auto& server_thread : *server_thread_group_) {
+    storages.emplace_back(new MapStorage<Val>(chunk_size, initializer));
   }
+  RegisterModels(table_id, std::move(storages), model_type, model_staleness);
 }
 
 template <typename Val>
@@ -158,6 +328,10 @@ void KVEngine::CreateSparseSSPTable(uint32_t table_id, const std::vector<third_p
       auto it = std::find(server_thread_ids.begin(), server_thread_ids.end(), server_thread->GetServerId());
       recorder.reset(
           new VectorSparseSSPRecorder(model_staleness, speculation, ranges[it - server_thread_ids.begin()]));
+    } else if (sparse_ssp_recorder_type == SparseSSPRecorderType::Compact) {
+      auto it = std::find(server_thread_ids.begin(), server_thread_ids.end(), server_thread->GetServerId());
+      recorder.reset(
+          new CompactSparseSSPRecorder(model_staleness, speculation, ranges[it - server_thread_ids.begin()]));
     } else {
       CHECK(false) << "Unknown recorder type";
     }
@@ -167,4 +341,34 @@ void KVEngine::CreateSparseSSPTable(uint32_t table_id, const std::vector<third_p
   }
 }
 
+template <typename Val>
+void KVEngine::EnableNodeCache(uint32_t table_id) {
+  auto it = ssp_staleness_.find(table_id);
+  CHECK(it != ssp_staleness_.end()) << "The node cache is only supported by SSP tables";
+  CHECK(node_cache_map_.find(table_id) == node_cache_map_.end());
+  node_cache_map_[table_id].reset(new NodeCache<Val>(it->second));
+}
+
+template <typename Val>
+void KVEngine::EnableAddCombiner(uint32_t table_id, std::chrono::milliseconds deadline) {
+  auto it = model_types_.find(table_id);
+  CHECK(it != model_types_.end()) << "Unknown table " << table_id;
+  CHECK(it->second == ModelType::SSP || it->second == ModelType::BSP || it->second == ModelType::ASP)
+      << "The add combiner is only supported by BSP, SSP and ASP tables";
+  CHECK(add_combiner_map_.find(table_id) == add_combiner_map_.end());
+  CHECK(!dynamic_cast<OnlineRangePartitionManager*>(partition_manager_map_[table_id].get()))
+      << "The combined Adds would mix the layouts of the online rebalance";
+  CHECK(sender_);
+  add_combiner_map_[table_id].reset(new AddCombiner<Val>(table_id, sender_->GetMessageQueue(), deadline));
+}
+
+template <typename Val>
+void KVEngine::EnableGetCombiner(uint32_t table_id, std::chrono::microseconds window) {
+  CHECK(model_types_.find(table_id) != model_types_.end()) << "Unknown table " << table_id;
+  CHECK(get_combiner_map_.find(table_id) == get_combiner_map_.end());
+  CHECK(!dynamic_cast<OnlineRangePartitionManager*>(partition_manager_map_[table_id].get()))
+      << "The combined Gets would mix the layouts of the online rebalance";
+  get_combiner_map_[table_id].reset(new GetCombiner<Val>(window));
+}
+
 }  // namespace flexps
@@ -0,0 +1,76 @@
+#include "driver/range_planner.hpp"
+
+#include "glog/logging.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace flexps {
+
+RangePlanner::RangePlanner(const third_party::Range& key_range) : key_range_(key_range) {
+  CHECK_LT(key_range_.begin(), key_range_.end());
+}
+
+void RangePlanner::AddKeys(const third_party::SArray<Key>& keys) {
+  for (auto key : keys) {
+    CHECK_GE(key, key_range_.begin());
+    CHECK_LT(key, key_range_.end());
+    counts_[key] += 1;
+  }
+  num_samples_ += keys.size();
+}
+
+void RangePlanner::AddKeys(const std::vector<Key>& keys) { AddKeys(third_party::SArray<Key>(keys)); }
+
+std::vector<third_party::Range> RangePlanner::Plan(size_t num_ranges, double load_weight, bool dense) const {
+  CHECK_GT(num_ranges, 0);
+  CHECK_GE(load_weight, 0.);
+  CHECK_LE(load_weight, 1.);
+  std::vector<uint64_t> bounds(num_ranges + 1);
+  bounds[0] = key_range_.begin();
+  bounds[num_ranges] = key_range_.end();
+  for (size_t i = 1; i < num_ranges; ++i) {
+    // Without samples, fall back to equal width
+    bounds[i] = counts_.empty() ? key_range_.begin() + key_range_.size() * i / num_ranges
+                                : FindBoundary(static_cast<double>(i) / num_ranges, load_weight, dense);
+    bounds[i] = std::max(bounds[i], bounds[i - 1]);
+  }
+  std::vector<third_party::Range> ranges;
+  for (size_t i = 0; i < num_ranges; ++i)
+    ranges.emplace_back(bounds[i], bounds[i + 1]);
+  return ranges;
+}
+
+/*
+ * The cost of [begin, x) rises by a step at x = key + 1 for each sampled key (its accesses, and its
+ * bytes if sparse) and linearly in between if dense. So the boundary is searched segment by segment.
+ */
+uint64_t RangePlanner::FindBoundary(double target, double load_weight, bool dense) const {
+  // Tolerate the rounding of the summed costs, so that e.g. 10 keys of cost 0.05 reach 0.5
+  const double kEps = 1e-12;
+  const double load_per_sample = load_weight / num_samples_;
+  const double bytes_per_key = dense ? (1. - load_weight) / key_range_.size() : (1. - load_weight) / counts_.size();
+  const double slope = dense ? bytes_per_key : 0.;
+  double cost = 0.;  // of [begin, segment_begin)
+  uint64_t segment_begin = key_range_.begin();
+  auto it = counts_.begin();
+  while (true) {
+    const uint64_t segment_end = it == counts_.end() ? key_range_.end() : it->first;
+    // In [segment_begin, segment_end] the cost is cost + slope * (x - segment_begin)
+    const double end_cost = cost + slope * (segment_end - segment_begin);
+    if (end_cost + kEps >= target) {
+      if (cost + kEps >= target)
+        return segment_begin;
+      auto x = segment_begin + static_cast<uint64_t>(std::ceil((target - cost - kEps) / slope));
+      return std::min(x, segment_end);
+    }
+    if (it == counts_.end())
+      return key_range_.end();
+    // Step at x = key + 1
+    cost = end_cost + slope + it->second * load_per_sample + (dense ? 0. : bytes_per_key);
+    segment_begin = it->first + 1;
+    ++it;
+  }
+}
+
+}  // namespace flexps
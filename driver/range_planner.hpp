@@ -0,0 +1,45 @@
+#pragma once
+
+#include "base/magic.hpp"
+#include "base/third_party/range.h"
+#include "base/third_party/sarray.h"
+
+#include <cinttypes>
+#include <map>
+#include <vector>
+
+namespace flexps {
+
+/*
+ * Plan the ranges of a table from a sample of the keys the training accesses, e.g. the keys of some
+ * batches from BatchDataSampler::prepare_next_batch().
+ *
+ * The cost of a range is load_weight * (its share of the sampled accesses)
+ *   + (1 - load_weight) * (its share of the bytes stored),
+ * and Plan() splits key_range so that every server thread gets the same cost. The bytes are proportional
+ * to the width of a range for dense storage (StorageType::Vector), and to the distinct sampled keys in it
+ * for sparse storage (StorageType::Map).
+ *
+ * The ranges only depend on the sample, so every node must add the same sample to get the same ranges.
+ */
+class RangePlanner {
+ public:
+  explicit RangePlanner(const third_party::Range& key_range);
+
+  void AddKeys(const third_party::SArray<Key>& keys);
+  void AddKeys(const std::vector<Key>& keys);
+
+  std::vector<third_party::Range> Plan(size_t num_ranges, double load_weight = 0.5, bool dense = true) const;
+
+  uint64_t GetNumSamples() const { return num_samples_; }
+
+ private:
+  // The smallest boundary x such that the cost of [key_range_.begin(), x) is at least target
+  uint64_t FindBoundary(double target, double load_weight, bool dense) const;
+
+  third_party::Range key_range_;
+  std::map<Key, uint64_t> counts_;
+  uint64_t num_samples_ = 0;
+};
+
+}  // namespace flexps
@@ -0,0 +1,71 @@
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "driver/range_planner.hpp"
+
+namespace flexps {
+namespace {
+
+class TestRangePlanner : public testing::Test {
+ public:
+  TestRangePlanner() {}
+  ~TestRangePlanner() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+TEST_F(TestRangePlanner, NoSample) {
+  RangePlanner planner({0, 100});
+  auto ranges = planner.Plan(4);
+  ASSERT_EQ(ranges.size(), 4);
+  EXPECT_EQ(ranges[0].end(), 25);
+  EXPECT_EQ(ranges[2].end(), 75);
+  EXPECT_EQ(ranges[3].end(), 100);
+}
+
+TEST_F(TestRangePlanner, LoadOnly) {
+  RangePlanner planner({0, 1000});
+  // 4 accesses on each of [0, 10), 1 on each of [10, 50)
+  for (int i = 0; i < 4; ++i) {
+    std::vector<Key> keys;
+    for (Key key = 0; key < 10; ++key)
+      keys.push_back(key);
+    planner.AddKeys(keys);
+  }
+  std::vector<Key> keys;
+  for (Key key = 10; key < 50; ++key)
+    keys.push_back(key);
+  planner.AddKeys(keys);
+  EXPECT_EQ(planner.GetNumSamples(), 80);
+
+  auto ranges = planner.Plan(2, 1.);
+  EXPECT_EQ(ranges[0].begin(), 0);
+  EXPECT_EQ(ranges[0].end(), 10);
+  EXPECT_EQ(ranges[1].begin(), 10);
+  EXPECT_EQ(ranges[1].end(), 1000);
+  // Without load, the dense bytes are balanced by width
+  ranges = planner.Plan(2, 0.);
+  EXPECT_EQ(ranges[0].end(), 500);
+  // Without load, the sparse bytes are balanced by the distinct keys
+  ranges = planner.Plan(2, 0., false);
+  EXPECT_EQ(ranges[0].end(), 25);
+}
+
+TEST_F(TestRangePlanner, Mixed) {
+  RangePlanner planner({0, 1000});
+  planner.AddKeys(third_party::SArray<Key>({0, 1, 2, 3}));
+  // Half of the cost is the load on [0, 4), half the width: the boundary is where
+  // 0.5 + 0.5 * x / 1000 = 1, i.e. halfway
+  auto ranges = planner.Plan(2, 0.5);
+  EXPECT_EQ(ranges[0].end(), 4);
+  ranges = planner.Plan(4, 0.5);
+  EXPECT_EQ(ranges[0].end(), 2);
+  EXPECT_EQ(ranges[1].end(), 4);
+  EXPECT_EQ(ranges[2].end(), 500);
+  EXPECT_EQ(ranges[3].end(), 1000);
+}
+
+}  // namespace
+}  // namespace flexps
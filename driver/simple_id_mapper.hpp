@@ -22,7 +22,7 @@ class SimpleIdMapper : public AbstractIdMapper {
   // TODO(yuzhen): Make sure there is no thread-safety issue between (the Mailbox::Send and the engine thread).
   virtual uint32_t GetNodeIdForThread(uint32_t tid) override;
 
-  void Init(int num_server_threads_per_node = 1);
+  void Init(int num_server_threads_per_node = 1, int num_worker_helper_threads_per_node = 1);
   uint32_t AllocateWorkerThread(uint32_t node_id);
   void DeallocateWorkerThread(uint32_t node_id, uint32_t tid);
 
@@ -40,6 +40,20 @@ TEST_F(TestSimpleIdMapper, Init) {
   EXPECT_EQ(id_mapper.GetNodeIdForThread(0), 0);
 }
 
+TEST_F(TestSimpleIdMapper, MultipleWorkerHelperThreads) {
+  Node n1{0, "worker1", 12352};
+  Node n2{1, "worker1", 12353};
+  SimpleIdMapper id_mapper(n1, {n1, n2});
+  id_mapper.Init(2, 4);
+  auto helpers = id_mapper.GetWorkerHelperThreadsForId(1);
+  ASSERT_EQ(helpers.size(), 4);
+  for (uint32_t i = 0; i < helpers.size(); ++i) {
+    EXPECT_EQ(helpers[i], SimpleIdMapper::kMaxThreadsPerNode + SimpleIdMapper::kWorkerHelperThreadId + i);
+    EXPECT_EQ(id_mapper.GetNodeIdForThread(helpers[i]), 1);
+  }
+  EXPECT_EQ(id_mapper.GetServerThreadsForId(1).size(), 2);
+}
+
 TEST_F(TestSimpleIdMapper, AllocateDeallocateThread) {
   Node n1{0, "worker1", 12352};
   Node n2{1, "worker1", 12353};
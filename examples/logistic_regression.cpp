@@ -22,14 +22,15 @@ DEFINE_string(hdfs_namenode, "", "The hdfs namenode hostname");
 DEFINE_string(input, "", "The hdfs input url");
 DEFINE_int32(hdfs_namenode_port, -1, "The hdfs namenode port");
 
-DEFINE_string(kModelType, "", "ASP/SSP/BSP/SparseSSP");
+DEFINE_string(kModelType, "", "ASP/SSP/BSP/SparseSSP/QuorumBSP");
 DEFINE_string(kStorageType, "", "Map/Vector");
 DEFINE_int32(num_dims, 0, "number of dimensions");
 DEFINE_int32(batch_size, 100, "batch size of each epoch");
 DEFINE_int32(num_iters, 10, "number of iters");
 DEFINE_int32(kStaleness, 0, "stalness");
+DEFINE_double(kQuorumRatio, 1.0, "fraction of workers closing an iteration in QuorumBSP");
 DEFINE_int32(kSpeculation, 1, "speculation");
-DEFINE_string(kSparseSSPRecorderType, "", "None/Map/Vector");
+DEFINE_string(kSparseSSPRecorderType, "", "None/Map/Vector/Compact");
 DEFINE_int32(num_workers_per_node, 1, "num_workers_per_node");
 DEFINE_int32(with_injected_straggler, 0, "with injected straggler or not, 0/1");
 DEFINE_int32(num_servers_per_node, 1, "num_servers_per_node");
@@ -140,6 +141,8 @@ void Run() {
     model_type = ModelType::SSP;
   } else if (FLAGS_kModelType == "BSP") {
     model_type = ModelType::BSP;
+  } else if (FLAGS_kModelType == "QuorumBSP") {
+    model_type = ModelType::QuorumBSP;
   } else if (FLAGS_kModelType == "SparseSSP") {
     model_type = ModelType::SparseSSP;
   } else {
@@ -160,6 +163,8 @@ void Run() {
     sparse_ssp_recorder_type = SparseSSPRecorderType::Map;
   } else if (FLAGS_kSparseSSPRecorderType == "Vector") {
     sparse_ssp_recorder_type = SparseSSPRecorderType::Vector;
+  } else if (FLAGS_kSparseSSPRecorderType == "Compact") {
+    sparse_ssp_recorder_type = SparseSSPRecorderType::Compact;
   } else {
     CHECK(false) << "sparse_ssp_storage type error: " << FLAGS_kSparseSSPRecorderType;
   }
@@ -169,8 +174,10 @@ void Run() {
     engine.CreateSparseSSPTable<float>(kTableId, range, 
         model_type, storage_type, FLAGS_kStaleness, FLAGS_kSpeculation, sparse_ssp_recorder_type);
   } else {
+    TableOptions<float> options;
+    options.quorum_options.quorum_ratio = FLAGS_kQuorumRatio;
     engine.CreateTable<float>(kTableId, range, 
-        model_type, storage_type, FLAGS_kStaleness);
+        model_type, storage_type, FLAGS_kStaleness, 1, options);
   }
   engine.Barrier();
   // 3. Construct tasks
@@ -205,7 +212,8 @@ void Run() {
     std::chrono::steady_clock::time_point end_time;
     srand(time(0));
     //　TO DO: make it real LR algorithm
-    if (FLAGS_kModelType == "SSP" || FLAGS_kModelType == "ASP" || FLAGS_kModelType == "BSP") {  // normal mode
+    if (FLAGS_kModelType == "SSP" || FLAGS_kModelType == "ASP" || FLAGS_kModelType == "BSP" ||
+        FLAGS_kModelType == "QuorumBSP") {  // normal mode
       auto table = info.CreateKVClientTable<float>(kTableId);
       third_party::SArray<float> params;
       third_party::SArray<float> deltas;
@@ -22,7 +22,7 @@ DEFINE_string(kModelType, "", "ASP/SSP/BSP/SparseSSP");
 DEFINE_string(kStorageType, "", "Map/Vector");
 DEFINE_int32(kStaleness, 0, "stalness");
 DEFINE_int32(kSpeculation, 1, "speculation");
-DEFINE_string(kSparseSSPRecorderType, "", "None/Map/Vector");
+DEFINE_string(kSparseSSPRecorderType, "", "None/Map/Vector/Compact");
 DEFINE_int32(num_workers_per_node, 1, "num_workers_per_node");
 DEFINE_int32(with_injected_straggler, 0, "with injected straggler or not, 0/1");
 DEFINE_int32(num_servers_per_node, 1, "num_servers_per_node");
@@ -74,7 +74,8 @@ void Run() {
   CHECK_NE(FLAGS_my_id, -1);
   CHECK(!FLAGS_config_file.empty());
   CHECK(FLAGS_kModelType == "ASP" || FLAGS_kModelType == "BSP" || FLAGS_kModelType == "SSP" || FLAGS_kModelType == "SparseSSP");
-  CHECK(FLAGS_kSparseSSPRecorderType == "None" || FLAGS_kSparseSSPRecorderType == "Map" || FLAGS_kSparseSSPRecorderType == "Vector");
+  CHECK(FLAGS_kSparseSSPRecorderType == "None" || FLAGS_kSparseSSPRecorderType == "Map" || FLAGS_kSparseSSPRecorderType == "Vector" ||
+        FLAGS_kSparseSSPRecorderType == "Compact");
   CHECK(FLAGS_kStorageType == "Map" || FLAGS_kStorageType == "Vector");
   CHECK_GT(FLAGS_num_dims, 0);
   CHECK_GT(FLAGS_num_nonzeros, 0);
@@ -153,6 +154,8 @@ void Run() {
     sparse_ssp_recorder_type = SparseSSPRecorderType::Map;
   } else if (FLAGS_kSparseSSPRecorderType == "Vector") {
     sparse_ssp_recorder_type = SparseSSPRecorderType::Vector;
+  } else if (FLAGS_kSparseSSPRecorderType == "Compact") {
+    sparse_ssp_recorder_type = SparseSSPRecorderType::Compact;
   } else {
     CHECK(false) << "sparse_ssp_storage type error: " << FLAGS_kSparseSSPRecorderType;
   }
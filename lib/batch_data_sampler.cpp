@@ -1,5 +1,6 @@
 #include <vector>
 #include "base/third_party/sarray.h"
+#include "worker/key_sorter.hpp"
 
 namespace flexps {
 
@@ -41,8 +42,7 @@ class BatchDataSampler {
     third_party::SArray<Key> prepare_next_batch() {
         if (empty())
             return {};
-        third_party::SArray<Key> keys;
-        std::set<Key> s;
+        std::vector<Key> all_keys;
         for (int i = 0; i < batch_size_; ++ i) {
             auto& data = data_[cur_pos++];
             batch_data_[i] = const_cast<T*>(&data);
@@ -52,12 +52,12 @@ class BatchDataSampler {
         }
         for (auto data : batch_data_) {
             for (auto field : data->first) {
-              s.insert(field.first);
+              all_keys.push_back(field.first);
             }
         }
-        for (auto k : s) {
-          keys.push_back(k);
-        }
+        third_party::SArray<Key> keys;
+        std::vector<uint32_t> index;
+        SortUniqueKeys(all_keys.data(), all_keys.size(), &keys, &index);
         return keys;
     }
     const std::vector<T*>& get_data_ptrs() {
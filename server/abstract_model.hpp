@@ -3,6 +3,9 @@
 #include <cinttypes>
 #include "base/message.hpp"
 #include "base/threadsafe_queue.hpp"
+#include "server/abstract_storage.hpp"
+
+#include "glog/logging.h"
 
 namespace flexps {
 
@@ -12,7 +15,15 @@ class AbstractModel {
   virtual void Add(Message& msg) = 0;
   virtual void Get(Message& msg) = 0;
   virtual int GetProgress(int tid) = 0;
+  // The min clock of the worker threads, used to switch the layout of a table rebalanced online
+  virtual int GetMinClock() { CHECK(false) << "The min clock is not tracked by this model"; return -1; }
   virtual void ResetWorker(Message& msg) = 0;
+  // Handle the hot key replica published by another server thread, see SSPModel::EnableHotKeyReplication
+  virtual void ReplicaSync(Message& msg) { CHECK(false) << "Hot key replication is not supported by this model"; }
+  // Handle the quorum of a clock decided by another server thread, see QuorumBSPModel::SetServers
+  virtual void QuorumClose(Message& msg) { CHECK(false) << "The quorum is not supported by this model"; }
+  // The storage of the model, used to migrate keys in a repartition. nullptr if it cannot be repartitioned.
+  virtual AbstractStorage* GetStorage() { return nullptr; }
   virtual ~AbstractModel() {}
 };
 
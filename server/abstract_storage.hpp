@@ -1,6 +1,8 @@
 #pragma once
 
 #include "base/message.hpp"
+#include "base/third_party/range.h"
+#include "base/thread_pool.hpp"
 
 #include "glog/logging.h"
 
@@ -19,7 +21,79 @@ class AbstractStorage {
     else
       SubAdd(typed_keys, msg.data[1]);
   }
-  Message Get(Message& msg) {
+  /*
+   * Merge the Add into the pending delta of the storage instead of applying it.
+   * The merged delta is applied in one pass by FlushAdds().
+   */
+  void BufferAdd(Message& msg) {
+    CHECK(msg.data.size() == 2);
+    auto typed_keys = third_party::SArray<Key>(msg.data[0]);
+    if(msg.meta.flag == Flag::kAddChunk)
+      SubBufferAddChunk(typed_keys, msg.data[1]);
+    else
+      SubBufferAdd(typed_keys, msg.data[1]);
+  }
+  Message Get(Message& msg) { return DoGet(msg, false); }
+
+  /*
+   * MVCC reads: a storage with snapshot enabled publishes its current version as the snapshot in
+   * FinishIter(), and GetFromSnapshot() serves the Get from the last published snapshot.
+   * GetFromSnapshot() is thread-safe, it may run on reader threads while the server thread applies Adds.
+   */
+  virtual bool SupportSnapshot() const { return false; }
+  Message GetFromSnapshot(Message& msg) {
+    CHECK(SupportSnapshot());
+    return DoGet(msg, true);
+  }
+  
+  virtual void SubAdd(const third_party::SArray<Key>& typed_keys, 
+      const third_party::SArray<char>& vals) = 0;
+  virtual void SubAddChunk(const third_party::SArray<Key>& typed_keys, 
+      const third_party::SArray<char>& vals) = 0;
+  virtual void SubBufferAdd(const third_party::SArray<Key>& typed_keys,
+      const third_party::SArray<char>& vals) = 0;
+  virtual void SubBufferAddChunk(const third_party::SArray<Key>& typed_keys,
+      const third_party::SArray<char>& vals) = 0;
+  // Apply the Adds merged by BufferAdd()
+  virtual void FlushAdds() = 0;
+  virtual third_party::SArray<char> SubGet(const third_party::SArray<Key>& typed_keys) = 0;
+  virtual third_party::SArray<char> SubGetChunk(const third_party::SArray<Key>& typed_keys) = 0;
+
+  /*
+   * Overwrite the values of keys in range with vals, which stores the values densely in key order.
+   * Used to warm start the storage from a model file.
+   */
+  virtual void LoadRange(const third_party::Range& range, const third_party::SArray<char>& vals) = 0;
+
+  /*
+   * Key migration for repartitioning, see KVEngine::RebalanceBetweenTasks. Adds must be flushed before.
+   * ExportRange() returns the stored keys in range in key order and their values.
+   * ResetRange() puts the storage in charge of range, the keys out of range are dropped.
+   * ImportKeys() overwrites the values of keys exported by another storage.
+   */
+  virtual void ExportRange(const third_party::Range& range, third_party::SArray<Key>* keys,
+                           third_party::SArray<char>* vals) = 0;
+  virtual void ResetRange(const third_party::Range& range) = 0;
+  virtual void ImportKeys(const third_party::SArray<Key>& keys, const third_party::SArray<char>& vals) = 0;
+
+  virtual third_party::SArray<char> SubGetSnapshot(const third_party::SArray<Key>& typed_keys) {
+    CHECK(false) << "Snapshot is not supported";
+    return third_party::SArray<char>();
+  }
+  virtual third_party::SArray<char> SubGetChunkSnapshot(const third_party::SArray<Key>& typed_keys) {
+    CHECK(false) << "Snapshot is not supported";
+    return third_party::SArray<char>();
+  }
+
+  virtual void FinishIter() = 0;
+
+  // Large requests may be split and applied in parallel by executor, see ServerThread. Ignored by default.
+  virtual void SetExecutor(ThreadPool* executor) {}
+
+  virtual ~AbstractStorage() {}
+
+ private:
+  Message DoGet(Message& msg, bool from_snapshot) {
     CHECK(msg.data.size() == 1);
     auto typed_keys = third_party::SArray<Key>(msg.data[0]);
     Message reply;
@@ -39,25 +113,19 @@ class AbstractStorage {
     }
     reply.meta.model_id = msg.meta.model_id;
     reply.meta.version = msg.meta.version;
+    reply.meta.req_id = msg.meta.req_id;
     third_party::SArray<Key> reply_keys(typed_keys);
     third_party::SArray<char> reply_vals;
     if(msg.meta.flag == Flag::kGetChunk)
-      reply_vals = SubGetChunk(reply_keys);
+      reply_vals = from_snapshot ? SubGetChunkSnapshot(reply_keys) : SubGetChunk(reply_keys);
     else
-      reply_vals = SubGet(reply_keys);
-    reply.AddData<Key>(reply_keys);
+      reply_vals = from_snapshot ? SubGetSnapshot(reply_keys) : SubGet(reply_keys);
+    // The client places a key-less reply by its req_id
+    if (msg.meta.req_id == 0)
+      reply.AddData<Key>(reply_keys);
     reply.AddData<char>(reply_vals);
     return reply;
   }
-  
-  virtual void SubAdd(const third_party::SArray<Key>& typed_keys, 
-      const third_party::SArray<char>& vals) = 0;
-  virtual void SubAddChunk(const third_party::SArray<Key>& typed_keys, 
-      const third_party::SArray<char>& vals) = 0;
-  virtual third_party::SArray<char> SubGet(const third_party::SArray<Key>& typed_keys) = 0;
-  virtual third_party::SArray<char> SubGetChunk(const third_party::SArray<Key>& typed_keys) = 0;
-
-  virtual void FinishIter() = 0;
 };
 
 }  // namespace flexps
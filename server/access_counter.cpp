@@ -0,0 +1,55 @@
+#include "server/access_counter.hpp"
+
+#include <algorithm>
+
+#include "glog/logging.h"
+
+namespace flexps {
+
+AccessCounter::AccessCounter(uint32_t sample_every) : sample_every_(sample_every) { CHECK_GT(sample_every_, 0); }
+
+void AccessCounter::Count(const third_party::SArray<Key>& keys) {
+  if (num_requests_++ % sample_every_ != 0)
+    return;
+  for (auto key : keys) {
+    counts_[key] += 1;
+  }
+}
+
+std::vector<Key> AccessCounter::PopHotKeys(size_t k, double hot_factor) {
+  std::vector<std::pair<uint32_t, Key>> candidates;
+  if (!counts_.empty()) {
+    uint64_t total = 0;
+    for (const auto& kv : counts_) {
+      total += kv.second;
+    }
+    const double threshold = std::max(2.0, hot_factor * total / counts_.size());
+    for (const auto& kv : counts_) {
+      if (kv.second >= threshold)
+        candidates.push_back({kv.second, kv.first});
+    }
+  }
+  if (candidates.size() > k) {
+    std::nth_element(candidates.begin(), candidates.begin() + k, candidates.end(),
+                     [](const std::pair<uint32_t, Key>& a, const std::pair<uint32_t, Key>& b) { return a > b; });
+    candidates.resize(k);
+  }
+  std::vector<Key> hot_keys;
+  hot_keys.reserve(candidates.size());
+  for (const auto& candidate : candidates) {
+    hot_keys.push_back(candidate.second);
+  }
+  std::sort(hot_keys.begin(), hot_keys.end());
+
+  // Decay
+  for (auto it = counts_.begin(); it != counts_.end();) {
+    it->second /= 2;
+    if (it->second == 0)
+      it = counts_.erase(it);
+    else
+      ++it;
+  }
+  return hot_keys;
+}
+
+}  // namespace flexps
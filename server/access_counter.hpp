@@ -0,0 +1,37 @@
+#pragma once
+
+#include "base/magic.hpp"
+#include "base/third_party/sarray.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace flexps {
+
+/*
+ * Count the accesses of keys on a server thread to detect the hot keys.
+ *
+ * Only the keys of every sample_every-th request are counted to bound the overhead, and the counts
+ * are halved whenever the hot keys are popped, so that the counter follows the recent accesses.
+ */
+class AccessCounter {
+ public:
+  explicit AccessCounter(uint32_t sample_every = 1);
+
+  void Count(const third_party::SArray<Key>& keys);
+
+  /*
+   * Return at most k keys which are accessed at least hot_factor times as often as the average
+   * counted key (and at least twice), in ascending order.
+   */
+  std::vector<Key> PopHotKeys(size_t k, double hot_factor);
+
+  size_t Size() const { return counts_.size(); }
+
+ private:
+  uint32_t sample_every_;
+  uint32_t num_requests_ = 0;
+  std::unordered_map<Key, uint32_t> counts_;
+};
+
+}  // namespace flexps
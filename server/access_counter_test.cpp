@@ -0,0 +1,53 @@
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "server/access_counter.hpp"
+
+namespace flexps {
+namespace {
+
+class TestAccessCounter : public testing::Test {
+ public:
+  TestAccessCounter() {}
+  ~TestAccessCounter() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+TEST_F(TestAccessCounter, PopHotKeys) {
+  AccessCounter counter;
+  third_party::SArray<Key> cold;
+  for (Key key = 0; key < 100; ++key)
+    cold.push_back(key);
+  counter.Count(cold);
+  for (int i = 0; i < 50; ++i) {
+    counter.Count(third_party::SArray<Key>({7, 42}));
+  }
+  counter.Count(third_party::SArray<Key>({3}));
+  EXPECT_EQ(counter.Size(), 100);
+
+  auto hot_keys = counter.PopHotKeys(10, 4.0);
+  ASSERT_EQ(hot_keys.size(), 2);
+  EXPECT_EQ(hot_keys[0], 7);
+  EXPECT_EQ(hot_keys[1], 42);
+  // Decayed, only 3, 7 and 42 are left
+  EXPECT_EQ(counter.Size(), 3);
+
+  hot_keys = counter.PopHotKeys(1, 1.0);
+  ASSERT_EQ(hot_keys.size(), 1);
+}
+
+TEST_F(TestAccessCounter, Sample) {
+  AccessCounter counter(4);
+  for (Key key = 0; key < 8; ++key) {
+    counter.Count(third_party::SArray<Key>({key}));
+  }
+  // Only the 0th and the 4th requests are counted
+  EXPECT_EQ(counter.Size(), 2);
+  EXPECT_TRUE(counter.PopHotKeys(10, 1.0).empty());  // counted only once each
+}
+
+}  // namespace
+}  // namespace flexps
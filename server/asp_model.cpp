@@ -1,26 +1,32 @@
 #include "server/asp_model.hpp"
+#include "server/snapshot_reader.hpp"
 #include "glog/logging.h"
 
 namespace flexps {
 
 ASPModel::ASPModel(uint32_t model_id, std::unique_ptr<AbstractStorage>&& storage_ptr,
-                   ThreadsafeQueue<Message>* reply_queue)
-    : model_id_(model_id), reply_queue_(reply_queue) {
+                   ThreadsafeQueue<Message>* reply_queue, ThreadPool* reader_pool)
+    : model_id_(model_id), reply_queue_(reply_queue), reader_pool_(reader_pool) {
   this->storage_ = std::move(storage_ptr);
 }
 
 void ASPModel::Clock(Message& msg) {
-  progress_tracker_.AdvanceAndGetChangedMinClock(msg.meta.sender);
+  int updated_min_clock = progress_tracker_.AdvanceAndGetChangedMinClock(msg.meta.sender);
+  if (updated_min_clock != -1) {  // min clock updated, publish the snapshot if any
+    storage_->FlushAdds();
+    storage_->FinishIter();
+  }
 }
 
 void ASPModel::Add(Message& msg) {
   CHECK(progress_tracker_.CheckThreadValid(msg.meta.sender));
-  storage_->Add(msg);
+  // Merged with other Adds until the next Get
+  storage_->BufferAdd(msg);
 }
 
 void ASPModel::Get(Message& msg) {
   CHECK(progress_tracker_.CheckThreadValid(msg.meta.sender));
-  reply_queue_->Push(storage_->Get(msg));
+  ReplyGet(storage_.get(), msg, reply_queue_, reader_pool_, true);
 }
 
 int ASPModel::GetProgress(int tid) { return progress_tracker_.GetProgress(tid); }
@@ -3,6 +3,7 @@
 #include "server/abstract_model.hpp"
 
 #include "base/message.hpp"
+#include "base/thread_pool.hpp"
 #include "base/threadsafe_queue.hpp"
 #include "server/abstract_storage.hpp"
 #include "server/pending_buffer.hpp"
@@ -14,18 +15,22 @@ namespace flexps {
 class ASPModel : public AbstractModel {
  public:
   explicit ASPModel(uint32_t model_id, std::unique_ptr<AbstractStorage>&& storage_ptr,
-                    ThreadsafeQueue<Message>* reply_queue);
+                    ThreadsafeQueue<Message>* reply_queue, ThreadPool* reader_pool = nullptr);
 
   virtual void Clock(Message& msg) override;
   virtual void Add(Message& msg) override;
   virtual void Get(Message& msg) override;
   virtual int GetProgress(int tid) override;
+  virtual int GetMinClock() override { return progress_tracker_.GetMinClock(); }
   virtual void ResetWorker(Message& msg) override;
+  virtual AbstractStorage* GetStorage() override { return storage_.get(); }
 
  private:
   uint32_t model_id_;
 
   ThreadsafeQueue<Message>* reply_queue_;
+  // Serves the Gets from the storage snapshot if set and the storage supports it. Not owned.
+  ThreadPool* reader_pool_;
   std::unique_ptr<AbstractStorage> storage_;
   ProgressTracker progress_tracker_;
 };
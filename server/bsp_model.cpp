@@ -1,11 +1,12 @@
 #include "server/bsp_model.hpp"
+#include "server/snapshot_reader.hpp"
 #include "glog/logging.h"
 
 namespace flexps {
 
 BSPModel::BSPModel(uint32_t model_id, std::unique_ptr<AbstractStorage>&& storage_ptr,
-                   ThreadsafeQueue<Message>* reply_queue)
-    : model_id_(model_id), reply_queue_(reply_queue) {
+                   ThreadsafeQueue<Message>* reply_queue, ThreadPool* reader_pool)
+    : model_id_(model_id), reply_queue_(reply_queue), reader_pool_(reader_pool) {
   this->storage_ = std::move(storage_ptr);
 }
 
@@ -14,10 +15,8 @@ void BSPModel::Clock(Message& msg) {
   int progress = progress_tracker_.GetProgress(msg.meta.sender);
   CHECK_LE(progress, progress_tracker_.GetMinClock() + 1);
   if (updated_min_clock != -1) {  // min clock updated
-    for (auto add_req : add_buffer_) {
-      storage_->Add(add_req);
-    }
-    add_buffer_.clear();
+    storage_->FlushAdds();
+    num_add_pending_ = 0;
 
     for (auto get_req : get_buffer_) {
       reply_queue_->Push(storage_->Get(get_req));
@@ -32,7 +31,8 @@ void BSPModel::Add(Message& msg) {
   CHECK(progress_tracker_.CheckThreadValid(msg.meta.sender));
   int progress = progress_tracker_.GetProgress(msg.meta.sender);
   if (progress == progress_tracker_.GetMinClock()) {
-    add_buffer_.push_back(msg);
+    storage_->BufferAdd(msg);
+    num_add_pending_ += 1;
   } else {
     CHECK(false) << "progress error in BSPModel::Add";
   }
@@ -44,7 +44,8 @@ void BSPModel::Get(Message& msg) {
   if (progress == progress_tracker_.GetMinClock() + 1) {
     get_buffer_.push_back(msg);
   } else if (progress == progress_tracker_.GetMinClock()) {
-    reply_queue_->Push(storage_->Get(msg));
+    // The Adds of this clock are not visible until the clock ends
+    ReplyGet(storage_.get(), msg, reply_queue_, reader_pool_, false);
   } else {
     CHECK(false) << "progress error in BSPModel::Get { get progress: " << progress << ", min clock: " << progress_tracker_.GetMinClock() << " }";
   }
@@ -54,7 +55,7 @@ int BSPModel::GetProgress(int tid) { return progress_tracker_.GetProgress(tid);
 
 int BSPModel::GetGetPendingSize() { return get_buffer_.size(); }
 
-int BSPModel::GetAddPendingSize() { return add_buffer_.size(); }
+int BSPModel::GetAddPendingSize() { return num_add_pending_; }
 
 void BSPModel::ResetWorker(Message& msg) {
   CHECK_EQ(msg.data.size(), 1);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "base/magic.hpp"
+#include "base/third_party/sarray.h"
+
+#include "glog/logging.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace flexps {
+
+/*
+ * The hot keys replicated to a server thread, received from the owner server threads of the keys.
+ *
+ * Each owner publishes all its hot keys with their values at once, tagged with the version (min clock)
+ * of the owner, so that a replica can tell whether it is fresh enough for a Get. As the clocks restart
+ * from 0 in each task, the version is only valid in the epoch (task) it is published.
+ */
+class HotKeyReplicas {
+ public:
+  // keys must be in ascending order
+  void Update(uint32_t owner, const third_party::SArray<Key>& keys, const third_party::SArray<char>& vals,
+              int version, int epoch) {
+    CHECK(keys.empty() || vals.size() % keys.size() == 0);
+    Replica& replica = replicas_[owner];
+    replica.keys = keys;
+    replica.vals = vals;
+    replica.version = version;
+    replica.epoch = epoch;
+  }
+
+  // Return -1 if nothing is received from owner in epoch
+  int GetVersion(uint32_t owner, int epoch) const {
+    auto it = replicas_.find(owner);
+    return (it == replicas_.end() || it->second.epoch != epoch) ? -1 : it->second.version;
+  }
+
+  /*
+   * Look up the values of keys (in ascending order) replicated from owner.
+   * Return false if some of the keys are not replicated.
+   */
+  bool Get(uint32_t owner, const third_party::SArray<Key>& keys, third_party::SArray<char>* vals) const {
+    auto it = replicas_.find(owner);
+    if (it == replicas_.end() || it->second.keys.empty())
+      return keys.empty();
+    const Replica& replica = it->second;
+    const size_t val_size = replica.vals.size() / replica.keys.size();
+    third_party::SArray<char> result(keys.size() * val_size);
+    auto pos = replica.keys.begin();
+    for (size_t i = 0; i < keys.size(); ++i) {
+      pos = std::lower_bound(pos, replica.keys.end(), keys[i]);
+      if (pos == replica.keys.end() || *pos != keys[i])
+        return false;
+      memcpy(result.data() + i * val_size, replica.vals.data() + (pos - replica.keys.begin()) * val_size, val_size);
+    }
+    *vals = result;
+    return true;
+  }
+
+ private:
+  struct Replica {
+    third_party::SArray<Key> keys;
+    third_party::SArray<char> vals;
+    int version;
+    int epoch;
+  };
+  std::unordered_map<uint32_t, Replica> replicas_;
+};
+
+}  // namespace flexps
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "base/magic.hpp"
+
+#include <cinttypes>
+#include <cmath>
+#include <functional>
+
+namespace flexps {
+
+/*
+ * Initializer gives the initial value of a key, it is applied by the server storage
+ * lazily when a key is first touched.
+ *
+ * The provided random initializers derive the value from a hash of (seed, key) instead of a
+ * random engine, so that the value of a key does not depend on the order the keys are touched
+ * and an untouched key can be read without being stored.
+ */
+template <typename Val>
+using Initializer = std::function<Val(Key)>;
+
+// splitmix64 finalizer
+inline uint64_t HashKey(uint64_t seed, Key key) {
+  uint64_t z = seed + 0x9e3779b97f4a7c15ULL * (static_cast<uint64_t>(key) + 1);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Map a hash to a double in (0, 1]
+inline double HashToUnit(uint64_t hash) {
+  return static_cast<double>((hash >> 11) + 1) / static_cast<double>(1ULL << 53);
+}
+
+template <typename Val>
+Initializer<Val> ConstantInitializer(Val val) {
+  return [val](Key) { return val; };
+}
+
+template <typename Val>
+Initializer<Val> UniformInitializer(Val low, Val high, uint64_t seed) {
+  return [low, high, seed](Key key) {
+    return static_cast<Val>(low + (high - low) * HashToUnit(HashKey(seed, key)));
+  };
+}
+
+// Box-Muller transform on two independent hashes of the key
+template <typename Val>
+Initializer<Val> NormalInitializer(Val mean, Val stddev, uint64_t seed) {
+  return [mean, stddev, seed](Key key) {
+    uint64_t h = HashKey(seed, key);
+    double u1 = HashToUnit(h);
+    double u2 = HashToUnit(HashKey(h, key));
+    return static_cast<Val>(mean + stddev * std::sqrt(-2.0 * std::log(u1)) * std::cos(2 * M_PI * u2));
+  };
+}
+
+/*
+ * The general form of the hashed initializers: func maps the per-key hash to a value.
+ */
+template <typename Val>
+Initializer<Val> HashedInitializer(const std::function<Val(uint64_t)>& func, uint64_t seed) {
+  return [func, seed](Key key) { return func(HashKey(seed, key)); };
+}
+
+}  // namespace flexps
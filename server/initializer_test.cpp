@@ -0,0 +1,74 @@
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "server/initializer.hpp"
+#include "server/vector_storage.hpp"
+
+namespace flexps {
+namespace {
+
+class TestInitializer : public testing::Test {
+ public:
+  TestInitializer() {}
+  ~TestInitializer() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+TEST_F(TestInitializer, Constant) {
+  auto initializer = ConstantInitializer<int>(3);
+  EXPECT_EQ(initializer(0), 3);
+  EXPECT_EQ(initializer(100), 3);
+}
+
+TEST_F(TestInitializer, UniformDeterministic) {
+  auto a = UniformInitializer<float>(-0.1, 0.1, 42);
+  auto b = UniformInitializer<float>(-0.1, 0.1, 42);
+  auto c = UniformInitializer<float>(-0.1, 0.1, 43);
+  int num_diff = 0;
+  for (Key key = 0; key < 1000; ++key) {
+    EXPECT_EQ(a(key), b(key));
+    EXPECT_GE(a(key), -0.1f);
+    EXPECT_LE(a(key), 0.1f);
+    if (a(key) != c(key))
+      num_diff += 1;
+  }
+  EXPECT_GT(num_diff, 990);
+}
+
+TEST_F(TestInitializer, Normal) {
+  auto initializer = NormalInitializer<double>(1.0, 2.0, 5);
+  const int n = 100000;
+  double sum = 0, sq_sum = 0;
+  for (Key key = 0; key < n; ++key) {
+    double v = initializer(key);
+    sum += v;
+    sq_sum += v * v;
+  }
+  double mean = sum / n;
+  double var = sq_sum / n - mean * mean;
+  EXPECT_NEAR(mean, 1.0, 0.05);
+  EXPECT_NEAR(var, 4.0, 0.1);
+}
+
+TEST_F(TestInitializer, Hashed) {
+  auto initializer = HashedInitializer<int>([](uint64_t hash) { return hash % 10; }, 1);
+  for (Key key = 0; key < 100; ++key) {
+    EXPECT_EQ(initializer(key), HashKey(1, key) % 10);
+  }
+}
+
+TEST_F(TestInitializer, VectorStorage) {
+  auto initializer = UniformInitializer<float>(0, 1, 3);
+  VectorStorage<float> s({10, 20}, 1, initializer);
+  third_party::SArray<Key> keys({10, 15, 19});
+  third_party::SArray<float> ret = third_party::SArray<float>(s.SubGet(keys));
+  for (int i = 0; i < keys.size(); ++i) {
+    EXPECT_EQ(ret[i], initializer(keys[i]));
+  }
+}
+
+}  // namespace
+}  // namespace flexps
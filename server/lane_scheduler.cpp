@@ -0,0 +1,75 @@
+#include "server/lane_scheduler.hpp"
+
+#include "glog/logging.h"
+
+namespace flexps {
+
+LaneScheduler::LaneScheduler(const std::vector<int>& weights) : weights_(weights), credits_(weights) {
+  CHECK_EQ(weights_.size(), kNumLanes);
+  for (int i = 0; i < kNumLanes; ++i) {
+    CHECK_GT(weights_[i], 0);
+    depths_[i] = 0;
+  }
+}
+
+Lane LaneScheduler::GetLane(Flag flag) {
+  switch (flag) {
+  case Flag::kClock:
+  case Flag::kResetWorkerInModel:
+  case Flag::kQuorumClose:
+    return Lane::kControl;
+  case Flag::kGet:
+  case Flag::kGetChunk:
+  case Flag::kGetReplica:
+    return Lane::kRead;
+  default:
+    return Lane::kWrite;
+  }
+}
+
+void LaneScheduler::Push(Message&& msg) {
+  StreamId stream_id = (static_cast<uint64_t>(static_cast<uint32_t>(msg.meta.sender)) << 32) | msg.meta.model_id;
+  depths_[static_cast<int>(GetLane(msg.meta.flag))] += 1;
+  size_ += 1;
+  auto& stream = streams_[stream_id];
+  stream.push_back(std::move(msg));
+  if (stream.size() == 1)
+    Schedule(stream_id);
+}
+
+bool LaneScheduler::Pop(Message* msg) {
+  if (size_ == 0)
+    return false;
+  int lane = 0;
+  while (lane < kNumLanes && (lanes_[lane].empty() || credits_[lane] == 0))
+    lane += 1;
+  if (lane == kNumLanes) {
+    // The non-empty lanes have used up their weights, start a new round
+    credits_ = weights_;
+    lane = 0;
+    while (lanes_[lane].empty())
+      lane += 1;
+  }
+  credits_[lane] -= 1;
+
+  StreamId stream_id = lanes_[lane].front();
+  lanes_[lane].pop_front();
+  auto it = streams_.find(stream_id);
+  CHECK(it != streams_.end());
+  *msg = std::move(it->second.front());
+  it->second.pop_front();
+  depths_[static_cast<int>(GetLane(msg->meta.flag))] -= 1;
+  size_ -= 1;
+  if (it->second.empty())
+    streams_.erase(it);
+  else
+    Schedule(stream_id);
+  return true;
+}
+
+void LaneScheduler::Schedule(StreamId stream_id) {
+  const Message& first = streams_[stream_id].front();
+  lanes_[static_cast<int>(GetLane(first.meta.flag))].push_back(stream_id);
+}
+
+}  // namespace flexps
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "base/message.hpp"
+
+#include <atomic>
+#include <cinttypes>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+namespace flexps {
+
+/*
+ * The priority lanes of the requests to a server thread.
+ *
+ * kControl: kClock and kResetWorkerInModel, a late Clock holds back the min clock of SSP/BSP.
+ * kRead: the Gets, a worker is blocked until they are replied.
+ * kWrite: the Adds and everything else.
+ */
+enum class Lane : int { kControl, kRead, kWrite };
+const int kNumLanes = 3;
+
+/*
+ * Schedule the requests to a server thread by weighted round robin over the lanes.
+ *
+ * In each round a non-empty lane is served at most its weight times, in the order of the lanes,
+ * and a new round starts when the non-empty lanes have used up their weights. So a lane waits for
+ * at most the sum of the other weights, the Adds are never starved by a stream of Gets.
+ *
+ * The requests of the same (sender, model) are popped in the order they are pushed, whatever their
+ * lanes: a worker's Clock must not overtake its Adds, nor its Get its own Adds. Only the requests
+ * of different senders are reordered. This is done by queueing the streams instead of the messages:
+ * a stream waits in the lane of its first message.
+ *
+ * Not thread-safe, except GetDepth().
+ */
+class LaneScheduler {
+ public:
+  explicit LaneScheduler(const std::vector<int>& weights = {4, 2, 1});
+
+  static Lane GetLane(Flag flag);
+
+  void Push(Message&& msg);
+  // Return false if there is no message
+  bool Pop(Message* msg);
+  bool Empty() const { return size_ == 0; }
+  // The number of pending messages of the lane, may be called by other threads
+  int GetDepth(Lane lane) const { return depths_[static_cast<int>(lane)].load(std::memory_order_relaxed); }
+
+ private:
+  // (sender, model_id)
+  using StreamId = uint64_t;
+  void Schedule(StreamId stream_id);
+
+  std::vector<int> weights_;
+  std::vector<int> credits_;
+  std::unordered_map<StreamId, std::deque<Message>> streams_;
+  std::deque<StreamId> lanes_[kNumLanes];  // the streams whose first message is in the lane
+  std::atomic<int> depths_[kNumLanes];
+  size_t size_ = 0;
+};
+
+}  // namespace flexps
@@ -0,0 +1,93 @@
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "server/lane_scheduler.hpp"
+
+namespace flexps {
+namespace {
+
+class TestLaneScheduler : public testing::Test {
+ public:
+  TestLaneScheduler() {}
+  ~TestLaneScheduler() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+Message MakeMessage(Flag flag, int sender, uint32_t model_id = 0) {
+  Message msg;
+  msg.meta.flag = flag;
+  msg.meta.sender = sender;
+  msg.meta.model_id = model_id;
+  return msg;
+}
+
+std::vector<Flag> PopAll(LaneScheduler* scheduler) {
+  std::vector<Flag> flags;
+  Message msg;
+  while (scheduler->Pop(&msg))
+    flags.push_back(msg.meta.flag);
+  return flags;
+}
+
+TEST_F(TestLaneScheduler, Weighted) {
+  LaneScheduler scheduler({2, 1, 1});
+  // Different senders, so that they can be reordered
+  for (int i = 0; i < 3; ++i)
+    scheduler.Push(MakeMessage(Flag::kAdd, i));
+  for (int i = 0; i < 3; ++i)
+    scheduler.Push(MakeMessage(Flag::kGet, 10 + i));
+  for (int i = 0; i < 3; ++i)
+    scheduler.Push(MakeMessage(Flag::kClock, 20 + i));
+  EXPECT_EQ(scheduler.GetDepth(Lane::kControl), 3);
+  EXPECT_EQ(scheduler.GetDepth(Lane::kRead), 3);
+  EXPECT_EQ(scheduler.GetDepth(Lane::kWrite), 3);
+
+  std::vector<Flag> expected{Flag::kClock, Flag::kClock, Flag::kGet, Flag::kAdd,  // round 1
+                             Flag::kClock, Flag::kGet, Flag::kAdd,                // round 2
+                             Flag::kGet, Flag::kAdd};                             // round 3
+  EXPECT_EQ(PopAll(&scheduler), expected);
+  EXPECT_TRUE(scheduler.Empty());
+  EXPECT_EQ(scheduler.GetDepth(Lane::kControl), 0);
+  EXPECT_EQ(scheduler.GetDepth(Lane::kWrite), 0);
+}
+
+TEST_F(TestLaneScheduler, NoStarvation) {
+  LaneScheduler scheduler({4, 2, 1});
+  scheduler.Push(MakeMessage(Flag::kAdd, 0));
+  for (int i = 0; i < 20; ++i)
+    scheduler.Push(MakeMessage(Flag::kGet, 10 + i));
+  std::vector<Flag> flags = PopAll(&scheduler);
+  ASSERT_EQ(flags.size(), 21);
+  // The Add waits for at most one round of Gets
+  EXPECT_EQ(flags[2], Flag::kAdd);
+}
+
+TEST_F(TestLaneScheduler, OrderPerSenderAndModel) {
+  LaneScheduler scheduler;
+  // A worker's Clock and Get never overtake its Add
+  scheduler.Push(MakeMessage(Flag::kAdd, 0));
+  scheduler.Push(MakeMessage(Flag::kClock, 0));
+  scheduler.Push(MakeMessage(Flag::kGet, 0));
+  // Another model of the same worker is another stream
+  scheduler.Push(MakeMessage(Flag::kClock, 0, 1));
+  scheduler.Push(MakeMessage(Flag::kGet, 1));
+
+  std::vector<Message> msgs;
+  Message msg;
+  while (scheduler.Pop(&msg))
+    msgs.push_back(msg);
+  ASSERT_EQ(msgs.size(), 5);
+  EXPECT_EQ(msgs[0].meta.flag, Flag::kClock);
+  EXPECT_EQ(msgs[0].meta.model_id, 1);
+  EXPECT_EQ(msgs[1].meta.flag, Flag::kGet);
+  EXPECT_EQ(msgs[1].meta.sender, 1);
+  EXPECT_EQ(msgs[2].meta.flag, Flag::kAdd);
+  EXPECT_EQ(msgs[3].meta.flag, Flag::kClock);
+  EXPECT_EQ(msgs[4].meta.flag, Flag::kGet);
+}
+
+}  // namespace
+}  // namespace flexps
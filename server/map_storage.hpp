@@ -2,23 +2,31 @@
 
 #include "base/message.hpp"
 #include "server/abstract_storage.hpp"
+#include "server/initializer.hpp"
 
 #include "glog/logging.h"
 
+#include <iterator>
 #include <map>
+#include <unordered_map>
 
 namespace flexps {
 
+/*
+ * Keys are stored only after they are updated. A key that is not stored has the value given by the
+ * initializer (or Val() without initializer), so Gets do not grow the map.
+ */
 template <typename Val>
 class MapStorage : public AbstractStorage {
  public:
-  MapStorage(uint32_t chunk_size = 1): chunk_size_(chunk_size) {}
+  MapStorage(uint32_t chunk_size = 1, const Initializer<Val>& initializer = nullptr)
+      : chunk_size_(chunk_size), initializer_(initializer) {}
 
   virtual void SubAdd(const third_party::SArray<Key>& typed_keys, 
       const third_party::SArray<char>& vals) override {
     auto typed_vals = third_party::SArray<Val>(vals);
     for (size_t i = 0; i < typed_keys.size(); i++)
-      storage_[typed_keys[i]] += typed_vals[i];
+      Touch(typed_keys[i]) += typed_vals[i];
   }
 
   virtual void SubAddChunk(const third_party::SArray<Key>& typed_keys, 
@@ -27,13 +35,37 @@ class MapStorage : public AbstractStorage {
     CHECK_EQ(typed_vals.size()/typed_keys.size(), chunk_size_);
     for (size_t i = 0; i < typed_keys.size(); i++)
       for (size_t j = 0; j < chunk_size_; j++)
-        storage_[typed_keys[i] * chunk_size_ + j] += typed_vals[i * chunk_size_ + j];
+        Touch(typed_keys[i] * chunk_size_ + j) += typed_vals[i * chunk_size_ + j];
+  }
+
+  virtual void SubBufferAdd(const third_party::SArray<Key>& typed_keys,
+      const third_party::SArray<char>& vals) override {
+    auto typed_vals = third_party::SArray<Val>(vals);
+    for (size_t i = 0; i < typed_keys.size(); i++)
+      delta_[typed_keys[i]] += typed_vals[i];
+  }
+
+  virtual void SubBufferAddChunk(const third_party::SArray<Key>& typed_keys,
+      const third_party::SArray<char>& vals) override {
+    auto typed_vals = third_party::SArray<Val>(vals);
+    CHECK_EQ(typed_vals.size()/typed_keys.size(), chunk_size_);
+    for (size_t i = 0; i < typed_keys.size(); i++)
+      for (size_t j = 0; j < chunk_size_; j++)
+        delta_[typed_keys[i] * chunk_size_ + j] += typed_vals[i * chunk_size_ + j];
+  }
+
+  virtual void FlushAdds() override {
+    if (delta_.empty())
+      return;
+    for (auto& kv : delta_)
+      Touch(kv.first) += kv.second;
+    delta_.clear();
   }
 
   virtual third_party::SArray<char> SubGet(const third_party::SArray<Key>& typed_keys) override {
     third_party::SArray<Val> reply_vals(typed_keys.size());
     for (size_t i = 0; i < typed_keys.size(); i++)
-      reply_vals[i] = storage_[typed_keys[i]];
+      reply_vals[i] = Peek(typed_keys[i]);
     return third_party::SArray<char>(reply_vals);
   }
 
@@ -41,16 +73,78 @@ class MapStorage : public AbstractStorage {
     third_party::SArray<Val> reply_vals(typed_keys.size() * chunk_size_);
     for (int i = 0; i < typed_keys.size(); i++) 
       for (int j = 0; j < chunk_size_; j++)
-        reply_vals[i * chunk_size_ + j] = storage_[typed_keys[i] * chunk_size_ + j];
+        reply_vals[i * chunk_size_ + j] = Peek(typed_keys[i] * chunk_size_ + j);
     return third_party::SArray<char>(reply_vals);
   }
 
+  virtual void LoadRange(const third_party::Range& range, const third_party::SArray<char>& vals) override {
+    auto typed_vals = third_party::SArray<Val>(vals);
+    CHECK_EQ(typed_vals.size(), range.size());
+    // Keys with the initial value are left out to keep the map sparse
+    for (size_t i = 0; i < typed_vals.size(); i++) {
+      Key key = range.begin() + i;
+      if (typed_vals[i] != InitValue(key))
+        storage_[key] = typed_vals[i];
+    }
+  }
+
+  virtual void ExportRange(const third_party::Range& range, third_party::SArray<Key>* keys,
+                           third_party::SArray<char>* vals) override {
+    CHECK(delta_.empty());
+    auto begin = storage_.lower_bound(range.begin());
+    auto end = storage_.lower_bound(range.end());
+    size_t n = std::distance(begin, end);
+    third_party::SArray<Key> typed_keys(n);
+    third_party::SArray<Val> typed_vals(n);
+    size_t i = 0;
+    for (auto it = begin; it != end; ++it, ++i) {
+      typed_keys[i] = it->first;
+      typed_vals[i] = it->second;
+    }
+    *keys = typed_keys;
+    *vals = third_party::SArray<char>(typed_vals);
+  }
+
+  virtual void ResetRange(const third_party::Range& range) override {
+    CHECK(delta_.empty());
+    storage_.erase(storage_.begin(), storage_.lower_bound(range.begin()));
+    storage_.erase(storage_.lower_bound(range.end()), storage_.end());
+  }
+
+  virtual void ImportKeys(const third_party::SArray<Key>& keys, const third_party::SArray<char>& vals) override {
+    auto typed_vals = third_party::SArray<Val>(vals);
+    CHECK_EQ(keys.size(), typed_vals.size());
+    for (size_t i = 0; i < keys.size(); i++)
+      Touch(keys[i]) = typed_vals[i];
+  }
 
   virtual void FinishIter() override {}
 
+  // Number of keys materialized in the storage
+  size_t Size() const { return storage_.size(); }
+
  private:
+  Val InitValue(Key key) const { return initializer_ ? initializer_(key) : Val(); }
+
+  // Return the stored value of key, initialize it if the key is touched the first time
+  Val& Touch(Key key) {
+    auto it = storage_.lower_bound(key);
+    if (it == storage_.end() || it->first != key)
+      it = storage_.emplace_hint(it, key, InitValue(key));
+    return it->second;
+  }
+
+  // Return the value of key without storing it
+  Val Peek(Key key) const {
+    auto it = storage_.find(key);
+    return it == storage_.end() ? InitValue(key) : it->second;
+  }
+
   std::map<Key, Val> storage_;
+  // The Adds merged by BufferAdd(), each key is searched in storage_ once per flush
+  std::unordered_map<Key, Val> delta_;
   uint32_t chunk_size_;
+  Initializer<Val> initializer_;
 };
 
 }  // namespace flexps
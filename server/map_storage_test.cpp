@@ -89,6 +89,104 @@ TEST_F(TestMapStorage, SubAddChunkSubGetChunk) {
   }
 }
 
+TEST_F(TestMapStorage, InitializerGetNotMaterialized) {
+  MapStorage<float> s(1, ConstantInitializer<float>(0.5));
+
+  third_party::SArray<Key> s_keys({13, 14, 15});
+  third_party::SArray<float> ret = third_party::SArray<float>(s.SubGet(s_keys));
+  for (int i = 0; i < s_keys.size(); ++ i) {
+    EXPECT_EQ(ret[i], float(0.5));
+  }
+  EXPECT_EQ(s.Size(), 0);
+
+  third_party::SArray<Key> add_keys({14});
+  third_party::SArray<float> add_vals({0.25});
+  s.SubAdd(add_keys, third_party::SArray<char>(add_vals));
+  EXPECT_EQ(s.Size(), 1);
+  ret = third_party::SArray<float>(s.SubGet(s_keys));
+  EXPECT_EQ(ret[0], float(0.5));
+  EXPECT_EQ(ret[1], float(0.75));
+  EXPECT_EQ(ret[2], float(0.5));
+}
+
+TEST_F(TestMapStorage, InitializerChunk) {
+  auto initializer = UniformInitializer<float>(-1, 1, 7);
+  MapStorage<float> s(2, initializer);
+
+  third_party::SArray<Key> s_keys({3});
+  third_party::SArray<float> ret = third_party::SArray<float>(s.SubGetChunk(s_keys));
+  ASSERT_EQ(ret.size(), 2);
+  EXPECT_EQ(ret[0], initializer(6));
+  EXPECT_EQ(ret[1], initializer(7));
+  EXPECT_EQ(s.Size(), 0);
+}
+
+TEST_F(TestMapStorage, BufferAddAndFlush) {
+  MapStorage<int> s;
+
+  third_party::SArray<Key> s_keys({13, 14, 15});
+  s.SubBufferAdd(s_keys, third_party::SArray<char>(third_party::SArray<int>({1, 2, 3})));
+  s.SubBufferAdd(s_keys, third_party::SArray<char>(third_party::SArray<int>({10, 20, 30})));
+  EXPECT_EQ(s.Size(), 0);
+  third_party::SArray<int> ret = third_party::SArray<int>(s.SubGet(s_keys));
+  EXPECT_EQ(ret[0], 0);
+
+  s.FlushAdds();
+  EXPECT_EQ(s.Size(), 3);
+  ret = third_party::SArray<int>(s.SubGet(s_keys));
+  EXPECT_EQ(ret[0], 11);
+  EXPECT_EQ(ret[1], 22);
+  EXPECT_EQ(ret[2], 33);
+
+  // The delta is cleared after flush
+  s.FlushAdds();
+  ret = third_party::SArray<int>(s.SubGet(s_keys));
+  EXPECT_EQ(ret[2], 33);
+}
+
+TEST_F(TestMapStorage, BufferAddChunk) {
+  MapStorage<int> s(2);
+
+  Message m;
+  m.meta.flag = Flag::kAddChunk;
+  third_party::SArray<Key> s_keys({3});
+  m.AddData(s_keys);
+  m.AddData(third_party::SArray<int>({1, 2}));
+  s.BufferAdd(m);
+  s.BufferAdd(m);
+  s.FlushAdds();
+  third_party::SArray<int> ret = third_party::SArray<int>(s.SubGetChunk(s_keys));
+  ASSERT_EQ(ret.size(), 2);
+  EXPECT_EQ(ret[0], 2);
+  EXPECT_EQ(ret[1], 4);
+}
+
+TEST_F(TestMapStorage, Migrate) {
+  MapStorage<int> s1;
+  MapStorage<int> s2;
+  s1.SubAdd(third_party::SArray<Key>({3, 15, 18, 40}), third_party::SArray<char>(third_party::SArray<int>({1, 2, 3, 4})));
+  s2.SubAdd(third_party::SArray<Key>({16}), third_party::SArray<char>(third_party::SArray<int>({5})));
+
+  // Only the stored keys are exported
+  third_party::SArray<Key> keys;
+  third_party::SArray<char> vals;
+  s1.ExportRange({10, 20}, &keys, &vals);
+  ASSERT_EQ(keys.size(), 2);
+  EXPECT_EQ(keys[0], 15);
+  EXPECT_EQ(keys[1], 18);
+  s1.ResetRange({0, 10});
+  EXPECT_EQ(s1.Size(), 1);
+  s2.ImportKeys(keys, vals);
+  EXPECT_EQ(s2.Size(), 3);
+
+  third_party::SArray<int> ret = third_party::SArray<int>(s2.SubGet(third_party::SArray<Key>({15, 16, 18})));
+  EXPECT_EQ(ret[0], 2);
+  EXPECT_EQ(ret[1], 5);
+  EXPECT_EQ(ret[2], 3);
+  ret = third_party::SArray<int>(s1.SubGet(third_party::SArray<Key>({3, 40})));
+  EXPECT_EQ(ret[0], 1);
+  EXPECT_EQ(ret[1], 0);
+}
 
 }  // namespace
 }  // namespace flexps
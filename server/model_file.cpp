@@ -0,0 +1,48 @@
+#include "server/model_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "glog/logging.h"
+
+namespace flexps {
+
+MappedModelFile::MappedModelFile(const std::string& path) : path_(path) {
+  fd_ = open(path_.c_str(), O_RDONLY);
+  CHECK_GE(fd_, 0) << "Cannot open model file: " << path_;
+  CHECK_EQ(pread(fd_, &header_, sizeof(header_), 0), sizeof(header_)) << "Cannot read header of: " << path_;
+  CHECK_EQ(header_.magic, kModelFileMagic) << "Not a model file: " << path_;
+  struct stat st;
+  CHECK_EQ(fstat(fd_, &st), 0);
+  CHECK_GE(st.st_size, sizeof(header_) + header_.num_keys * header_.val_size) << "Truncated model file: " << path_;
+}
+
+MappedModelFile::~MappedModelFile() {
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+third_party::SArray<char> MappedModelFile::MapRange(const third_party::Range& range) const {
+  CHECK_LE(range.begin(), range.end());
+  CHECK_LE(range.end(), header_.num_keys) << "Range exceeds the keys in model file: " << path_;
+  third_party::SArray<char> vals;
+  if (range.size() == 0)
+    return vals;
+
+  // mmap requires the offset to be aligned to the page size
+  const uint64_t page_size = sysconf(_SC_PAGESIZE);
+  const uint64_t offset = sizeof(header_) + range.begin() * header_.val_size;
+  const uint64_t aligned_offset = offset / page_size * page_size;
+  const size_t length = offset - aligned_offset + range.size() * header_.val_size;
+  void* base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd_, aligned_offset);
+  CHECK(base != MAP_FAILED) << "Cannot mmap model file: " << path_;
+  madvise(base, length, MADV_WILLNEED);
+
+  char* data = static_cast<char*>(base) + (offset - aligned_offset);
+  vals.reset(data, range.size() * header_.val_size, [base, length](char*) { munmap(base, length); });
+  return vals;
+}
+
+}  // namespace flexps
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "base/third_party/range.h"
+#include "base/third_party/sarray.h"
+
+#include "glog/logging.h"
+
+#include <cinttypes>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace flexps {
+
+/*
+ * The binary model file used to warm start a table.
+ *
+ * Layout: a ModelFileHeader followed by the values of keys [0, num_keys) stored densely in key order.
+ * The values of any third_party::Range thus start at a fixed offset, so that each server thread can
+ * map only the range it is in charge of.
+ */
+struct ModelFileHeader {
+  uint64_t magic;
+  uint32_t val_size;
+  uint32_t reserved;
+  uint64_t num_keys;
+};
+
+const uint64_t kModelFileMagic = 0x3130444f4d535058;  // "XPSMOD01"
+
+/*
+ * Read-only view of a model file, the ranges are mapped with mmap on demand.
+ *
+ * Thread-safe, different server threads may map their ranges in parallel.
+ */
+class MappedModelFile {
+ public:
+  explicit MappedModelFile(const std::string& path);
+  ~MappedModelFile();
+  MappedModelFile(const MappedModelFile&) = delete;
+  MappedModelFile& operator=(const MappedModelFile&) = delete;
+
+  uint64_t GetNumKeys() const { return header_.num_keys; }
+  uint32_t GetValSize() const { return header_.val_size; }
+
+  /*
+   * Map the values of keys in [range.begin(), range.end()) without copying.
+   * The mapping is released when the returned array and all its copies are gone,
+   * and it may outlive this MappedModelFile.
+   */
+  third_party::SArray<char> MapRange(const third_party::Range& range) const;
+
+ private:
+  std::string path_;
+  int fd_ = -1;
+  ModelFileHeader header_;
+};
+
+/*
+ * Dump the values of keys [0, vals.size()) to path in the model file format.
+ */
+template <typename Val>
+void WriteModelFile(const std::string& path, const std::vector<Val>& vals) {
+  ModelFileHeader header;
+  header.magic = kModelFileMagic;
+  header.val_size = sizeof(Val);
+  header.reserved = 0;
+  header.num_keys = vals.size();
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  CHECK(out.is_open()) << "Cannot open model file: " << path;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(vals.data()), vals.size() * sizeof(Val));
+  CHECK(out.good()) << "Failed to write model file: " << path;
+}
+
+}  // namespace flexps
@@ -0,0 +1,100 @@
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "server/map_storage.hpp"
+#include "server/model_file.hpp"
+#include "server/vector_storage.hpp"
+
+#include <cstdio>
+#include <unistd.h>
+
+namespace flexps {
+namespace {
+
+class TestModelFile : public testing::Test {
+ public:
+  TestModelFile() {}
+  ~TestModelFile() {}
+
+ protected:
+  void SetUp() { path_ = "/tmp/flexps_model_file_test_" + std::to_string(getpid()); }
+  void TearDown() { std::remove(path_.c_str()); }
+
+  std::string path_;
+};
+
+TEST_F(TestModelFile, WriteAndMap) {
+  std::vector<float> vals(5000);
+  for (size_t i = 0; i < vals.size(); ++i)
+    vals[i] = i * 0.5;
+  WriteModelFile(path_, vals);
+
+  MappedModelFile file(path_);
+  EXPECT_EQ(file.GetNumKeys(), 5000);
+  EXPECT_EQ(file.GetValSize(), sizeof(float));
+  // Cross page boundary and not page aligned
+  third_party::SArray<float> mapped(file.MapRange({1021, 4099}));
+  ASSERT_EQ(mapped.size(), 4099 - 1021);
+  for (size_t i = 0; i < mapped.size(); ++i)
+    EXPECT_EQ(mapped[i], vals[1021 + i]);
+
+  third_party::SArray<char> empty = file.MapRange({10, 10});
+  EXPECT_EQ(empty.size(), 0);
+}
+
+TEST_F(TestModelFile, MappingOutlivesFile) {
+  WriteModelFile(path_, std::vector<int>({1, 2, 3, 4}));
+  third_party::SArray<int> mapped;
+  {
+    MappedModelFile file(path_);
+    mapped = file.MapRange({1, 3});
+  }
+  ASSERT_EQ(mapped.size(), 2);
+  EXPECT_EQ(mapped[0], 2);
+  EXPECT_EQ(mapped[1], 3);
+}
+
+TEST_F(TestModelFile, LoadVectorStorage) {
+  std::vector<int> vals(20);
+  for (size_t i = 0; i < vals.size(); ++i)
+    vals[i] = i + 1;
+  WriteModelFile(path_, vals);
+  MappedModelFile file(path_);
+
+  VectorStorage<int> s({10, 20});
+  s.LoadRange({10, 20}, file.MapRange({10, 20}));
+
+  Message m;
+  m.meta.flag = Flag::kGet;
+  third_party::SArray<Key> keys({10, 15, 19});
+  m.AddData(keys);
+  Message rep = s.Get(m);
+  auto rep_vals = third_party::SArray<int>(rep.data[1]);
+  ASSERT_EQ(rep_vals.size(), 3);
+  EXPECT_EQ(rep_vals[0], 11);
+  EXPECT_EQ(rep_vals[1], 16);
+  EXPECT_EQ(rep_vals[2], 20);
+}
+
+TEST_F(TestModelFile, LoadMapStorage) {
+  WriteModelFile(path_, std::vector<float>({0.0, 1.5, 0.0, 2.5}));
+  MappedModelFile file(path_);
+
+  MapStorage<float> s;
+  s.LoadRange({0, 4}, file.MapRange({0, 4}));
+
+  Message m;
+  m.meta.flag = Flag::kGet;
+  third_party::SArray<Key> keys({0, 1, 2, 3});
+  m.AddData(keys);
+  Message rep = s.Get(m);
+  auto rep_vals = third_party::SArray<float>(rep.data[1]);
+  ASSERT_EQ(rep_vals.size(), 4);
+  EXPECT_EQ(rep_vals[0], 0.0);
+  EXPECT_EQ(rep_vals[1], 1.5);
+  EXPECT_EQ(rep_vals[2], 0.0);
+  EXPECT_EQ(rep_vals[3], 2.5);
+}
+
+}  // namespace
+}  // namespace flexps
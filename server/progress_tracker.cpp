@@ -5,54 +5,49 @@
 namespace flexps {
 
 void ProgressTracker::Init(const std::vector<uint32_t>& tids) {
-  progresses_.clear();
+  slots_.clear();
+  slots_.reserve(tids.size());
   for (auto tid : tids) {
-    progresses_.insert({tid, 0});
+    slots_.insert({tid, slots_.size()});
   }
+  progresses_.assign(slots_.size(), 0);
+  num_at_clock_.assign(1, slots_.size());
   min_clock_ = 0;
 }
 
 int ProgressTracker::AdvanceAndGetChangedMinClock(int tid) {
-  CHECK(CheckThreadValid(tid));
-  if (IsUniqueMin(tid)) {
+  int slot = GetSlot(tid);
+  int offset = progresses_[slot] - min_clock_;
+  progresses_[slot] += 1;
+  num_at_clock_[offset] -= 1;
+  if (offset + 1 == num_at_clock_.size()) {
+    num_at_clock_.push_back(0);
+  }
+  num_at_clock_[offset + 1] += 1;
+  if (offset == 0 && num_at_clock_.front() == 0) {  // tid was the unique min
+    num_at_clock_.pop_front();
     min_clock_ += 1;
-    progresses_[tid] += 1;
     return min_clock_;
-  } else {
-    progresses_[tid] += 1;
-    return -1;
   }
+  return -1;
 }
 
 int ProgressTracker::GetNumThreads() const { return progresses_.size(); }
 
-int ProgressTracker::GetProgress(int tid) const {
-  CHECK(CheckThreadValid(tid));
-  auto it = progresses_.find(tid);
-  return it->second;
-}
+int ProgressTracker::GetProgress(int tid) const { return progresses_[GetSlot(tid)]; }
 
 int ProgressTracker::GetMinClock() const { return min_clock_; }
 
 bool ProgressTracker::IsUniqueMin(int tid) const {
-  CHECK(CheckThreadValid(tid));
-  auto it = progresses_.find(tid);
-  if (it->second != min_clock_) {
-    return false;
-  }
-  int min_count = 0;
-  for (auto it : progresses_) {
-    if (it.second == min_clock_)
-      min_count += 1;
-    if (min_count > 1)
-      return false;
-  }
-  return true;
+  return progresses_[GetSlot(tid)] == min_clock_ && num_at_clock_.front() == 1;
 }
 
-bool ProgressTracker::CheckThreadValid(int tid) const {
-  auto it = progresses_.find(tid);
-  return it != progresses_.end();
+bool ProgressTracker::CheckThreadValid(int tid) const { return slots_.find(tid) != slots_.end(); }
+
+int ProgressTracker::GetSlot(int tid) const {
+  auto it = slots_.find(tid);
+  CHECK(it != slots_.end()) << "Unknown tid: " << tid;
+  return it->second;
 }
 
 }  // namespace flexps
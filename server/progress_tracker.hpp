@@ -1,10 +1,18 @@
 #pragma once
 
-#include <map>
+#include <deque>
+#include <unordered_map>
 #include <vector>
 
 namespace flexps {
 
+/*
+ * Track the progress (clock) of each worker thread.
+ *
+ * Each worker occupies a slot in a dense array, assigned in Init() (i.e. in ResetWorker).
+ * The number of workers at each clock from min_clock_ on is kept in a ring, so that advancing
+ * a worker and detecting the change of min_clock_ are O(1) amortized.
+ */
 class ProgressTracker {
  public:
   void Init(const std::vector<uint32_t>& tids);
@@ -21,7 +29,13 @@ class ProgressTracker {
   bool CheckThreadValid(int tid) const;
 
  private:
-  std::map<int, int> progresses_;
+  int GetSlot(int tid) const;
+
+  // tid -> slot in progresses_
+  std::unordered_map<int, int> slots_;
+  std::vector<int> progresses_;
+  // num_at_clock_[i] is the number of workers whose progress is min_clock_ + i
+  std::deque<int> num_at_clock_;
   int min_clock_;
 };
 
@@ -46,5 +46,45 @@ TEST_F(TestProgressTracker, Advance) {
   EXPECT_EQ(tracker.GetProgress(7), 3);
 }
 
+TEST_F(TestProgressTracker, IsUniqueMin) {
+  ProgressTracker tracker;
+  tracker.Init({2, 7});
+  EXPECT_FALSE(tracker.IsUniqueMin(2));
+  tracker.AdvanceAndGetChangedMinClock(2);  // [1,0]
+  EXPECT_FALSE(tracker.IsUniqueMin(2));
+  EXPECT_TRUE(tracker.IsUniqueMin(7));
+}
+
+TEST_F(TestProgressTracker, FarAhead) {
+  ProgressTracker tracker;
+  tracker.Init({2, 7, 9});
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(tracker.AdvanceAndGetChangedMinClock(7), -1);
+  }
+  EXPECT_EQ(tracker.AdvanceAndGetChangedMinClock(9), -1);
+  EXPECT_EQ(tracker.AdvanceAndGetChangedMinClock(2), 1);  // [1,100,1]
+  EXPECT_EQ(tracker.AdvanceAndGetChangedMinClock(2), -1);  // [2,100,1]
+  EXPECT_EQ(tracker.AdvanceAndGetChangedMinClock(9), 2);  // [2,100,2]
+  EXPECT_EQ(tracker.GetProgress(7), 100);
+  EXPECT_EQ(tracker.GetMinClock(), 2);
+}
+
+TEST_F(TestProgressTracker, ManyThreads) {
+  ProgressTracker tracker;
+  std::vector<uint32_t> tids;
+  for (uint32_t i = 0; i < 2000; ++i) {
+    tids.push_back(i * 3 + 100);
+  }
+  tracker.Init(tids);
+  EXPECT_EQ(tracker.GetNumThreads(), 2000);
+  for (int iter = 0; iter < 5; ++iter) {
+    for (int i = 0; i < tids.size(); ++i) {
+      int updated = tracker.AdvanceAndGetChangedMinClock(tids[i]);
+      EXPECT_EQ(updated, i + 1 == tids.size() ? iter + 1 : -1);
+    }
+  }
+  EXPECT_EQ(tracker.GetMinClock(), 5);
+}
+
 }  // namespace
 }  // namespace flexps
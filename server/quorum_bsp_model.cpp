@@ -0,0 +1,188 @@
+#include "server/quorum_bsp_model.hpp"
+#include "server/snapshot_reader.hpp"
+#include "glog/logging.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace flexps {
+
+QuorumBSPModel::QuorumBSPModel(uint32_t model_id, std::unique_ptr<AbstractStorage>&& storage_ptr,
+                               ThreadsafeQueue<Message>* reply_queue, const QuorumBSPOptions& options,
+                               ThreadPool* reader_pool)
+    : model_id_(model_id), options_(options), reply_queue_(reply_queue), reader_pool_(reader_pool) {
+  CHECK_GT(options_.quorum_ratio, 0.);
+  CHECK_LE(options_.quorum_ratio, 1.);
+  this->storage_ = std::move(storage_ptr);
+}
+
+void QuorumBSPModel::SetServers(uint32_t server_id, const std::vector<uint32_t>& server_ids) {
+  CHECK(std::find(server_ids.begin(), server_ids.end(), server_id) != server_ids.end());
+  server_id_ = server_id;
+  is_coordinator_ = server_id == *std::min_element(server_ids.begin(), server_ids.end());
+  other_server_ids_.clear();
+  if (is_coordinator_) {
+    for (auto id : server_ids) {
+      if (id != server_id)
+        other_server_ids_.push_back(id);
+    }
+  }
+}
+
+void QuorumBSPModel::Clock(Message& msg) {
+  progress_tracker_.AdvanceAndGetChangedMinClock(msg.meta.sender);
+  if (is_coordinator_)
+    DecideQuorums();
+  TryCloseIterations();
+}
+
+void QuorumBSPModel::DecideQuorums() {
+  while (true) {
+    // A straggler clocking a clock already decided does not count
+    std::vector<uint32_t> members;
+    for (auto tid : tids_) {
+      if (progress_tracker_.GetProgress(tid) > decide_clock_)
+        members.push_back(tid);
+    }
+    if (static_cast<int>(members.size()) < quorum_size_)
+      return;
+    std::sort(members.begin(), members.end());
+    for (auto server_id : other_server_ids_) {
+      Message msg;
+      msg.meta.sender = server_id_;
+      msg.meta.recver = server_id;
+      msg.meta.model_id = model_id_;
+      msg.meta.flag = Flag::kQuorumClose;
+      msg.meta.version = decide_clock_;
+      msg.AddData(third_party::SArray<uint32_t>(members));
+      reply_queue_->Push(std::move(msg));
+    }
+    quorums_[decide_clock_] = std::move(members);
+    decide_clock_ += 1;
+  }
+}
+
+void QuorumBSPModel::QuorumClose(Message& msg) {
+  CHECK(!is_coordinator_);
+  CHECK_EQ(msg.data.size(), 1);
+  third_party::SArray<uint32_t> members(msg.data[0]);
+  quorums_[msg.meta.version].assign(members.begin(), members.end());
+  TryCloseIterations();
+}
+
+void QuorumBSPModel::TryCloseIterations() {
+  while (!quorums_.empty() && quorums_.begin()->first == quorum_clock_) {
+    const auto& members = quorums_.begin()->second;
+    // The Adds of a member at the clock arrive before its Clock
+    for (auto tid : members) {
+      if (progress_tracker_.GetProgress(tid) <= quorum_clock_)
+        return;
+    }
+    CloseIteration(members);
+    quorums_.erase(quorums_.begin());
+  }
+}
+
+void QuorumBSPModel::CloseIteration(const std::vector<uint32_t>& members) {
+  QuorumIterStats stats;
+  stats.clock = quorum_clock_;
+  stats.num_late_adds = 0;
+  for (auto tid : tids_) {
+    if (!std::binary_search(members.begin(), members.end(), tid))
+      stats.stragglers.push_back(tid);
+  }
+  std::vector<Message> late_adds;
+  auto adds_it = pending_adds_.find(quorum_clock_);
+  if (adds_it != pending_adds_.end()) {
+    for (auto& kv : adds_it->second) {
+      bool is_member = std::binary_search(members.begin(), members.end(), kv.first);
+      for (auto& add : kv.second) {
+        if (is_member) {
+          storage_->BufferAdd(add);
+        } else {
+          stats.num_late_adds += 1;
+          late_adds.push_back(std::move(add));
+        }
+      }
+    }
+    pending_adds_.erase(adds_it);
+  }
+  if (!stats.stragglers.empty()) {
+    VLOG(1) << "model " << model_id_ << " closes clock " << quorum_clock_ << " without " << stats.stragglers.size()
+            << " stragglers";
+  }
+  iter_stats_.push_back(std::move(stats));
+  if (iter_stats_.size() > kMaxIterStats)
+    iter_stats_.pop_front();
+
+  storage_->FlushAdds();
+  quorum_clock_ += 1;
+  std::vector<Message> waiting_gets;
+  for (auto& get_req : get_buffer_) {
+    if (progress_tracker_.GetProgress(get_req.meta.sender) <= quorum_clock_)
+      reply_queue_->Push(storage_->Get(get_req));
+    else
+      waiting_gets.push_back(std::move(get_req));
+  }
+  get_buffer_.swap(waiting_gets);
+  storage_->FinishIter();
+  if (options_.late_add_policy == LateAddPolicy::kFold) {
+    for (auto& add : late_adds)
+      storage_->BufferAdd(add);
+  }
+}
+
+void QuorumBSPModel::CountLateAdd(int clock) {
+  for (auto it = iter_stats_.rbegin(); it != iter_stats_.rend(); ++it) {
+    if (it->clock == clock) {
+      it->num_late_adds += 1;
+      return;
+    }
+  }
+}
+
+void QuorumBSPModel::Add(Message& msg) {
+  CHECK(progress_tracker_.CheckThreadValid(msg.meta.sender));
+  int progress = progress_tracker_.GetProgress(msg.meta.sender);
+  if (progress < quorum_clock_) {
+    // The clock of the Add is closed here without the worker, so on all the shards
+    CountLateAdd(progress);
+    if (options_.late_add_policy == LateAddPolicy::kFold)
+      storage_->BufferAdd(msg);
+    return;
+  }
+  pending_adds_[progress][msg.meta.sender].push_back(msg);
+}
+
+void QuorumBSPModel::Get(Message& msg) {
+  CHECK(progress_tracker_.CheckThreadValid(msg.meta.sender));
+  int progress = progress_tracker_.GetProgress(msg.meta.sender);
+  if (progress > quorum_clock_) {
+    get_buffer_.push_back(msg);
+  } else {
+    // The Adds of the open iteration are not visible until it is closed
+    ReplyGet(storage_.get(), msg, reply_queue_, reader_pool_, false);
+  }
+}
+
+int QuorumBSPModel::GetProgress(int tid) { return progress_tracker_.GetProgress(tid); }
+
+void QuorumBSPModel::ResetWorker(Message& msg) {
+  CHECK_EQ(msg.data.size(), 1);
+  third_party::SArray<uint32_t> tids;
+  tids = msg.data[0];
+  tids_.assign(tids.begin(), tids.end());
+  this->progress_tracker_.Init(tids_);
+  quorum_clock_ = progress_tracker_.GetMinClock();
+  quorum_size_ = std::max(1, static_cast<int>(std::ceil(options_.quorum_ratio * tids_.size() - 1e-9)));
+  decide_clock_ = quorum_clock_;
+  quorums_.clear();
+  pending_adds_.clear();
+  Message reply_msg;
+  reply_msg.meta.model_id = model_id_;
+  reply_msg.meta.recver = msg.meta.sender;
+  reply_msg.meta.flag = Flag::kResetWorkerInModel;
+  reply_queue_->Push(reply_msg);
+}
+
+}  // namespace flexps
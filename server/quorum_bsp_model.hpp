@@ -0,0 +1,113 @@
+#pragma once
+
+#include "server/abstract_model.hpp"
+
+#include "base/message.hpp"
+#include "base/thread_pool.hpp"
+#include "base/threadsafe_queue.hpp"
+#include "server/abstract_storage.hpp"
+#include "server/progress_tracker.hpp"
+
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace flexps {
+
+// What to do with an Add of an iteration that is already closed by the quorum
+enum class LateAddPolicy { kDrop, kFold };
+
+struct QuorumBSPOptions {
+  // The fraction of workers that must clock to close an iteration, at least one worker
+  double quorum_ratio = 1.0;
+  // kDrop discards the late Adds, kFold applies them with the Adds of the open iteration
+  LateAddPolicy late_add_policy = LateAddPolicy::kDrop;
+};
+
+// The workers left behind by the quorum when an iteration was closed
+struct QuorumIterStats {
+  int clock;
+  std::vector<uint32_t> stragglers;
+  // The Adds of the stragglers at this clock received so far, dropped or folded
+  int num_late_adds;
+};
+
+/*
+ * BSP whose iteration is closed once ceil(quorum_ratio * num_workers) workers have clocked it,
+ * instead of all of them, so that a straggler does not stall the others.
+ *
+ * A straggler keeps running behind the quorum clock: its Gets are replied at once with the latest
+ * values, and its Adds are late, they are dropped or folded into the open iteration. Dropping the
+ * late Adds with quorum_ratio N / (N + b) is the backup worker mode: N + b workers run and each
+ * iteration takes the first N.
+ *
+ * The shards of a table see the Clocks in different orders, so one of them, the coordinator, decides
+ * the quorum of each clock by the order it sees and sends it to the others (kQuorumClose), see SetServers.
+ * A shard buffers the Adds of a clock per worker until its quorum is known, and closes the clock once
+ * the Clocks of all the members have arrived, i.e. after their Adds. Every shard thus applies the Adds
+ * of the same workers and reports the same stragglers.
+ *
+ * The stats of the last kMaxIterStats iterations are kept.
+ */
+class QuorumBSPModel : public AbstractModel {
+ public:
+  explicit QuorumBSPModel(uint32_t model_id, std::unique_ptr<AbstractStorage>&& storage_ptr,
+                          ThreadsafeQueue<Message>* reply_queue, const QuorumBSPOptions& options,
+                          ThreadPool* reader_pool = nullptr);
+
+  virtual void Clock(Message& msg) override;
+  virtual void Add(Message& msg) override;
+  virtual void Get(Message& msg) override;
+  virtual int GetProgress(int tid) override;
+  virtual void ResetWorker(Message& msg) override;
+  virtual void QuorumClose(Message& msg) override;
+  virtual AbstractStorage* GetStorage() override { return storage_.get(); }
+
+  /*
+   * server_ids are the server threads of the table, the one with the smallest id is the coordinator.
+   * Without it the model decides the quorums alone, which is only right for a single shard.
+   */
+  void SetServers(uint32_t server_id, const std::vector<uint32_t>& server_ids);
+
+  int GetQuorumClock() const { return quorum_clock_; }
+  int GetQuorumSize() const { return quorum_size_; }
+  int GetGetPendingSize() const { return get_buffer_.size(); }
+  const std::deque<QuorumIterStats>& GetIterStats() const { return iter_stats_; }
+
+  static const size_t kMaxIterStats = 64;
+
+ private:
+  // Decide the quorums of the clocks that have enough Clocks, on the coordinator
+  void DecideQuorums();
+  // Close the iterations whose quorum is known and whose members have all clocked here
+  void TryCloseIterations();
+  void CloseIteration(const std::vector<uint32_t>& members);
+  void CountLateAdd(int clock);
+
+  uint32_t model_id_;
+  QuorumBSPOptions options_;
+  uint32_t server_id_ = 0;
+  bool is_coordinator_ = true;
+  // The server threads to send the quorums to, if the coordinator
+  std::vector<uint32_t> other_server_ids_;
+
+  ThreadsafeQueue<Message>* reply_queue_;
+  // Serves the Gets from the storage snapshot if set and the storage supports it. Not owned.
+  ThreadPool* reader_pool_;
+  std::unique_ptr<AbstractStorage> storage_;
+  ProgressTracker progress_tracker_;
+  std::vector<uint32_t> tids_;
+  // The open iteration, the Gets after it wait
+  int quorum_clock_ = 0;
+  int quorum_size_ = 0;
+  // The next clock to decide the quorum of, on the coordinator
+  int decide_clock_ = 0;
+  // clock -> the sorted members of its quorum, for the clocks decided but not closed here
+  std::map<int, std::vector<uint32_t>> quorums_;
+  // clock -> worker -> its Adds at the clock, for the clocks not closed here
+  std::map<int, std::map<uint32_t, std::vector<Message>>> pending_adds_;
+  std::vector<Message> get_buffer_;
+  std::deque<QuorumIterStats> iter_stats_;
+};
+
+}  // namespace flexps
@@ -0,0 +1,198 @@
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "base/threadsafe_queue.hpp"
+#include "server/map_storage.hpp"
+#include "server/quorum_bsp_model.hpp"
+
+namespace flexps {
+namespace {
+
+class TestQuorumBSPModel : public testing::Test {
+ public:
+  TestQuorumBSPModel() {}
+  ~TestQuorumBSPModel() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+Message MakeMessage(Flag flag, int sender) {
+  Message msg;
+  msg.meta.flag = flag;
+  msg.meta.model_id = 0;
+  msg.meta.sender = sender;
+  msg.meta.recver = 0;
+  if (flag == Flag::kAdd || flag == Flag::kGet)
+    msg.AddData(third_party::SArray<Key>({1}));
+  if (flag == Flag::kAdd)
+    msg.AddData(third_party::SArray<int>({1}));
+  return msg;
+}
+
+std::unique_ptr<QuorumBSPModel> MakeModel(ThreadsafeQueue<Message>* reply_queue, const QuorumBSPOptions& options) {
+  std::unique_ptr<AbstractStorage> storage(new MapStorage<int>());
+  std::unique_ptr<QuorumBSPModel> model(new QuorumBSPModel(0, std::move(storage), reply_queue, options));
+  Message reset_msg;
+  reset_msg.AddData(third_party::SArray<uint32_t>({0, 1, 2, 3}));
+  model->ResetWorker(reset_msg);
+  Message reset_reply_msg;
+  reply_queue->WaitAndPop(&reset_reply_msg);
+  EXPECT_EQ(reset_reply_msg.meta.flag, Flag::kResetWorkerInModel);
+  return model;
+}
+
+int PopVal(ThreadsafeQueue<Message>* reply_queue) {
+  Message reply;
+  reply_queue->WaitAndPop(&reply);
+  auto vals = third_party::SArray<int>(reply.data[1]);
+  CHECK_EQ(vals.size(), 1);
+  return vals[0];
+}
+
+TEST_F(TestQuorumBSPModel, Quorum) {
+  ThreadsafeQueue<Message> reply_queue;
+  QuorumBSPOptions options;
+  options.quorum_ratio = 0.75;
+  auto model = MakeModel(&reply_queue, options);
+  EXPECT_EQ(model->GetQuorumSize(), 3);
+
+  Message msg;
+  for (int tid = 0; tid < 3; ++tid) {
+    msg = MakeMessage(Flag::kAdd, tid);
+    model->Add(msg);
+  }
+  msg = MakeMessage(Flag::kClock, 0);
+  model->Clock(msg);
+  // Worker 0 waits for the quorum
+  msg = MakeMessage(Flag::kGet, 0);
+  model->Get(msg);
+  EXPECT_EQ(model->GetGetPendingSize(), 1);
+  EXPECT_EQ(reply_queue.Size(), 0);
+
+  for (int tid = 1; tid < 3; ++tid) {
+    msg = MakeMessage(Flag::kClock, tid);
+    model->Clock(msg);
+  }
+  // Worker 3 is left behind
+  EXPECT_EQ(model->GetQuorumClock(), 1);
+  EXPECT_EQ(model->GetGetPendingSize(), 0);
+  EXPECT_EQ(PopVal(&reply_queue), 3);
+  ASSERT_EQ(model->GetIterStats().size(), 1);
+  EXPECT_EQ(model->GetIterStats()[0].clock, 0);
+  EXPECT_EQ(model->GetIterStats()[0].stragglers, std::vector<uint32_t>({3}));
+
+  // The straggler reads the latest values, its Add is late and dropped
+  msg = MakeMessage(Flag::kGet, 3);
+  model->Get(msg);
+  EXPECT_EQ(PopVal(&reply_queue), 3);
+  msg = MakeMessage(Flag::kAdd, 3);
+  model->Add(msg);
+  msg = MakeMessage(Flag::kClock, 3);
+  model->Clock(msg);
+  EXPECT_EQ(model->GetProgress(3), 1);
+
+  for (int tid = 0; tid < 3; ++tid) {
+    msg = MakeMessage(Flag::kClock, tid);
+    model->Clock(msg);
+  }
+  EXPECT_EQ(model->GetQuorumClock(), 2);
+  ASSERT_EQ(model->GetIterStats().size(), 2);
+  EXPECT_EQ(model->GetIterStats()[0].num_late_adds, 1);
+  EXPECT_EQ(model->GetIterStats()[1].num_late_adds, 0);
+  EXPECT_EQ(model->GetIterStats()[1].stragglers, std::vector<uint32_t>({3}));
+  msg = MakeMessage(Flag::kGet, 0);
+  model->Get(msg);
+  EXPECT_EQ(PopVal(&reply_queue), 3);
+}
+
+TEST_F(TestQuorumBSPModel, FoldLateAdds) {
+  ThreadsafeQueue<Message> reply_queue;
+  QuorumBSPOptions options;
+  options.quorum_ratio = 0.5;
+  options.late_add_policy = LateAddPolicy::kFold;
+  auto model = MakeModel(&reply_queue, options);
+  EXPECT_EQ(model->GetQuorumSize(), 2);
+
+  Message msg;
+  for (int tid = 0; tid < 2; ++tid) {
+    msg = MakeMessage(Flag::kClock, tid);
+    model->Clock(msg);
+  }
+  EXPECT_EQ(model->GetQuorumClock(), 1);
+  EXPECT_EQ(model->GetIterStats()[0].stragglers, std::vector<uint32_t>({2, 3}));
+
+  // The late Add of worker 2 is applied with the Adds of clock 1
+  msg = MakeMessage(Flag::kAdd, 2);
+  model->Add(msg);
+  msg = MakeMessage(Flag::kAdd, 0);
+  model->Add(msg);
+  for (int tid = 0; tid < 2; ++tid) {
+    msg = MakeMessage(Flag::kClock, tid);
+    model->Clock(msg);
+  }
+  EXPECT_EQ(model->GetQuorumClock(), 2);
+  msg = MakeMessage(Flag::kGet, 0);
+  model->Get(msg);
+  EXPECT_EQ(PopVal(&reply_queue), 2);
+}
+
+TEST_F(TestQuorumBSPModel, TwoShards) {
+  ThreadsafeQueue<Message> queue0, queue1;
+  QuorumBSPOptions options;
+  options.quorum_ratio = 0.75;
+  auto model0 = MakeModel(&queue0, options);
+  auto model1 = MakeModel(&queue1, options);
+  model0->SetServers(0, {0, 1});
+  model1->SetServers(1, {0, 1});
+
+  Message msg;
+  for (int tid = 0; tid < 4; ++tid) {
+    msg = MakeMessage(Flag::kAdd, tid);
+    model0->Add(msg);
+    msg = MakeMessage(Flag::kAdd, tid);
+    model1->Add(msg);
+  }
+  // Shard 0 sees the Clocks of 0, 1, 2 first, shard 1 those of 0, 1, 3
+  for (int tid : {0, 1, 2}) {
+    msg = MakeMessage(Flag::kClock, tid);
+    model0->Clock(msg);
+  }
+  for (int tid : {0, 1, 3}) {
+    msg = MakeMessage(Flag::kClock, tid);
+    model1->Clock(msg);
+  }
+  EXPECT_EQ(model0->GetQuorumClock(), 1);
+  // Shard 1 waits for the quorum of the coordinator
+  EXPECT_EQ(model1->GetQuorumClock(), 0);
+  Message quorum_msg;
+  queue0.WaitAndPop(&quorum_msg);
+  EXPECT_EQ(quorum_msg.meta.flag, Flag::kQuorumClose);
+  EXPECT_EQ(quorum_msg.meta.recver, 1);
+  model1->QuorumClose(quorum_msg);
+  // and for the Clock of worker 2, which is in the quorum
+  EXPECT_EQ(model1->GetQuorumClock(), 0);
+  msg = MakeMessage(Flag::kClock, 2);
+  model1->Clock(msg);
+  EXPECT_EQ(model1->GetQuorumClock(), 1);
+  msg = MakeMessage(Flag::kClock, 3);
+  model0->Clock(msg);
+
+  // Both shards drop the Add of worker 3
+  for (auto* model : {model0.get(), model1.get()}) {
+    ASSERT_EQ(model->GetIterStats().size(), 1);
+    EXPECT_EQ(model->GetIterStats()[0].stragglers, std::vector<uint32_t>({3}));
+    EXPECT_EQ(model->GetIterStats()[0].num_late_adds, 1);
+  }
+  msg = MakeMessage(Flag::kGet, 0);
+  model0->Get(msg);
+  EXPECT_EQ(PopVal(&queue0), 3);
+  msg = MakeMessage(Flag::kGet, 0);
+  model1->Get(msg);
+  EXPECT_EQ(PopVal(&queue1), 3);
+  EXPECT_EQ(queue0.Size(), 0);
+}
+
+}  // namespace
+}  // namespace flexps
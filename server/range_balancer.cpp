@@ -0,0 +1,104 @@
+#include "server/range_balancer.hpp"
+
+#include "glog/logging.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace flexps {
+
+LoadSampler::LoadSampler(size_t capacity) : capacity_(capacity) {
+  CHECK_GT(capacity_, 0);
+  samples_.reserve(capacity_);
+}
+
+void LoadSampler::Count(const third_party::SArray<Key>& keys) {
+  for (auto key : keys) {
+    if (num_counted_ < capacity_) {
+      samples_.push_back(key);
+      if (num_counted_ + 1 == capacity_)
+        Skip();
+    } else if (num_counted_ == next_sample_) {
+      samples_[rng_() % capacity_] = key;
+      Skip();
+    }
+    ++num_counted_;
+  }
+}
+
+void LoadSampler::Clear() {
+  num_counted_ = 0;
+  next_sample_ = 0;
+  w_ = 1.;
+  samples_.clear();
+}
+
+// Algorithm L: the gap to the next sampled key is geometric given the current threshold w_
+void LoadSampler::Skip() {
+  std::uniform_real_distribution<double> unit(0., 1.);
+  // 1 - unit(rng_) is in (0, 1], so the logarithms are finite
+  w_ *= std::exp(std::log(1. - unit(rng_)) / capacity_);
+  double gap = std::floor(std::log(1. - unit(rng_)) / std::log1p(-w_));
+  next_sample_ = std::max(next_sample_, num_counted_) + 1 + static_cast<uint64_t>(std::min(gap, 1e18));
+}
+
+std::vector<third_party::Range> BalanceRanges(const std::vector<third_party::Range>& ranges,
+                                              const std::vector<std::vector<Key>>& samples,
+                                              const std::vector<uint64_t>& loads) {
+  CHECK(!ranges.empty());
+  CHECK_EQ(samples.size(), ranges.size());
+  CHECK_EQ(loads.size(), ranges.size());
+  std::vector<std::pair<Key, double>> points;
+  double total = 0.;
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    if (samples[i].empty() || loads[i] == 0)
+      continue;
+    double weight = static_cast<double>(loads[i]) / samples[i].size();
+    for (auto key : samples[i])
+      points.push_back({key, weight});
+    total += loads[i];
+  }
+  if (points.empty())
+    return ranges;
+  std::sort(points.begin(), points.end());
+
+  const uint64_t begin = ranges.front().begin();
+  const uint64_t end = ranges.back().end();
+  const size_t n = ranges.size();
+  std::vector<uint64_t> bounds(n + 1, end);
+  bounds[0] = begin;
+  double acc = 0.;
+  size_t k = 1;
+  for (size_t i = 0; i < points.size() && k < n; ++i) {
+    acc += points[i].second;
+    // The boundary goes after the key so that the key stays with the load before it
+    while (k < n && acc >= total * k / n) {
+      bounds[k] = std::min(std::max(static_cast<uint64_t>(points[i].first) + 1, bounds[k - 1]), end);
+      ++k;
+    }
+  }
+  std::vector<third_party::Range> new_ranges;
+  new_ranges.reserve(n);
+  for (size_t i = 0; i < n; ++i)
+    new_ranges.emplace_back(bounds[i], bounds[i + 1]);
+  return new_ranges;
+}
+
+third_party::SArray<Key> EncodeRanges(const std::vector<third_party::Range>& ranges) {
+  third_party::SArray<Key> encoded(ranges.size() * 2);
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    encoded[i * 2] = ranges[i].begin();
+    encoded[i * 2 + 1] = ranges[i].end();
+  }
+  return encoded;
+}
+
+std::vector<third_party::Range> DecodeRanges(const third_party::SArray<Key>& encoded) {
+  CHECK_EQ(encoded.size() % 2, 0);
+  std::vector<third_party::Range> ranges;
+  for (size_t i = 0; i < encoded.size(); i += 2)
+    ranges.emplace_back(encoded[i], encoded[i + 1]);
+  return ranges;
+}
+
+}  // namespace flexps
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "base/magic.hpp"
+#include "base/third_party/range.h"
+#include "base/third_party/sarray.h"
+
+#include <random>
+#include <vector>
+
+namespace flexps {
+
+/*
+ * Sample the keys accessed on a server thread to estimate the load distribution over its range.
+ *
+ * Keeps a uniform sample of at most capacity accessed keys (reservoir sampling with geometric skips),
+ * so that counting a key is only a comparison unless the key is sampled.
+ */
+class LoadSampler {
+ public:
+  explicit LoadSampler(size_t capacity = 1024);
+
+  void Count(const third_party::SArray<Key>& keys);
+
+  // The number of keys counted since the last Clear()
+  uint64_t GetLoad() const { return num_counted_; }
+  const std::vector<Key>& GetSamples() const { return samples_; }
+  void Clear();
+
+ private:
+  // Draw the position of the next key to sample
+  void Skip();
+
+  size_t capacity_;
+  uint64_t num_counted_ = 0;
+  uint64_t next_sample_ = 0;
+  double w_ = 1.;
+  std::vector<Key> samples_;
+  std::mt19937_64 rng_;
+};
+
+/*
+ * Compute the new ranges of the server threads so that the load is balanced.
+ *
+ * samples[i] and loads[i] are the load samples of the server thread in charge of ranges[i]. Each sample
+ * of server thread i weighs loads[i] / samples[i].size(), and the boundaries are placed at the weighted
+ * quantiles of all samples. The new ranges are contiguous and cover
+ * [ranges.front().begin(), ranges.back().end()). Returns ranges if there is no load.
+ *
+ * The result only depends on the arguments, so every server thread computes the same ranges.
+ */
+std::vector<third_party::Range> BalanceRanges(const std::vector<third_party::Range>& ranges,
+                                              const std::vector<std::vector<Key>>& samples,
+                                              const std::vector<uint64_t>& loads);
+
+// The ranges in the messages of repartitioning: [begin_0, end_0, begin_1, end_1, ...]
+third_party::SArray<Key> EncodeRanges(const std::vector<third_party::Range>& ranges);
+std::vector<third_party::Range> DecodeRanges(const third_party::SArray<Key>& encoded);
+
+}  // namespace flexps
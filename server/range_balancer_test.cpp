@@ -0,0 +1,78 @@
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "server/range_balancer.hpp"
+
+namespace flexps {
+namespace {
+
+class TestRangeBalancer : public testing::Test {
+ public:
+  TestRangeBalancer() {}
+  ~TestRangeBalancer() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+TEST_F(TestRangeBalancer, LoadSampler) {
+  LoadSampler sampler(100);
+  sampler.Count(third_party::SArray<Key>({1, 2, 3}));
+  EXPECT_EQ(sampler.GetLoad(), 3);
+  EXPECT_EQ(sampler.GetSamples().size(), 3);
+
+  // Keys [0, 1000) are accessed 9 times as often as [1000, 2000)
+  third_party::SArray<Key> keys;
+  for (int round = 0; round < 100; ++round) {
+    keys.clear();
+    for (Key key = 0; key < 1000; key += 10)
+      for (int i = 0; i < 9; ++i)
+        keys.push_back(key);
+    for (Key key = 1000; key < 2000; key += 10)
+      keys.push_back(key);
+    sampler.Count(keys);
+  }
+  EXPECT_EQ(sampler.GetLoad(), 3 + 100 * 1000);
+  ASSERT_EQ(sampler.GetSamples().size(), 100);
+  int num_hot = 0;
+  for (auto key : sampler.GetSamples())
+    num_hot += key < 1000;
+  EXPECT_GT(num_hot, 75);
+
+  sampler.Clear();
+  EXPECT_EQ(sampler.GetLoad(), 0);
+  EXPECT_TRUE(sampler.GetSamples().empty());
+}
+
+TEST_F(TestRangeBalancer, BalanceRanges) {
+  std::vector<third_party::Range> ranges{{0, 50}, {50, 100}};
+  // All the load is on [0, 20)
+  std::vector<std::vector<Key>> samples(2);
+  for (Key key = 0; key < 20; ++key)
+    samples[0].push_back(key);
+  std::vector<uint64_t> loads{200, 0};
+  auto new_ranges = BalanceRanges(ranges, samples, loads);
+  ASSERT_EQ(new_ranges.size(), 2);
+  EXPECT_EQ(new_ranges[0].begin(), 0);
+  EXPECT_EQ(new_ranges[0].end(), 10);
+  EXPECT_EQ(new_ranges[1].begin(), 10);
+  EXPECT_EQ(new_ranges[1].end(), 100);
+
+  // The samples are weighted by the load of their server thread
+  samples[1] = {60, 70};
+  loads = {100, 300};
+  new_ranges = BalanceRanges(ranges, samples, loads);
+  EXPECT_EQ(new_ranges[0].end(), 61);
+  EXPECT_EQ(new_ranges[1].end(), 100);
+}
+
+TEST_F(TestRangeBalancer, NoLoad) {
+  std::vector<third_party::Range> ranges{{0, 50}, {50, 100}};
+  auto new_ranges = BalanceRanges(ranges, {{}, {}}, {0, 0});
+  EXPECT_EQ(new_ranges[0].end(), 50);
+  EXPECT_EQ(new_ranges[1].end(), 100);
+}
+
+}  // namespace
+}  // namespace flexps
@@ -2,8 +2,19 @@
 
 #include "glog/logging.h"
 
+#include <algorithm>
+
 namespace flexps {
 
+namespace {
+
+third_party::Range Intersect(const third_party::Range& a, const third_party::Range& b) {
+  uint64_t begin = std::max(a.begin(), b.begin());
+  return third_party::Range(begin, std::max(begin, std::min(a.end(), b.end())));
+}
+
+}  // namespace
+
 ServerThread::~ServerThread() {
 #ifdef USE_TIMER
   LOG(INFO) << "clock_time: " << clock_time_.count()/1000. << " ms";
@@ -19,9 +30,28 @@ void ServerThread::Stop() { work_thread_.join(); }
 
 void ServerThread::RegisterModel(uint32_t model_id, std::unique_ptr<AbstractModel>&& model) {
   CHECK(models_.find(model_id) == models_.end());
+  if (executor_ && model->GetStorage())
+    model->GetStorage()->SetExecutor(executor_.get());
   models_.insert(std::make_pair(model_id, std::move(model)));
 }
 
+void ServerThread::EnableOnlineRebalance(uint32_t model_id, int rebalance_clocks, uint32_t version,
+                                         const std::vector<uint32_t>& server_ids,
+                                         const std::vector<third_party::Range>& ranges,
+                                         const std::vector<uint32_t>& helper_ids) {
+  CHECK(reply_queue_);
+  CHECK_GT(rebalance_clocks, 0);
+  CHECK(!GetStorage(model_id)->SupportSnapshot()) << "The Gets of a snapshot may still be read during the switch";
+  CHECK_EQ(server_ids.size(), ranges.size());
+  OnlineLayout& layout = online_layouts_[model_id];
+  layout.rebalance_clocks = rebalance_clocks;
+  layout.version = version;
+  layout.server_ids = server_ids;
+  layout.ranges = ranges;
+  layout.helper_ids = helper_ids;
+  layout.next_switch_clock = rebalance_clocks;
+}
+
 ThreadsafeQueue<Message>* ServerThread::GetWorkQueue() { return &work_queue_; }
 
 uint32_t ServerThread::GetServerId() const { return server_id_; }
@@ -32,60 +62,346 @@ AbstractModel* ServerThread::GetModel(uint32_t model_id) {
 }
 
 void ServerThread::Main() {
+  bool exit = false;
+  // kExit is the last message, it is served once the lanes are drained
+  auto admit = [this, &exit](Message& msg) {
+    if (msg.meta.flag == Flag::kExit)
+      exit = true;
+    else
+      scheduler_.Push(std::move(msg));
+  };
   while (true) {
+    // Move all the received messages to the lanes, block only if there is nothing to do
     Message msg;
-    work_queue_.WaitAndPop(&msg);
+    if (scheduler_.Empty() && !exit) {
+      work_queue_.WaitAndPop(&msg);
+      admit(msg);
+    }
+    while (work_queue_.TryPop(&msg))
+      admit(msg);
 
-    if (msg.meta.flag == Flag::kExit)
-      break;
+    if (!scheduler_.Pop(&msg)) {
+      if (exit)
+        break;
+      continue;
+    }
+    Process(msg);
+  }
+}
 
-    uint32_t model_id = msg.meta.model_id;
-    CHECK(models_.find(model_id) != models_.end()) << "Unknown model_id: " << model_id;
-    switch (msg.meta.flag) {
-    case Flag::kClock: {
+void ServerThread::Process(Message& msg) {
+  uint32_t model_id = msg.meta.model_id;
+  CHECK(models_.find(model_id) != models_.end()) << "Unknown model_id: " << model_id;
+  if (HoldForLayout(msg))
+    return;
+  switch (msg.meta.flag) {
+  case Flag::kClock: {
 #ifdef USE_TIMER
-      auto start_time = std::chrono::steady_clock::now();
+    auto start_time = std::chrono::steady_clock::now();
 #endif
-      models_[model_id]->Clock(msg);
+    models_[model_id]->Clock(msg);
 #ifdef USE_TIMER
-      auto end_time = std::chrono::steady_clock::now();
-      clock_time_ += std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
+    auto end_time = std::chrono::steady_clock::now();
+    clock_time_ += std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
 #endif
-      break;
-    }
-    case Flag::kAddChunk:
-    case Flag::kAdd: {
+    if (online_layouts_.find(model_id) != online_layouts_.end())
+      TryStartOnlineRepartition(model_id);
+    break;
+  }
+  case Flag::kAddChunk:
+  case Flag::kAdd: {
+    if (msg.meta.flag == Flag::kAdd && !msg.data.empty())
+      load_samplers_[model_id].Count(third_party::SArray<Key>(msg.data[0]));
 #ifdef USE_TIMER
-      auto start_time = std::chrono::steady_clock::now();
+    auto start_time = std::chrono::steady_clock::now();
 #endif
-      models_[model_id]->Add(msg);
+    models_[model_id]->Add(msg);
 #ifdef USE_TIMER
-      auto end_time = std::chrono::steady_clock::now();
-      add_time_ += std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
+    auto end_time = std::chrono::steady_clock::now();
+    add_time_ += std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
 #endif
-      break;
-    }
-    case Flag::kGetChunk:
-    case Flag::kGet: {
+    break;
+  }
+  case Flag::kGetChunk:
+  case Flag::kGetReplica:
+  case Flag::kGet: {
+    if (msg.meta.flag == Flag::kGet && !msg.data.empty())
+      load_samplers_[model_id].Count(third_party::SArray<Key>(msg.data[0]));
 #ifdef USE_TIMER
-      auto start_time = std::chrono::steady_clock::now();
+    auto start_time = std::chrono::steady_clock::now();
 #endif
-      models_[model_id]->Get(msg);
+    models_[model_id]->Get(msg);
 #ifdef USE_TIMER
-      auto end_time = std::chrono::steady_clock::now();
-      get_time_ += std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
+    auto end_time = std::chrono::steady_clock::now();
+    get_time_ += std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
 #endif
-      break;
+    break;
+  }
+  case Flag::kResetWorkerInModel: {
+    auto it = online_layouts_.find(model_id);
+    if (it != online_layouts_.end()) {
+      // The layout the next task starts from, its clocks start from 0
+      Message reply;
+      reply.meta.flag = Flag::kLayout;
+      reply.meta.model_id = model_id;
+      reply.meta.sender = server_id_;
+      reply.meta.recver = msg.meta.sender;
+      reply.meta.layout_version = it->second.version;
+      reply_queue_->Push(std::move(reply));
+      it->second.next_switch_clock = it->second.rebalance_clocks;
     }
-    case Flag::kResetWorkerInModel: {
-      models_[model_id]->ResetWorker(msg);
+    models_[model_id]->ResetWorker(msg);
+
+    break;
+  }
+  case Flag::kReplicaSync: {
+    models_[model_id]->ReplicaSync(msg);
+    break;
+  }
+  case Flag::kQuorumClose: {
+    models_[model_id]->QuorumClose(msg);
+    break;
+  }
+  case Flag::kRepartition: {
+    HandleRepartition(msg);
+    break;
+  }
+  case Flag::kLoadReport: {
+    HandleLoadReport(msg);
+    break;
+  }
+  case Flag::kMigrate: {
+    HandleMigrate(msg);
+    break;
+  }
+  default:
+    CHECK(false) << "Unknown flag in msg: " << FlagName[static_cast<int>(msg.meta.flag)];
+  }
+}
+
+AbstractStorage* ServerThread::GetStorage(uint32_t model_id) {
+  AbstractStorage* storage = models_[model_id]->GetStorage();
+  CHECK(storage) << "The model does not support repartitioning: " << model_id;
+  return storage;
+}
 
-      break;
+void ServerThread::HandleRepartition(Message& msg) {
+  CHECK_EQ(msg.data.size(), 2);
+  auto online_it = online_layouts_.find(msg.meta.model_id);
+  if (online_it != online_layouts_.end()) {
+    // The layout of the engine may not have the last online switch yet
+    const OnlineLayout& layout = online_it->second;
+    StartRepartition(msg.meta.model_id, layout.version + 1, msg.meta.sender, layout.server_ids, layout.ranges);
+    return;
+  }
+  third_party::SArray<uint32_t> server_ids(msg.data[0]);
+  StartRepartition(msg.meta.model_id, msg.meta.layout_version, msg.meta.sender,
+                   std::vector<uint32_t>(server_ids.begin(), server_ids.end()),
+                   DecodeRanges(third_party::SArray<Key>(msg.data[1])));
+}
+
+void ServerThread::StartRepartition(uint32_t model_id, uint32_t version, int coordinator,
+                                    const std::vector<uint32_t>& server_ids,
+                                    const std::vector<third_party::Range>& old_ranges) {
+  CHECK(reply_queue_);
+  const RepartitionId id(model_id, version);
+  Repartition& repartition = repartitions_[id];
+  CHECK(!repartition.started);
+  repartition.started = true;
+  repartition.coordinator = coordinator;
+  repartition.server_ids = server_ids;
+  repartition.old_ranges = old_ranges;
+  CHECK_EQ(repartition.old_ranges.size(), repartition.server_ids.size());
+  GetStorage(model_id)->FlushAdds();
+  auto online_it = online_layouts_.find(model_id);
+  if (online_it != online_layouts_.end())
+    online_it->second.switching = true;
+
+  // Report the load to all server threads of the table
+  LoadSampler& sampler = load_samplers_[model_id];
+  Message report;
+  report.meta.flag = Flag::kLoadReport;
+  report.meta.model_id = model_id;
+  report.meta.sender = server_id_;
+  report.meta.layout_version = version;
+  report.AddData(third_party::SArray<Key>(sampler.GetSamples()));
+  report.AddData(third_party::SArray<uint64_t>({sampler.GetLoad()}));
+  for (auto server_id : repartition.server_ids) {
+    report.meta.recver = server_id;
+    if (server_id == server_id_)
+      repartition.reports[server_id] = report;
+    else
+      reply_queue_->Push(report);
+  }
+  TryMigrate(id);
+}
+
+void ServerThread::HandleLoadReport(Message& msg) {
+  CHECK_EQ(msg.data.size(), 2);
+  const RepartitionId id(msg.meta.model_id, msg.meta.layout_version);
+  repartitions_[id].reports[msg.meta.sender] = msg;
+  TryMigrate(id);
+}
+
+void ServerThread::HandleMigrate(Message& msg) {
+  CHECK_EQ(msg.data.size(), 2);
+  const RepartitionId id(msg.meta.model_id, msg.meta.layout_version);
+  Repartition& repartition = repartitions_[id];
+  if (repartition.new_ranges.empty()) {
+    repartition.early_migrations.push_back(msg);
+    return;
+  }
+  GetStorage(msg.meta.model_id)->ImportKeys(third_party::SArray<Key>(msg.data[0]), msg.data[1]);
+  repartition.num_migrations_received += 1;
+  TryFinishRepartition(id);
+}
+
+void ServerThread::TryMigrate(const RepartitionId& id) {
+  const uint32_t model_id = id.first;
+  Repartition& repartition = repartitions_[id];
+  if (!repartition.started || !repartition.new_ranges.empty() ||
+      repartition.reports.size() < repartition.server_ids.size())
+    return;
+  const auto& server_ids = repartition.server_ids;
+  std::vector<std::vector<Key>> samples(server_ids.size());
+  std::vector<uint64_t> loads(server_ids.size());
+  for (size_t i = 0; i < server_ids.size(); ++i) {
+    auto it = repartition.reports.find(server_ids[i]);
+    CHECK(it != repartition.reports.end()) << "Unexpected load report for model: " << model_id;
+    third_party::SArray<Key> report_samples(it->second.data[0]);
+    samples[i].assign(report_samples.begin(), report_samples.end());
+    loads[i] = third_party::SArray<uint64_t>(it->second.data[1])[0];
+  }
+  repartition.new_ranges = BalanceRanges(repartition.old_ranges, samples, loads);
+
+  // The worker threads may slice with the new layout before all the server threads switch, see OnlineLayout
+  auto online_it = online_layouts_.find(model_id);
+  if (repartition.coordinator == -1 && server_id_ == *std::min_element(server_ids.begin(), server_ids.end())) {
+    CHECK(online_it != online_layouts_.end());
+    Message announce;
+    announce.meta.flag = Flag::kLayout;
+    announce.meta.model_id = model_id;
+    announce.meta.sender = server_id_;
+    announce.meta.layout_version = id.second;
+    announce.AddData(EncodeRanges(repartition.new_ranges));
+    for (auto helper_id : online_it->second.helper_ids) {
+      announce.meta.recver = helper_id;
+      reply_queue_->Push(announce);
     }
-    default:
-      CHECK(false) << "Unknown flag in msg: " << FlagName[static_cast<int>(msg.meta.flag)];
+  }
+
+  // Every server thread knows the old and new ranges, so the receivers know which migrations to expect
+  const size_t self = std::find(server_ids.begin(), server_ids.end(), server_id_) - server_ids.begin();
+  CHECK_LT(self, server_ids.size());
+  AbstractStorage* storage = GetStorage(model_id);
+  for (size_t i = 0; i < server_ids.size(); ++i) {
+    if (i == self)
+      continue;
+    auto out = Intersect(repartition.old_ranges[self], repartition.new_ranges[i]);
+    if (out.size() > 0) {
+      Message migrate;
+      migrate.meta.flag = Flag::kMigrate;
+      migrate.meta.model_id = model_id;
+      migrate.meta.sender = server_id_;
+      migrate.meta.recver = server_ids[i];
+      migrate.meta.layout_version = id.second;
+      third_party::SArray<Key> keys;
+      third_party::SArray<char> vals;
+      storage->ExportRange(out, &keys, &vals);
+      migrate.AddData(keys);
+      migrate.AddData(vals);
+      reply_queue_->Push(migrate);
     }
+    if (Intersect(repartition.old_ranges[i], repartition.new_ranges[self]).size() > 0)
+      repartition.num_migrations_expected += 1;
+  }
+  storage->ResetRange(repartition.new_ranges[self]);
+
+  std::vector<Message> early_migrations;
+  early_migrations.swap(repartition.early_migrations);
+  for (auto& msg : early_migrations) {
+    storage->ImportKeys(third_party::SArray<Key>(msg.data[0]), msg.data[1]);
+    repartition.num_migrations_received += 1;
+  }
+  TryFinishRepartition(id);
+}
+
+void ServerThread::TryFinishRepartition(const RepartitionId& id) {
+  const uint32_t model_id = id.first;
+  Repartition& repartition = repartitions_[id];
+  CHECK_LE(repartition.num_migrations_received, repartition.num_migrations_expected);
+  if (repartition.num_migrations_received < repartition.num_migrations_expected)
+    return;
+  if (repartition.coordinator != -1) {
+    Message reply;
+    reply.meta.flag = Flag::kRepartition;
+    reply.meta.model_id = model_id;
+    reply.meta.sender = server_id_;
+    reply.meta.recver = repartition.coordinator;
+    reply.meta.layout_version = id.second;
+    reply.AddData(EncodeRanges(repartition.new_ranges));
+    reply_queue_->Push(reply);
+  }
+  // The load of the next layout is sampled from scratch
+  load_samplers_[model_id].Clear();
+  std::vector<third_party::Range> new_ranges;
+  new_ranges.swap(repartition.new_ranges);
+  repartitions_.erase(id);
+  if (online_layouts_.find(model_id) != online_layouts_.end())
+    SwitchLayout(model_id, id.second, new_ranges);
+}
+
+bool ServerThread::HoldForLayout(Message& msg) {
+  auto it = online_layouts_.find(msg.meta.model_id);
+  if (it == online_layouts_.end())
+    return false;
+  OnlineLayout& layout = it->second;
+  bool hold = layout.held_senders.find(msg.meta.sender) != layout.held_senders.end();
+  switch (msg.meta.flag) {
+  case Flag::kAdd:
+  case Flag::kAddChunk:
+  case Flag::kGet:
+  case Flag::kGetChunk:
+    CHECK_GE(msg.meta.layout_version, layout.version) << "A request for an old layout of model " << msg.meta.model_id;
+    hold = hold || msg.meta.layout_version > layout.version;
+    break;
+  case Flag::kClock:
+    break;
+  case Flag::kResetWorkerInModel:
+  case Flag::kRepartition:
+    // The next task or repartition starts from the layout being switched to
+    hold = hold || layout.switching;
+    break;
+  default:
+    return false;
   }
+  if (hold) {
+    layout.held_senders.insert(msg.meta.sender);
+    layout.held.push_back(std::move(msg));
+  }
+  return hold;
+}
+
+void ServerThread::TryStartOnlineRepartition(uint32_t model_id) {
+  OnlineLayout& layout = online_layouts_[model_id];
+  if (layout.switching || models_[model_id]->GetMinClock() < layout.next_switch_clock)
+    return;
+  layout.next_switch_clock += layout.rebalance_clocks;
+  StartRepartition(model_id, layout.version + 1, -1, layout.server_ids, layout.ranges);
+}
+
+void ServerThread::SwitchLayout(uint32_t model_id, uint32_t version, const std::vector<third_party::Range>& ranges) {
+  OnlineLayout& layout = online_layouts_[model_id];
+  layout.version = version;
+  layout.ranges = ranges;
+  layout.switching = false;
+  // Replay the held messages in order, those for a later layout are held again
+  std::deque<Message> held;
+  held.swap(layout.held);
+  layout.held_senders.clear();
+  for (auto& msg : held)
+    Process(msg);
+  TryStartOnlineRepartition(model_id);
 }
 
 }  // namespace flexps
@@ -1,11 +1,21 @@
 #pragma once
 
 #include "base/message.hpp"
+#include "base/thread_pool.hpp"
 #include "base/threadsafe_queue.hpp"
+#include "base/third_party/range.h"
 #include "server/abstract_model.hpp"
+#include "server/lane_scheduler.hpp"
+#include "server/range_balancer.hpp"
 
+#include <deque>
+#include <map>
+#include <memory>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 #ifdef USE_TIMER
 #include <chrono>
 #endif
@@ -16,10 +26,31 @@ namespace flexps {
 
 class ServerThread {
  public:
-  ServerThread(uint32_t server_id) : server_id_(server_id) {}
+  /*
+   * reply_queue is used to send the messages of repartitioning, see KVEngine::RebalanceBetweenTasks
+   * and KVEngine::EnableOnlineRebalance.
+   * If num_executors > 0, the storages of the registered models split large requests into key
+   * sub-ranges processed by num_executors extra threads together with this thread.
+   * The requests are served by priority lanes with the given weights, see LaneScheduler.
+   */
+  ServerThread(uint32_t server_id, ThreadsafeQueue<Message>* reply_queue = nullptr, int num_executors = 0,
+               const std::vector<int>& lane_weights = {4, 2, 1})
+      : server_id_(server_id), reply_queue_(reply_queue), scheduler_(lane_weights) {
+    if (num_executors > 0)
+      executor_.reset(new ThreadPool(num_executors));
+  }
   ~ServerThread();
 
   void RegisterModel(uint32_t model_id, std::unique_ptr<AbstractModel>&& model);
+  /*
+   * Rebalance the ranges of the registered model_id every rebalance_clocks clocks, see
+   * KVEngine::EnableOnlineRebalance. version and ranges are its current layout over server_ids,
+   * the new layouts are announced to helper_ids.
+   * The model must track the min clock and its storage must not serve Gets from snapshots.
+   */
+  void EnableOnlineRebalance(uint32_t model_id, int rebalance_clocks, uint32_t version,
+                             const std::vector<uint32_t>& server_ids, const std::vector<third_party::Range>& ranges,
+                             const std::vector<uint32_t>& helper_ids);
   void Start();
   void Stop();
   ThreadsafeQueue<Message>* GetWorkQueue();
@@ -28,12 +59,86 @@ class ServerThread {
 
   AbstractModel* GetModel(uint32_t model_id);
   uint32_t GetServerId() const;
+  // Return nullptr if there is no executor thread
+  ThreadPool* GetExecutor() { return executor_.get(); }
+  // The number of requests received but not yet served in the lane
+  int GetQueueDepth(Lane lane) const { return scheduler_.GetDepth(lane); }
 
  private:
+  void Process(Message& msg);
+
+  /*
+   * Repartitioning to the layout of the next version, started by kRepartition from
+   * KVEngine::RebalanceBetweenTasks when no request of the table is in flight, or online (see OnlineLayout):
+   * 1. Each server thread sends the load sampled from its Gets and Adds to all the server threads
+   *    of the table (kLoadReport).
+   * 2. With all the reports, every server thread computes the same new ranges with BalanceRanges(),
+   *    sends the keys it no longer owns to their new owners (kMigrate) and resets its storage range.
+   * 3. Once the expected migrations are imported, it replies the new ranges to the engine, or switches
+   *    to the new layout if the model is rebalanced online.
+   * The messages carry the version in meta.layout_version, the next repartition may start at another
+   * server thread before this one has finished.
+   */
+  struct Repartition {
+    bool started = false;
+    int coordinator = -1;  // the engine thread to reply to, -1 if online
+    std::vector<uint32_t> server_ids;
+    std::vector<third_party::Range> old_ranges;
+    std::vector<third_party::Range> new_ranges;  // empty until computed
+    std::map<uint32_t, Message> reports;         // server id -> kLoadReport
+    std::vector<Message> early_migrations;       // received before new_ranges is computed
+    int num_migrations_expected = 0;
+    int num_migrations_received = 0;
+  };
+  using RepartitionId = std::pair<uint32_t, uint32_t>;  // (model_id, version)
+  void HandleRepartition(Message& msg);
+  void StartRepartition(uint32_t model_id, uint32_t version, int coordinator, const std::vector<uint32_t>& server_ids,
+                        const std::vector<third_party::Range>& old_ranges);
+  void HandleLoadReport(Message& msg);
+  void HandleMigrate(Message& msg);
+  void TryMigrate(const RepartitionId& id);
+  void TryFinishRepartition(const RepartitionId& id);
+  AbstractStorage* GetStorage(uint32_t model_id);
+
+  /*
+   * Online rebalancing, see KVEngine::EnableOnlineRebalance.
+   *
+   * This server thread switches to the next version of the layout each time the model has the Clocks of all
+   * the worker threads up to the next rebalance_clocks clocks of the task (GetMinClock()), so all the server
+   * threads switch in the same sequence. A worker thread sends the requests of a clock before its Clock, and
+   * slices those after it with the new layout, so all the requests for the old layout are served by then:
+   * none is in flight at the switch. The requests for the new layout reaching this server thread before it
+   * switches (the other server threads may switch earlier) are held with the later messages of their senders,
+   * to keep their order, and replayed once it switches. A request for a layout older than the current one
+   * is a bug. The smallest server thread announces a layout to the worker helper threads once it is computed.
+   */
+  struct OnlineLayout {
+    int rebalance_clocks = 0;
+    uint32_t version = 0;
+    std::vector<uint32_t> server_ids;
+    std::vector<third_party::Range> ranges;
+    std::vector<uint32_t> helper_ids;
+    int next_switch_clock = 0;  // the min clock of the task to switch to the next version at
+    bool switching = false;
+    std::deque<Message> held;
+    std::unordered_set<int> held_senders;
+  };
+  // Return true if msg is held until the switch to its layout
+  bool HoldForLayout(Message& msg);
+  void TryStartOnlineRepartition(uint32_t model_id);
+  void SwitchLayout(uint32_t model_id, uint32_t version, const std::vector<third_party::Range>& ranges);
+
   uint32_t server_id_;
+  ThreadsafeQueue<Message>* reply_queue_;  // not owned
+  std::unordered_map<uint32_t, LoadSampler> load_samplers_;
+  std::map<RepartitionId, Repartition> repartitions_;
+  std::unordered_map<uint32_t, OnlineLayout> online_layouts_;
   std::thread work_thread_;
   ThreadsafeQueue<Message> work_queue_;
+  // Owned by work_thread_, the messages are moved from work_queue_ to it
+  LaneScheduler scheduler_;
   std::unordered_map<uint32_t, std::unique_ptr<AbstractModel>> models_;
+  std::unique_ptr<ThreadPool> executor_;
 
 #ifdef USE_TIMER
   std::chrono::microseconds clock_time_{0};
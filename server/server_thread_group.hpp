@@ -4,20 +4,35 @@
 #include <memory>
 #include <vector>
 
+#include "base/thread_pool.hpp"
 #include "server/server_thread.hpp"
 
 namespace flexps {
 
 class ServerThreadGroup {
  public:
-  ServerThreadGroup(const std::vector<uint32_t>& server_id_vec, ThreadsafeQueue<Message>* reply_queue)
+  /*
+   * If num_reader_threads > 0, the server threads share a pool of reader threads serving Gets
+   * from storage snapshots.
+   * num_executors_per_thread is the number of extra threads each server thread uses to split large requests.
+   */
+  ServerThreadGroup(const std::vector<uint32_t>& server_id_vec, ThreadsafeQueue<Message>* reply_queue,
+                    int num_reader_threads = 0, int num_executors_per_thread = 0)
       : reply_queue_(reply_queue) {
     for (auto& server_id : server_id_vec)
-      server_threads.emplace_back(new ServerThread(server_id));
+      server_threads.emplace_back(new ServerThread(server_id, reply_queue, num_executors_per_thread));
+    if (num_reader_threads > 0)
+      reader_pool_.reset(new ThreadPool(num_reader_threads));
   }
 
   ThreadsafeQueue<Message>* GetReplyQueue() { return reply_queue_; }
 
+  // Return nullptr if there is no reader thread
+  ThreadPool* GetReaderPool() { return reader_pool_.get(); }
+
+  // Wait for the submitted reads and stop the reader threads
+  void StopReaderPool() { reader_pool_.reset(); }
+
   std::vector<std::unique_ptr<ServerThread>>::iterator begin() { return server_threads.begin(); }
 
   std::vector<std::unique_ptr<ServerThread>>::iterator end() { return server_threads.end(); }
@@ -25,6 +40,8 @@ class ServerThreadGroup {
  private:
   std::vector<std::unique_ptr<ServerThread>> server_threads;
   ThreadsafeQueue<Message>* reply_queue_;
+  // Declared after server_threads so that it is stopped before the models are destroyed
+  std::unique_ptr<ThreadPool> reader_pool_;
 };
 
 }  // namespace flexps
@@ -5,6 +5,7 @@
 #include "server/abstract_model.hpp"
 #include "server/server_thread.hpp"
 #include "server/ssp_model.hpp"
+#include "server/vector_storage.hpp"
 
 namespace flexps {
 namespace {
@@ -32,6 +33,14 @@ class FakeModel : public AbstractModel {
   int get_count_ = 0;
 };
 
+class StorageModel : public FakeModel {
+ public:
+  explicit StorageModel(AbstractStorage* storage) : storage_(storage) {}
+  virtual AbstractStorage* GetStorage() override { return storage_.get(); }
+
+  std::unique_ptr<AbstractStorage> storage_;
+};
+
 TEST_F(TestServerThread, Construct) { ServerThread server_thread(0); }
 
 TEST_F(TestServerThread, Basic) {
@@ -71,5 +80,197 @@ TEST_F(TestServerThread, Basic) {
   EXPECT_EQ(p->get_count_, 3);
 }
 
+TEST_F(TestServerThread, Repartition) {
+  ThreadsafeQueue<Message> reply_queue;
+  const uint32_t model_id = 0;
+  const uint32_t coordinator = 100;
+  std::vector<third_party::Range> ranges{{0, 50}, {50, 100}};
+  std::vector<std::unique_ptr<ServerThread>> server_threads;
+  std::vector<VectorStorage<int>*> storages;
+  for (uint32_t i = 0; i < 2; ++i) {
+    auto* storage = new VectorStorage<int>(ranges[i]);
+    third_party::SArray<Key> keys;
+    third_party::SArray<int> vals;
+    for (Key key = ranges[i].begin(); key < ranges[i].end(); ++key) {
+      keys.push_back(key);
+      vals.push_back(key + 1);
+    }
+    storage->SubAdd(keys, third_party::SArray<char>(vals));
+    storages.push_back(storage);
+    server_threads.emplace_back(new ServerThread(i, &reply_queue));
+    server_threads[i]->RegisterModel(model_id, std::unique_ptr<AbstractModel>(new StorageModel(storage)));
+    server_threads[i]->Start();
+  }
+
+  // All the load is on [0, 20)
+  Message get;
+  get.meta.flag = Flag::kGet;
+  get.meta.model_id = model_id;
+  third_party::SArray<Key> hot_keys;
+  for (Key key = 0; key < 20; ++key)
+    hot_keys.push_back(key);
+  get.AddData(hot_keys);
+  server_threads[0]->GetWorkQueue()->Push(get);
+
+  Message repartition;
+  repartition.meta.flag = Flag::kRepartition;
+  repartition.meta.model_id = model_id;
+  repartition.meta.sender = coordinator;
+  repartition.AddData(third_party::SArray<uint32_t>({0, 1}));
+  repartition.AddData(third_party::SArray<Key>({0, 50, 50, 100}));
+  for (auto& server_thread : server_threads)
+    server_thread->GetWorkQueue()->Push(repartition);
+
+  // Route the messages between the server threads until both reply
+  int count = 2;
+  while (count > 0) {
+    Message msg;
+    reply_queue.WaitAndPop(&msg);
+    if (msg.meta.recver == coordinator) {
+      EXPECT_EQ(msg.meta.flag, Flag::kRepartition);
+      third_party::SArray<Key> new_ranges(msg.data[0]);
+      ASSERT_EQ(new_ranges.size(), 4);
+      EXPECT_EQ(new_ranges[1], 10);
+      EXPECT_EQ(new_ranges[2], 10);
+      EXPECT_EQ(new_ranges[3], 100);
+      --count;
+    } else {
+      server_threads[msg.meta.recver]->GetWorkQueue()->Push(msg);
+    }
+  }
+  Message exit_msg;
+  exit_msg.meta.flag = Flag::kExit;
+  for (auto& server_thread : server_threads) {
+    server_thread->GetWorkQueue()->Push(exit_msg);
+    server_thread->Stop();
+  }
+
+  EXPECT_EQ(storages[0]->GetBegin(), 0);
+  EXPECT_EQ(storages[0]->GetEnd(), 10);
+  EXPECT_EQ(storages[1]->GetBegin(), 10);
+  EXPECT_EQ(storages[1]->GetEnd(), 100);
+  third_party::SArray<int> ret(storages[1]->SubGet(third_party::SArray<Key>({10, 49, 50, 99})));
+  EXPECT_EQ(ret[0], 11);
+  EXPECT_EQ(ret[1], 50);
+  EXPECT_EQ(ret[2], 51);
+  EXPECT_EQ(ret[3], 100);
+}
+
+TEST_F(TestServerThread, OnlineRebalance) {
+  ThreadsafeQueue<Message> reply_queue;
+  const uint32_t model_id = 0;
+  const int engine = 100;
+  const uint32_t helper = 200;
+  const int worker0 = 10;
+  const int worker1 = 11;
+  std::vector<third_party::Range> ranges{{0, 50}, {50, 100}};
+  std::vector<std::unique_ptr<ServerThread>> server_threads;
+  std::vector<VectorStorage<int>*> storages;
+  for (uint32_t i = 0; i < 2; ++i) {
+    auto* storage = new VectorStorage<int>(ranges[i]);
+    third_party::SArray<Key> keys;
+    third_party::SArray<int> vals;
+    for (Key key = ranges[i].begin(); key < ranges[i].end(); ++key) {
+      keys.push_back(key);
+      vals.push_back(key + 1);
+    }
+    storage->SubAdd(keys, third_party::SArray<char>(vals));
+    storages.push_back(storage);
+    server_threads.emplace_back(new ServerThread(i, &reply_queue));
+    server_threads[i]->RegisterModel(
+        model_id, std::unique_ptr<AbstractModel>(
+                      new SSPModel(model_id, std::unique_ptr<AbstractStorage>(storage), 0, &reply_queue)));
+    server_threads[i]->EnableOnlineRebalance(model_id, 1, 0, {0, 1}, ranges, {helper});
+    server_threads[i]->Start();
+  }
+
+  // A task starts from the current layout
+  Message reset;
+  reset.meta.flag = Flag::kResetWorkerInModel;
+  reset.meta.model_id = model_id;
+  reset.meta.sender = engine;
+  reset.AddData(third_party::SArray<uint32_t>({worker0, worker1}));
+  for (auto& server_thread : server_threads)
+    server_thread->GetWorkQueue()->Push(reset);
+  for (int i = 0; i < 4; ++i) {
+    Message msg;
+    reply_queue.WaitAndPop(&msg);
+    EXPECT_EQ(msg.meta.recver, engine);
+    if (msg.meta.flag == Flag::kLayout)
+      EXPECT_EQ(msg.meta.layout_version, 0);
+    else
+      EXPECT_EQ(msg.meta.flag, Flag::kResetWorkerInModel);
+  }
+
+  auto make_msg = [model_id](Flag flag, int sender, uint32_t recver, uint32_t layout_version) {
+    Message msg;
+    msg.meta.flag = flag;
+    msg.meta.model_id = model_id;
+    msg.meta.sender = sender;
+    msg.meta.recver = recver;
+    msg.meta.layout_version = layout_version;
+    return msg;
+  };
+  // All the load is on [0, 20)
+  Message get = make_msg(Flag::kGet, worker0, 0, 0);
+  third_party::SArray<Key> hot_keys;
+  for (Key key = 0; key < 20; ++key)
+    hot_keys.push_back(key);
+  get.AddData(hot_keys);
+  server_threads[0]->GetWorkQueue()->Push(get);
+  for (uint32_t i = 0; i < 2; ++i)
+    server_threads[i]->GetWorkQueue()->Push(make_msg(Flag::kClock, worker0, i, 0));
+  // worker0 slices with the layout of clock 1, key 15 moves to server 1 which has not switched yet
+  Message add = make_msg(Flag::kAdd, worker0, 1, 1);
+  add.AddData(third_party::SArray<Key>({15}));
+  add.AddData(third_party::SArray<int>({1}));
+  server_threads[1]->GetWorkQueue()->Push(add);
+  Message get_moved = make_msg(Flag::kGet, worker0, 1, 1);
+  get_moved.meta.version = 1;
+  get_moved.AddData(third_party::SArray<Key>({15}));
+  server_threads[1]->GetWorkQueue()->Push(get_moved);
+  // The switch to version 1 once worker1 clocks too
+  for (uint32_t i = 0; i < 2; ++i)
+    server_threads[i]->GetWorkQueue()->Push(make_msg(Flag::kClock, worker1, i, 0));
+
+  // Route the messages between the server threads until both Gets are replied
+  bool announced = false;
+  int num_gets = 2;
+  while (num_gets > 0) {
+    Message msg;
+    reply_queue.WaitAndPop(&msg);
+    if (msg.meta.recver == helper) {
+      EXPECT_EQ(msg.meta.flag, Flag::kLayout);
+      EXPECT_EQ(msg.meta.layout_version, 1);
+      third_party::SArray<Key> new_ranges(msg.data[0]);
+      ASSERT_EQ(new_ranges.size(), 4);
+      EXPECT_EQ(new_ranges[1], 10);
+      EXPECT_EQ(new_ranges[2], 10);
+      EXPECT_EQ(new_ranges[3], 100);
+      announced = true;
+    } else if (msg.meta.recver == worker0) {
+      ASSERT_EQ(msg.meta.flag, Flag::kGetReply);
+      if (msg.meta.sender == 1) {
+        // The held Add is served by the new owner before the Get
+        EXPECT_TRUE(announced);
+        third_party::SArray<int> vals(msg.data[1]);
+        ASSERT_EQ(vals.size(), 1);
+        EXPECT_EQ(vals[0], 17);
+      }
+      --num_gets;
+    } else {
+      server_threads[msg.meta.recver]->GetWorkQueue()->Push(msg);
+    }
+  }
+  Message exit_msg;
+  exit_msg.meta.flag = Flag::kExit;
+  for (auto& server_thread : server_threads) {
+    server_thread->GetWorkQueue()->Push(exit_msg);
+    server_thread->Stop();
+  }
+  EXPECT_EQ(storages[0]->GetEnd(), 10);
+  EXPECT_EQ(storages[1]->GetBegin(), 10);
+}
+
 }  // namespace
 }  // namespace flexps
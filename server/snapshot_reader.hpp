@@ -0,0 +1,29 @@
+#pragma once
+
+#include "base/message.hpp"
+#include "base/thread_pool.hpp"
+#include "base/threadsafe_queue.hpp"
+#include "server/abstract_storage.hpp"
+
+namespace flexps {
+
+/*
+ * Reply a Get that can be served now.
+ *
+ * If the storage keeps snapshots and a reader pool is given, the Get is served from the last snapshot
+ * by a reader thread, so that the server thread can go on with the Adds behind it. Otherwise the
+ * Get is served from the current version on the calling thread, after the pending Adds are flushed
+ * if flush_adds.
+ */
+inline void ReplyGet(AbstractStorage* storage, Message& msg, ThreadsafeQueue<Message>* reply_queue,
+                     ThreadPool* reader_pool, bool flush_adds) {
+  if (reader_pool && storage->SupportSnapshot()) {
+    reader_pool->Submit([storage, msg, reply_queue]() mutable { reply_queue->Push(storage->GetFromSnapshot(msg)); });
+  } else {
+    if (flush_adds)
+      storage->FlushAdds();
+    reply_queue->Push(storage->Get(msg));
+  }
+}
+
+}  // namespace flexps
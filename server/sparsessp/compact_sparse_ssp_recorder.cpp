@@ -0,0 +1,188 @@
+#include "server/sparsessp/compact_sparse_ssp_recorder.hpp"
+#include "glog/logging.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace flexps {
+
+namespace {
+
+const uint64_t kLowBits = 0x7f7f7f7f7f7f7f7fULL;
+const uint64_t kHighBits = 0x8080808080808080ULL;
+
+// Set the high bit of each non-zero byte of word
+inline uint64_t NonZeroBytes(uint64_t word) { return (((word & kLowBits) + kLowBits) | word) & kHighBits; }
+
+}  // namespace
+
+CompactSparseSSPRecorder::CompactSparseSSPRecorder(uint32_t staleness, uint32_t speculation,
+                                                   third_party::Range range)
+    : staleness_(staleness), speculation_(speculation), range_(range) {
+  CHECK_GT(range_.end(), range_.begin());
+  // The same levels as VectorSparseSSPRecorder
+  num_levels_ = staleness_ + 2 * speculation_ + 3;
+  stride_ = (num_levels_ + 7) / 8 * 8;
+  window_.assign(stride_ / 8, 0);
+  counts_.assign((range_.end() - range_.begin()) * stride_, 0);
+}
+
+uint32_t CompactSparseSSPRecorder::GetCount(Key key, int version) const {
+  size_t slot = GetSlot(key, version);
+  if (counts_[slot] < kSaturated)
+    return counts_[slot];
+  auto it = overflow_.find(slot);
+  return kSaturated + (it == overflow_.end() ? 0 : it->second);
+}
+
+void CompactSparseSSPRecorder::GetNonConflictMsgs(int progress, int sender, int min_clock,
+                                                  std::vector<Message>* const msgs) {
+  // Get() that are block here
+  auto& future_keys = future_keys_[sender];
+  if (future_keys.size() > 0 && future_keys.front().first == progress - 1) {
+    RemoveRecordAndGetNonConflictMsgs(progress - 1, min_clock, future_keys.front().second, msgs);
+    future_keys.pop();
+  }
+
+  // Its own Get()
+  auto& future_msgs = future_msgs_[sender];
+  if (future_msgs.size() > 0 && future_msgs.front().first == progress) {
+    Message& msg = future_msgs.front().second;
+    CHECK(msg.meta.version >= min_clock && msg.meta.version < min_clock + staleness_ + speculation_ + 2)
+        << "msg version: " << msg.meta.version << " min_clock: " << min_clock << " staleness: " << staleness_
+        << " speculation: " << speculation_;
+    if (msg.meta.version <= staleness_ + min_clock) {
+      msgs->push_back(std::move(msg));
+    } else if (msg.meta.version <= min_clock + staleness_ + speculation_) {
+      ParkOrRelease(std::move(msg), min_clock, msgs);
+    } else if (msg.meta.version == min_clock + staleness_ + speculation_ + 1) {
+      too_fast_buffer_.push_back(std::move(msg));
+    } else {
+      CHECK(false) << " version: " << msg.meta.version << " tid: " << msg.meta.sender;
+    }
+    future_msgs.pop();
+  }
+}
+
+void CompactSparseSSPRecorder::HandleTooFastBuffer(int min_clock, std::vector<Message>* const msgs) {
+  for (auto& msg : too_fast_buffer_) {
+    ParkOrRelease(std::move(msg), min_clock, msgs);
+  }
+  too_fast_buffer_.clear();
+}
+
+void CompactSparseSSPRecorder::AddRecord(Message& msg) {
+  DCHECK_LT(future_keys_[msg.meta.sender].size(), speculation_ + 1);
+  third_party::SArray<Key> keys(msg.data[0]);
+  future_keys_[msg.meta.sender].push({msg.meta.version, keys});
+
+  for (auto key : keys) {
+    size_t slot = GetSlot(key, msg.meta.version);
+    if (counts_[slot] < kSaturated)
+      counts_[slot] += 1;
+    else
+      overflow_[slot] += 1;
+  }
+
+  int version = msg.meta.version;
+  if (version != 0) {
+    future_msgs_[msg.meta.sender].push({version, std::move(msg)});
+  }
+}
+
+void CompactSparseSSPRecorder::RemoveRecordAndGetNonConflictMsgs(int version, int min_clock,
+                                                                 const third_party::SArray<Key>& keys,
+                                                                 std::vector<Message>* msgs) {
+  std::vector<Message> msgs_to_be_handled;
+  for (auto key : keys) {
+    size_t slot = GetSlot(key, version);
+    DCHECK_GT(counts_[slot], 0);
+    if (counts_[slot] == kSaturated) {
+      auto it = overflow_.find(slot);
+      if (it != overflow_.end()) {
+        if (--it->second == 0)
+          overflow_.erase(it);
+        continue;
+      }
+    }
+    counts_[slot] -= 1;
+    if (counts_[slot] == 0) {
+      auto it = parked_.find(slot);
+      if (it != parked_.end()) {
+        for (auto& msg : it->second) {
+          msgs_to_be_handled.push_back(std::move(msg));
+        }
+        parked_.erase(it);
+      }
+    }
+  }
+
+  for (auto& msg : msgs_to_be_handled) {
+    ParkOrRelease(std::move(msg), min_clock, msgs);
+  }
+}
+
+void CompactSparseSSPRecorder::ParkOrRelease(Message&& msg, int min_clock, std::vector<Message>* msgs) {
+  int forwarded_key = -1;
+  int forwarded_version = -1;
+  if (HasConflict(third_party::SArray<Key>(msg.data[0]), min_clock, msg.meta.version - staleness_ - 1,
+                  &forwarded_key, &forwarded_version)) {
+    parked_[GetSlot(forwarded_key, forwarded_version)].push_back(std::move(msg));
+  } else {
+    msgs->push_back(std::move(msg));
+  }
+}
+
+void CompactSparseSSPRecorder::RemoveRecord(const int version) {}
+
+/*
+ * Find the latest version in [begin_version, end_version] at which one of the keys has pending Gets,
+ * and the first such key, as VectorSparseSSPRecorder::HasConflict does.
+ */
+bool CompactSparseSSPRecorder::HasConflict(const third_party::SArray<Key>& keys, const int begin_version,
+                                           const int end_version, int* forwarded_key, int* forwarded_version) {
+  if (end_version < begin_version)
+    return false;
+  CHECK_LT(end_version - begin_version, num_levels_);
+  // window_ has the high bit set at the levels of [begin_version, end_version], the consecutive
+  // Gets of a clock mostly check the same window
+  uint8_t* window_bytes = reinterpret_cast<uint8_t*>(window_.data());
+  if (begin_version != window_begin_ || end_version != window_end_) {
+    std::fill(window_.begin(), window_.end(), 0);
+    for (int version = begin_version; version <= end_version; ++version)
+      window_bytes[version % num_levels_] = 0x80;
+    window_begin_ = begin_version;
+    window_end_ = end_version;
+  }
+  const uint32_t num_words = window_.size();
+
+  const int begin_level = begin_version % num_levels_;
+  int best_version = -1;
+  for (auto key : keys) {
+    const uint8_t* counts = counts_.data() + (key - range_.begin()) * stride_;
+    for (uint32_t w = 0; w < num_words; ++w) {
+      uint64_t word;
+      std::memcpy(&word, counts + w * 8, sizeof(word));
+      if ((NonZeroBytes(word) & window_[w]) == 0)
+        continue;
+      // Rare: find the conflicting levels of the 8
+      for (uint32_t level = w * 8; level < w * 8 + 8; ++level) {
+        if (counts[level] == 0 || window_bytes[level] == 0)
+          continue;
+        int version = begin_version + (static_cast<int>(level) - begin_level + num_levels_) % num_levels_;
+        if (version > best_version) {
+          best_version = version;
+          *forwarded_key = key;
+        }
+      }
+    }
+    if (best_version == end_version)
+      break;
+  }
+  if (best_version == -1)
+    return false;
+  *forwarded_version = best_version;
+  return true;
+}
+
+}  // namespace flexps
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "server/sparsessp/abstract_sparse_ssp_recorder.hpp"
+#include "base/third_party/range.h"
+#include "glog/logging.h"
+
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace flexps {
+
+/*
+ * A SparseSSP recorder for a dense key range with a compact layout.
+ *
+ * VectorSparseSSPRecorder keeps a {count, [msg]} pair for every key at every version level, i.e.
+ * more than 32 bytes per key per level. Here each key has one byte counter per level, padded to
+ * a multiple of 8 levels and stored contiguously (key-major), so a key costs 8 bytes for up to 8 levels:
+ * - A counter saturates at kSaturated, the excess is kept in overflow_, which is only touched by
+ *   the keys with that many pending Gets.
+ * - The parked messages are in a side map that only has the keys with waiters.
+ * - The conflict check of a key tests 8 levels at once by loading them as a uint64_t (SWAR).
+ */
+class CompactSparseSSPRecorder : public AbstractSparseSSPRecorder {
+public:
+  CompactSparseSSPRecorder(uint32_t staleness, uint32_t speculation, third_party::Range range);
+  virtual void GetNonConflictMsgs(int progress, int sender, int min_clock, std::vector<Message>* const msgs) override;
+  virtual void HandleTooFastBuffer(int min_clock, std::vector<Message>* const msgs) override;
+  virtual void RemoveRecord(int version) override;
+  virtual void AddRecord(Message& msg) override;
+
+  // For test
+  uint32_t GetCount(Key key, int version) const;
+  size_t GetNumParkedKeys() const { return parked_.size(); }
+
+  static const uint8_t kSaturated = 255;
+
+private:
+  void RemoveRecordAndGetNonConflictMsgs(int version, int min_clock, const third_party::SArray<Key>& keys,
+                                         std::vector<Message>* msgs);
+  // Park msg on its conflict, or append it to msgs if there is none
+  void ParkOrRelease(Message&& msg, int min_clock, std::vector<Message>* msgs);
+
+  bool HasConflict(const third_party::SArray<Key>& keys, const int begin_version,
+                   const int end_version, int* forwarded_key, int* forwarded_version);
+
+  size_t GetSlot(Key key, int version) const {
+    DCHECK_GE(key, range_.begin());
+    DCHECK_LT(key, range_.end());
+    return (key - range_.begin()) * stride_ + version % num_levels_;
+  }
+
+  uint32_t staleness_;
+  uint32_t speculation_;
+  third_party::Range range_;
+  uint32_t num_levels_;
+  // num_levels_ rounded up to a multiple of 8
+  uint32_t stride_;
+
+  // The window mask of the last HasConflict, one byte per level, and its versions
+  std::vector<uint64_t> window_;
+  int window_begin_ = -1;
+  int window_end_ = -2;
+
+  // <key * stride_ + version % num_levels_, count>
+  std::vector<uint8_t> counts_;
+  // <slot, count - kSaturated> of the saturated counters
+  std::unordered_map<size_t, uint32_t> overflow_;
+  // <slot, [msg]> of the slots with waiters
+  std::unordered_map<size_t, std::vector<Message>> parked_;
+
+  // <thread_id, [<version, key>]>, has at most speculation_ + 1 queue size for each thread_id
+  std::unordered_map<int, std::queue<std::pair<int, third_party::SArray<Key>>>> future_keys_;
+
+  // <thread_id, [<version, msg>]>
+  std::unordered_map<int, std::queue<std::pair<int, Message>>> future_msgs_;
+
+  std::vector<Message> too_fast_buffer_;
+};
+
+}  // namespace flexps
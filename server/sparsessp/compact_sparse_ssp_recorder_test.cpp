@@ -0,0 +1,89 @@
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "server/sparsessp/compact_sparse_ssp_recorder.hpp"
+
+namespace flexps {
+namespace {
+
+class TestCompactSparseSSPRecorder : public testing::Test {
+ public:
+  TestCompactSparseSSPRecorder() {}
+  ~TestCompactSparseSSPRecorder() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+TEST_F(TestCompactSparseSSPRecorder, ParkAndRelease) {
+  const int staleness = 0;
+  const int speculation = 1;
+  CompactSparseSSPRecorder recorder(staleness, speculation, {0, 10});
+
+  Message m0 = CreateMessage(Flag::kGet, 0, 0, 0, 0, {3});
+  recorder.AddRecord(m0);
+  Message m1 = CreateMessage(Flag::kGet, 0, 1, 0, 1, {3, 5});
+  recorder.AddRecord(m1);
+  EXPECT_EQ(recorder.GetCount(3, 0), 1);
+  EXPECT_EQ(recorder.GetCount(3, 1), 1);
+  EXPECT_EQ(recorder.GetCount(5, 0), 0);
+
+  // The Get of version 1 conflicts with the pending Get of version 0 on key 3
+  std::vector<Message> msgs;
+  recorder.GetNonConflictMsgs(1, 1, 0, &msgs);
+  EXPECT_EQ(msgs.size(), 0);
+  EXPECT_EQ(recorder.GetNumParkedKeys(), 1);
+
+  // Released once thread 0 moves on
+  recorder.GetNonConflictMsgs(1, 0, 0, &msgs);
+  ASSERT_EQ(msgs.size(), 1);
+  EXPECT_EQ(msgs[0].meta.sender, 1);
+  EXPECT_EQ(recorder.GetCount(3, 0), 0);
+  EXPECT_EQ(recorder.GetNumParkedKeys(), 0);
+}
+
+TEST_F(TestCompactSparseSSPRecorder, LatestConflict) {
+  const int staleness = 0;
+  const int speculation = 2;
+  CompactSparseSSPRecorder recorder(staleness, speculation, {0, 10});
+
+  Message m0 = CreateMessage(Flag::kGet, 0, 0, 0, 0, {1});
+  recorder.AddRecord(m0);
+  Message m1 = CreateMessage(Flag::kGet, 0, 1, 0, 1, {2});
+  recorder.AddRecord(m1);
+  Message m2 = CreateMessage(Flag::kGet, 0, 2, 0, 2, {1, 2});
+  recorder.AddRecord(m2);
+
+  // Thread 2 conflicts at version 0 (key 1) and 1 (key 2), it waits for the latest
+  std::vector<Message> msgs;
+  recorder.GetNonConflictMsgs(2, 2, 0, &msgs);
+  EXPECT_EQ(msgs.size(), 0);
+  recorder.GetNonConflictMsgs(1, 0, 0, &msgs);
+  EXPECT_EQ(msgs.size(), 0);
+  // Thread 1 takes its own Get of version 1 but it has no conflict, then releases key 2 of version 1
+  recorder.GetNonConflictMsgs(1, 1, 0, &msgs);
+  ASSERT_EQ(msgs.size(), 1);
+  EXPECT_EQ(msgs[0].meta.sender, 1);
+  recorder.GetNonConflictMsgs(2, 1, 1, &msgs);
+  ASSERT_EQ(msgs.size(), 2);
+  EXPECT_EQ(msgs[1].meta.sender, 2);
+}
+
+TEST_F(TestCompactSparseSSPRecorder, Saturate) {
+  CompactSparseSSPRecorder recorder(1, 1, {100, 200});
+  const int num_senders = 300;
+  for (int sender = 0; sender < num_senders; ++sender) {
+    Message m = CreateMessage(Flag::kGet, 0, sender, 0, 0, {150});
+    recorder.AddRecord(m);
+  }
+  EXPECT_EQ(recorder.GetCount(150, 0), num_senders);
+  std::vector<Message> msgs;
+  for (int sender = 0; sender < num_senders; ++sender) {
+    recorder.GetNonConflictMsgs(1, sender, 0, &msgs);
+    EXPECT_EQ(recorder.GetCount(150, 0), num_senders - sender - 1);
+  }
+}
+
+}  // namespace
+}  // namespace flexps
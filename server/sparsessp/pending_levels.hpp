@@ -0,0 +1,59 @@
+#pragma once
+
+#include "glog/logging.h"
+
+#include <cinttypes>
+
+namespace flexps {
+
+/*
+ * The per-key index of the SparseSSP recorders: bit (version % num_levels) of a key's mask is set
+ * while some Get of that version reads the key. The pending versions of a key span fewer than
+ * num_levels versions, so the bits do not collide.
+ *
+ * HasConflict() then takes one lookup per key, and gets the latest conflicting version of a key
+ * from its mask directly instead of probing each version.
+ *
+ * A mask holds at most kMaxLevels levels. With more levels the index is disabled, and the recorders
+ * keep no masks and probe each version of the window instead.
+ */
+class PendingLevels {
+ public:
+  static const uint32_t kMaxLevels = 64;
+
+  explicit PendingLevels(uint32_t num_levels) : num_levels_(num_levels) {
+    CHECK_GT(num_levels_, 0);
+    all_levels_ = num_levels_ >= kMaxLevels ? ~0ULL : (1ULL << num_levels_) - 1;
+  }
+
+  bool Enabled() const { return num_levels_ <= kMaxLevels; }
+
+  uint64_t Bit(int version) const { return 1ULL << (version % num_levels_); }
+
+  // The mask of the versions in [begin_version, end_version], which must span fewer than num_levels versions
+  uint64_t Window(int begin_version, int end_version) const {
+    CHECK_LT(end_version - begin_version, static_cast<int>(num_levels_));
+    uint64_t window = 0;
+    for (int version = begin_version; version <= end_version; ++version)
+      window |= Bit(version);
+    return window;
+  }
+
+  // The latest version of pending within the window starting from begin_version, -1 if none
+  int Latest(uint64_t pending, uint64_t window, int begin_version) const {
+    uint64_t hits = pending & window;
+    if (hits == 0)
+      return -1;
+    // Rotate so that bit i is version begin_version + i
+    uint32_t shift = begin_version % num_levels_;
+    if (shift != 0)
+      hits = ((hits >> shift) | (hits << (num_levels_ - shift))) & all_levels_;
+    return begin_version + 63 - __builtin_clzll(hits);
+  }
+
+ private:
+  uint32_t num_levels_;
+  uint64_t all_levels_;
+};
+
+}  // namespace flexps
@@ -0,0 +1,44 @@
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "server/sparsessp/pending_levels.hpp"
+
+namespace flexps {
+namespace {
+
+class TestPendingLevels : public testing::Test {
+ public:
+  TestPendingLevels() {}
+  ~TestPendingLevels() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+TEST_F(TestPendingLevels, Latest) {
+  PendingLevels levels(5);
+  uint64_t pending = levels.Bit(6) | levels.Bit(8);
+  EXPECT_EQ(levels.Latest(pending, levels.Window(5, 8), 5), 8);
+  EXPECT_EQ(levels.Latest(pending, levels.Window(5, 7), 5), 6);
+  EXPECT_EQ(levels.Latest(pending, levels.Window(7, 7), 7), -1);
+  // The window wraps around the levels: versions 8, 9, 10, 11 are levels 3, 4, 0, 1
+  pending = levels.Bit(8) | levels.Bit(10);
+  EXPECT_EQ(levels.Latest(pending, levels.Window(8, 11), 8), 10);
+  EXPECT_EQ(levels.Latest(pending, levels.Window(8, 9), 8), 8);
+}
+
+TEST_F(TestPendingLevels, AllLevels) {
+  PendingLevels levels(64);
+  uint64_t pending = levels.Bit(63) | levels.Bit(64);
+  EXPECT_EQ(levels.Latest(pending, levels.Window(1, 64), 1), 64);
+  EXPECT_EQ(levels.Latest(pending, levels.Window(1, 63), 1), 63);
+}
+
+TEST_F(TestPendingLevels, Enabled) {
+  EXPECT_TRUE(PendingLevels(64).Enabled());
+  EXPECT_FALSE(PendingLevels(65).Enabled());
+}
+
+}  // namespace
+}  // namespace flexps
@@ -0,0 +1,75 @@
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "server/sparsessp/unordered_map_sparse_ssp_recorder.hpp"
+#include "server/sparsessp/vector_sparse_ssp_recorder.hpp"
+
+namespace flexps {
+namespace {
+
+class TestSparseSSPRecorder : public testing::Test {
+ public:
+  TestSparseSSPRecorder() {}
+  ~TestSparseSSPRecorder() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+/*
+ * The Get of thread 2 at version 2 conflicts with the pending Gets at version 0 (key 1) and 1 (key 2),
+ * it is forwarded to the latest one and released once both are done.
+ */
+template <typename Recorder>
+void CheckForwardToLatest(Recorder* recorder) {
+  Message m0 = CreateMessage(Flag::kGet, 0, 0, 0, 0, {1});
+  recorder->AddRecord(m0);
+  Message m1 = CreateMessage(Flag::kGet, 0, 1, 0, 1, {2});
+  recorder->AddRecord(m1);
+  Message m2 = CreateMessage(Flag::kGet, 0, 2, 0, 2, {1, 2});
+  recorder->AddRecord(m2);
+
+  std::vector<Message> msgs;
+  recorder->GetNonConflictMsgs(2, 2, 0, &msgs);
+  EXPECT_EQ(msgs.size(), 0);
+  EXPECT_EQ(recorder->GetNumParkedMsgs(0), 0);
+  EXPECT_EQ(recorder->GetNumParkedMsgs(1), 1);
+
+  // Thread 0 releases key 1 of version 0, the Get still waits for version 1
+  recorder->GetNonConflictMsgs(1, 0, 0, &msgs);
+  EXPECT_EQ(msgs.size(), 0);
+  EXPECT_EQ(recorder->GetNumParkedMsgs(1), 1);
+  // Thread 1 takes its own Get of version 1, then releases key 2 of version 1
+  recorder->GetNonConflictMsgs(1, 1, 0, &msgs);
+  ASSERT_EQ(msgs.size(), 1);
+  EXPECT_EQ(msgs[0].meta.sender, 1);
+  recorder->GetNonConflictMsgs(2, 1, 1, &msgs);
+  ASSERT_EQ(msgs.size(), 2);
+  EXPECT_EQ(msgs[1].meta.sender, 2);
+  EXPECT_EQ(recorder->GetNumParkedMsgs(1), 0);
+}
+
+TEST_F(TestSparseSSPRecorder, MapForwardToLatest) {
+  UnorderedMapSparseSSPRecorder recorder(0, 2);
+  CheckForwardToLatest(&recorder);
+}
+
+TEST_F(TestSparseSSPRecorder, VectorForwardToLatest) {
+  VectorSparseSSPRecorder recorder(0, 2, {0, 10});
+  CheckForwardToLatest(&recorder);
+}
+
+// staleness + 2 * speculation + 3 > 64 levels, the recorders scan the versions instead of the masks
+TEST_F(TestSparseSSPRecorder, MapManyLevels) {
+  UnorderedMapSparseSSPRecorder recorder(0, 40);
+  CheckForwardToLatest(&recorder);
+}
+
+TEST_F(TestSparseSSPRecorder, VectorManyLevels) {
+  VectorSparseSSPRecorder recorder(0, 40, {0, 10});
+  CheckForwardToLatest(&recorder);
+}
+
+}  // namespace
+}  // namespace flexps
@@ -53,7 +53,10 @@ void UnorderedMapSparseSSPRecorder::AddRecord(Message& msg) {
   future_keys_[msg.meta.sender].push({msg.meta.version, third_party::SArray<Key>(msg.data[0])});
 
   for (auto key : third_party::SArray<Key>(msg.data[0])) {
-    main_recorder_[msg.meta.version][key].first += 1;
+    auto& record = main_recorder_[msg.meta.version][key];
+    record.first += 1;
+    if (record.first == 1 && levels_.Enabled())
+      pending_[key] |= levels_.Bit(msg.meta.version);
   }
 
   int version = msg.meta.version;
@@ -75,6 +78,7 @@ void UnorderedMapSparseSSPRecorder::RemoveRecordAndGetNonConflictMsgs(int versio
         msgs_to_be_handled.push_back(std::move(msg));
       }
       main_recorder_[version].erase(key);
+      ClearPending(key, version);
     }
   }
   for (auto& msg : msgs_to_be_handled) {
@@ -90,7 +94,33 @@ void UnorderedMapSparseSSPRecorder::RemoveRecordAndGetNonConflictMsgs(int versio
 }
 
 void UnorderedMapSparseSSPRecorder::RemoveRecord(const int version) { 
-  main_recorder_.erase(version); 
+  auto it = main_recorder_.find(version);
+  if (it == main_recorder_.end())
+    return;
+  for (auto& record : it->second)
+    ClearPending(record.first, version);
+  main_recorder_.erase(it);
+}
+
+size_t UnorderedMapSparseSSPRecorder::GetNumParkedMsgs(int version) const {
+  auto it = main_recorder_.find(version);
+  if (it == main_recorder_.end())
+    return 0;
+  size_t num_msgs = 0;
+  for (const auto& record : it->second)
+    num_msgs += record.second.second.size();
+  return num_msgs;
+}
+
+void UnorderedMapSparseSSPRecorder::ClearPending(uint32_t key, int version) {
+  if (!levels_.Enabled())
+    return;
+  auto it = pending_.find(key);
+  if (it == pending_.end())
+    return;
+  it->second &= ~levels_.Bit(version);
+  if (it->second == 0)
+    pending_.erase(it);
 }
 
 /* IF:
@@ -99,17 +129,39 @@ void UnorderedMapSparseSSPRecorder::RemoveRecord(const int version) {
  */
 bool UnorderedMapSparseSSPRecorder::HasConflict(const third_party::SArray<Key>& keys, const int begin_version,
                                           const int end_version, int* forwarded_key, int* forwarded_version) {
-  for (int check_version = end_version; check_version >= begin_version; check_version--) {
-    for (auto& key : keys) {
-      auto it = main_recorder_[check_version].find(key);
-      if (it != main_recorder_[check_version].end()) {
-        *forwarded_key = key;
-        *forwarded_version = check_version;
-        return true;
+  if (end_version < begin_version)
+    return false;
+  if (!levels_.Enabled()) {
+    for (int check_version = end_version; check_version >= begin_version; check_version--) {
+      auto version_it = main_recorder_.find(check_version);
+      if (version_it == main_recorder_.end())
+        continue;
+      for (auto& key : keys) {
+        if (version_it->second.find(key) != version_it->second.end()) {
+          *forwarded_key = key;
+          *forwarded_version = check_version;
+          return true;
+        }
       }
     }
+    return false;
+  }
+  // Forward to the latest conflicting version, the first key with it
+  uint64_t window = levels_.Window(begin_version, end_version);
+  *forwarded_version = -1;
+  for (auto& key : keys) {
+    auto it = pending_.find(key);
+    if (it == pending_.end())
+      continue;
+    int version = levels_.Latest(it->second, window, begin_version);
+    if (version > *forwarded_version) {
+      *forwarded_key = key;
+      *forwarded_version = version;
+      if (version == end_version)
+        break;
+    }
   }
-  return false;
+  return *forwarded_version != -1;
 }
 
 } // namespace flexps
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "server/sparsessp/abstract_sparse_ssp_recorder.hpp"
+#include "server/sparsessp/pending_levels.hpp"
 #include "glog/logging.h"
 
 #include <unordered_map>
@@ -10,11 +11,14 @@ namespace flexps {
 
 class UnorderedMapSparseSSPRecorder : public AbstractSparseSSPRecorder {
 public:
-  UnorderedMapSparseSSPRecorder(uint32_t staleness, uint32_t speculation) : staleness_(staleness), speculation_(speculation) {}
+  UnorderedMapSparseSSPRecorder(uint32_t staleness, uint32_t speculation)
+      : staleness_(staleness), speculation_(speculation), levels_(staleness + 2 * speculation + 3) {}
   virtual void GetNonConflictMsgs(int progress, int sender, int min_clock, std::vector<Message>* const msgs) override;
   virtual void HandleTooFastBuffer(int min_clock, std::vector<Message>* const msgs) override;
   virtual void RemoveRecord(int version) override;
   virtual void AddRecord(Message& msg) override;
+  // The number of Gets forwarded to wait for the pending Gets of version, for testing
+  size_t GetNumParkedMsgs(int version) const;
 
 private:
   void RemoveRecordAndGetNonConflictMsgs(int version, int min_clock, uint32_t tid,
@@ -22,6 +26,7 @@ private:
 
   bool HasConflict(const third_party::SArray<Key>& keys, const int begin_version,
                    const int end_version, int* forwarded_key, int* forwarded_version);
+  void ClearPending(uint32_t key, int version);
 
   uint32_t staleness_;
   uint32_t speculation_;
@@ -29,6 +34,11 @@ private:
   // <version, <key, {count, [msg]}>>
   std::unordered_map<int, std::unordered_map<uint32_t, std::pair<uint32_t, std::vector<Message>>>> main_recorder_;
 
+  // <key, mask of the versions with pending Gets>, only the keys with pending Gets, see PendingLevels,
+  // empty if the levels are not enabled
+  PendingLevels levels_;
+  std::unordered_map<uint32_t, uint64_t> pending_;
+
   // <thread_id, [<version, key>]>, has at most speculation_ + 1 queue size for each thread_id
   std::unordered_map<int, std::queue<std::pair<int, third_party::SArray<Key>>>> future_keys_;
 
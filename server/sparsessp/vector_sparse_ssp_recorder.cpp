@@ -4,10 +4,13 @@
 namespace flexps {
 
 VectorSparseSSPRecorder::VectorSparseSSPRecorder(uint32_t staleness, uint32_t speculation, third_party::Range range) 
-    : staleness_(staleness), speculation_(speculation), range_(range) {
+    : staleness_(staleness), speculation_(speculation), range_(range),
+      levels_(staleness + 2 * speculation + 3) {
 
   // Just make sure that preallocated space is larger than needed
   main_recorder_version_level_size_ = staleness_ + 2 * speculation_ + 3;
+  if (levels_.Enabled())
+    pending_.assign(range_.end() - range_.begin(), 0);
 
   main_recorder_.resize(main_recorder_version_level_size_);
 
@@ -116,7 +119,10 @@ void VectorSparseSSPRecorder::AddRecord(Message& msg) {
   auto start_time = std::chrono::steady_clock::now();
 #endif
   for (auto key : third_party::SArray<Key>(msg.data[0])) {
-    main_recorder_[msg.meta.version % main_recorder_version_level_size_][key - range_.begin()].first += 1;
+    auto& record = main_recorder_[msg.meta.version % main_recorder_version_level_size_][key - range_.begin()];
+    record.first += 1;
+    if (record.first == 1 && levels_.Enabled())
+      pending_[key - range_.begin()] |= levels_.Bit(msg.meta.version);
 #ifdef USE_TIMER
     key_count_ += 1;
 #endif
@@ -141,6 +147,8 @@ void VectorSparseSSPRecorder::RemoveRecordAndGetNonConflictMsgs(int version, int
     DCHECK_GE(main_recorder_[version_after_mod][key_after_minus].first, 0);
     main_recorder_[version_after_mod][key_after_minus].first -= 1;
     if (main_recorder_[version_after_mod][key_after_minus].first == 0) {
+      if (levels_.Enabled())
+        pending_[key_after_minus] &= ~levels_.Bit(version);
       for (auto& msg : main_recorder_[version_after_mod][key_after_minus].second) {
         msgs_to_be_handled.push_back(std::move(msg));
       }
@@ -163,6 +171,13 @@ void VectorSparseSSPRecorder::RemoveRecordAndGetNonConflictMsgs(int version, int
   }
 }
 
+size_t VectorSparseSSPRecorder::GetNumParkedMsgs(int version) const {
+  size_t num_msgs = 0;
+  for (const auto& record : main_recorder_[version % main_recorder_version_level_size_])
+    num_msgs += record.second.size();
+  return num_msgs;
+}
+
 void VectorSparseSSPRecorder::RemoveRecord(const int version) { 
   // for (int i = 0; i < main_recorder_[version % main_recorder_version_level_size_].size(); ++ i) {
   //   CHECK_EQ(main_recorder_[version % main_recorder_version_level_size_][i].first, 0);
@@ -175,16 +190,33 @@ void VectorSparseSSPRecorder::RemoveRecord(const int version) {
  */
 bool VectorSparseSSPRecorder::HasConflict(const third_party::SArray<Key>& keys, const int begin_version,
                                           const int end_version, int* forwarded_key, int* forwarded_version) {
-  for (int check_version = end_version; check_version >= begin_version; check_version--) {
-    for (auto& key : keys) {
-      if (main_recorder_[check_version % main_recorder_version_level_size_][key - range_.begin()].first > 0) {
-        *forwarded_key = key;
-        *forwarded_version = check_version;
-        return true;
+  if (end_version < begin_version)
+    return false;
+  if (!levels_.Enabled()) {
+    for (int check_version = end_version; check_version >= begin_version; check_version--) {
+      for (auto& key : keys) {
+        if (main_recorder_[check_version % main_recorder_version_level_size_][key - range_.begin()].first > 0) {
+          *forwarded_key = key;
+          *forwarded_version = check_version;
+          return true;
+        }
       }
     }
+    return false;
+  }
+  // Forward to the latest conflicting version, the first key with it
+  uint64_t window = levels_.Window(begin_version, end_version);
+  *forwarded_version = -1;
+  for (auto& key : keys) {
+    int version = levels_.Latest(pending_[key - range_.begin()], window, begin_version);
+    if (version > *forwarded_version) {
+      *forwarded_key = key;
+      *forwarded_version = version;
+      if (version == end_version)
+        break;
+    }
   }
-  return false;
+  return *forwarded_version != -1;
 }
 
 } // namespace flexps
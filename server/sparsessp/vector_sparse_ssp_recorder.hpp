@@ -1,6 +1,7 @@
 #pragma once
 
 #include "server/sparsessp/abstract_sparse_ssp_recorder.hpp"
+#include "server/sparsessp/pending_levels.hpp"
 #include "glog/logging.h"
 
 #include <unordered_map>
@@ -20,6 +21,8 @@ public:
   virtual void HandleTooFastBuffer(int min_clock, std::vector<Message>* const msgs) override;
   virtual void RemoveRecord(int version) override;
   virtual void AddRecord(Message& msg) override;
+  // The number of Gets forwarded to wait for the pending Gets of version, for testing
+  size_t GetNumParkedMsgs(int version) const;
 
 private:
   void RemoveRecordAndGetNonConflictMsgs(int version, int min_clock, uint32_t tid,
@@ -37,6 +40,10 @@ private:
   uint32_t main_recorder_version_level_size_ = 0;
   third_party::Range range_;
 
+  // <key, mask of the versions with pending Gets>, see PendingLevels, empty if the levels are not enabled
+  PendingLevels levels_;
+  std::vector<uint64_t> pending_;
+
   // <thread_id, [<version, key>]>, has at most speculation_ + 1 queue size for each thread_id
   std::unordered_map<int, std::queue<std::pair<int, third_party::SArray<Key>>>> future_keys_;
 
@@ -1,38 +1,56 @@
 #include "server/ssp_model.hpp"
+#include "server/snapshot_reader.hpp"
 #include "glog/logging.h"
 
+#include <algorithm>
+#include <iterator>
+
 namespace flexps {
 
 SSPModel::SSPModel(uint32_t model_id, std::unique_ptr<AbstractStorage>&& storage_ptr, int staleness,
-                   ThreadsafeQueue<Message>* reply_queue)
-    : model_id_(model_id), staleness_(staleness), reply_queue_(reply_queue) {
+                   ThreadsafeQueue<Message>* reply_queue, ThreadPool* reader_pool)
+    : model_id_(model_id), staleness_(staleness), reply_queue_(reply_queue), reader_pool_(reader_pool) {
   this->storage_ = std::move(storage_ptr);
 }
 
 void SSPModel::Clock(Message& msg) {
   int updated_min_clock = progress_tracker_.AdvanceAndGetChangedMinClock(msg.meta.sender);
   if (updated_min_clock != -1) {  // min clock updated
+    storage_->FlushAdds();
     auto reqs_blocked_at_this_min_clock = buffer_.Pop(updated_min_clock);
     for (auto req : reqs_blocked_at_this_min_clock) {
+      req.meta.version = updated_min_clock;
       reply_queue_->Push(storage_->Get(req));
     }
     storage_->FinishIter();
+    if (num_hot_keys_ > 0)
+      PublishHotKeys(updated_min_clock);
   }
 }
 
 void SSPModel::Add(Message& msg) {
-  // The add will always never be blocked
-  storage_->Add(msg);
+  // The add will always never be blocked, and is merged with other Adds until the next Get or Clock
+  storage_->BufferAdd(msg);
 }
 
 void SSPModel::Get(Message& msg) {
+  if (msg.meta.flag == Flag::kGetReplica) {
+    ReplicaGet(msg);
+    return;
+  }
   CHECK(progress_tracker_.CheckThreadValid(msg.meta.sender));
-  int progress = progress_tracker_.GetProgress(msg.meta.sender);
+  if (num_hot_keys_ > 0)
+    access_counter_.Count(third_party::SArray<Key>(msg.data[0]));
+  // The Get carries the clock of the sender, which is ahead of the Clocks received when it holds some,
+  // see KVClientTable::EnableUpdateBuffer
+  int progress = std::max(progress_tracker_.GetProgress(msg.meta.sender), static_cast<int>(msg.meta.version));
   int min_clock = progress_tracker_.GetMinClock();
   if (progress > min_clock + staleness_) {
     buffer_.Push(progress - staleness_, msg);
   } else {
-    reply_queue_->Push(storage_->Get(msg));
+    // The reply is tagged with the min clock, the node caches of the workers rely on it
+    msg.meta.version = min_clock;
+    ReplyGet(storage_.get(), msg, reply_queue_, reader_pool_, true);
   }
 }
 
@@ -48,6 +66,11 @@ void SSPModel::ResetWorker(Message& msg) {
   for (auto tid : tids)
     tids_vec.push_back(tid);
   this->progress_tracker_.Init(tids_vec);
+  // The replica versions of the last task are not comparable with the clocks of this task
+  epoch_ += 1;
+  CHECK(pending_replica_gets_.empty());
+  if (num_hot_keys_ > 0 && !hot_keys_.empty())
+    PublishHotKeys(0);
   Message reply_msg;
   reply_msg.meta.model_id = model_id_;
   reply_msg.meta.recver = msg.meta.sender;
@@ -55,4 +78,97 @@ void SSPModel::ResetWorker(Message& msg) {
   reply_queue_->Push(reply_msg);
 }
 
+void SSPModel::EnableHotKeyReplication(uint32_t server_id, uint32_t num_hot_keys,
+                                       const std::vector<uint32_t>& replica_ids,
+                                       const std::vector<uint32_t>& helper_ids) {
+  server_id_ = server_id;
+  num_hot_keys_ = num_hot_keys;
+  replica_ids_ = replica_ids;
+  helper_ids_ = helper_ids;
+}
+
+void SSPModel::ReplicaSync(Message& msg) {
+  CHECK_EQ(msg.data.size(), 3);
+  int epoch = third_party::SArray<int>(msg.data[2])[0];
+  replicas_.Update(msg.meta.sender, third_party::SArray<Key>(msg.data[0]), msg.data[1], msg.meta.version, epoch);
+  std::vector<Message> pending;
+  pending.swap(pending_replica_gets_);
+  for (auto& req : pending) {
+    ReplicaGet(req);
+  }
+}
+
+void SSPModel::ReplicaGet(Message& msg) {
+  CHECK_EQ(msg.data.size(), 2);
+  CHECK(progress_tracker_.CheckThreadValid(msg.meta.sender));
+  uint32_t owner = third_party::SArray<uint32_t>(msg.data[1])[0];
+  int progress = std::max(progress_tracker_.GetProgress(msg.meta.sender), static_cast<int>(msg.meta.version));
+  // The same bound as the owner: the owner replies when its min clock >= progress - staleness
+  int version = replicas_.GetVersion(owner, epoch_);
+  if (version < progress - static_cast<int>(staleness_)) {
+    pending_replica_gets_.push_back(msg);
+    return;
+  }
+  third_party::SArray<Key> keys(msg.data[0]);
+  third_party::SArray<char> vals;
+  if (replicas_.Get(owner, keys, &vals)) {
+    Message reply;
+    reply.meta.sender = msg.meta.recver;
+    reply.meta.recver = msg.meta.sender;
+    reply.meta.model_id = msg.meta.model_id;
+    reply.meta.flag = Flag::kGetReply;
+    reply.meta.version = version;
+    reply.meta.req_id = msg.meta.req_id;
+    if (msg.meta.req_id == 0)
+      reply.AddData(keys);
+    reply.AddData(vals);
+    reply_queue_->Push(std::move(reply));
+  } else {
+    // The keys are not hot (yet) at the owner, which replies to the worker directly
+    Message forward;
+    forward.meta = msg.meta;
+    forward.meta.recver = owner;
+    forward.meta.flag = Flag::kGet;
+    forward.AddData(keys);
+    reply_queue_->Push(std::move(forward));
+  }
+}
+
+void SSPModel::PublishHotKeys(int version) {
+  if (version % kHotKeyRefreshClocks == 0 && hot_keys_.size() < num_hot_keys_) {
+    auto new_keys = access_counter_.PopHotKeys(num_hot_keys_ - hot_keys_.size(), kHotKeyFactor);
+    std::vector<Key> merged;
+    std::set_union(hot_keys_.begin(), hot_keys_.end(), new_keys.begin(), new_keys.end(), std::back_inserter(merged));
+    if (merged.size() > hot_keys_.size()) {
+      hot_keys_ = third_party::SArray<Key>(merged);
+      for (auto helper_id : helper_ids_) {
+        Message msg;
+        msg.meta.sender = server_id_;
+        msg.meta.recver = helper_id;
+        msg.meta.model_id = model_id_;
+        msg.meta.flag = Flag::kReplicaSync;
+        msg.meta.version = version;
+        msg.AddData(hot_keys_);
+        reply_queue_->Push(std::move(msg));
+      }
+    }
+  }
+  if (hot_keys_.empty())
+    return;
+  third_party::SArray<char> vals = storage_->SubGet(hot_keys_);
+  third_party::SArray<int> epoch({epoch_});
+  for (auto replica_id : replica_ids_) {
+    Message msg;
+    msg.meta.sender = server_id_;
+    msg.meta.recver = replica_id;
+    msg.meta.model_id = model_id_;
+    msg.meta.flag = Flag::kReplicaSync;
+    msg.meta.version = version;
+    msg.AddData(hot_keys_);
+    msg.AddData(vals);
+    msg.AddData(epoch);
+    reply_queue_->Push(std::move(msg));
+  }
+}
+
 }  // namespace flexps
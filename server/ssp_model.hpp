@@ -1,8 +1,13 @@
+#pragma once
+
 #include "server/abstract_model.hpp"
 
 #include "base/message.hpp"
+#include "base/thread_pool.hpp"
 #include "base/threadsafe_queue.hpp"
 #include "server/abstract_storage.hpp"
+#include "server/access_counter.hpp"
+#include "server/hot_key_replicas.hpp"
 #include "server/pending_buffer.hpp"
 #include "server/progress_tracker.hpp"
 
@@ -14,24 +19,64 @@ namespace flexps {
 class SSPModel : public AbstractModel {
  public:
   explicit SSPModel(uint32_t model_id, std::unique_ptr<AbstractStorage>&& storage_ptr, int staleness,
-                    ThreadsafeQueue<Message>* reply_queue);
+                    ThreadsafeQueue<Message>* reply_queue, ThreadPool* reader_pool = nullptr);
 
   virtual void Clock(Message& msg) override;
   virtual void Add(Message& msg) override;
   virtual void Get(Message& msg) override;
   virtual int GetProgress(int tid) override;
+  virtual int GetMinClock() override { return progress_tracker_.GetMinClock(); }
   virtual void ResetWorker(Message& msg) override;
+  virtual void ReplicaSync(Message& msg) override;
+  virtual AbstractStorage* GetStorage() override { return storage_.get(); }
+
+  /*
+   * Replicate the hot keys of this server thread to the other server threads of the table.
+   *
+   * The hottest (at most num_hot_keys) keys are detected from the Gets served by this server thread.
+   * A key stays hot once detected. At every min clock change the values of the hot keys are sent
+   * to replica_ids, and the hot keys are announced to the worker helper threads (helper_ids) when
+   * they change, so that the workers route the Gets of hot keys to a local replica (kGetReplica).
+   * A replica serves such a Get under the same staleness bound as the owner, or forwards it to the owner.
+   * Adds of the hot keys still go to the owner.
+   */
+  void EnableHotKeyReplication(uint32_t server_id, uint32_t num_hot_keys, const std::vector<uint32_t>& replica_ids,
+                               const std::vector<uint32_t>& helper_ids);
 
   int GetPendingSize(int progress);
+  const third_party::SArray<Key>& GetHotKeys() const { return hot_keys_; }
+
+  // Refresh the hot keys every kHotKeyRefreshClocks clocks
+  static const int kHotKeyRefreshClocks = 4;
+  // A key is hot if it is accessed kHotKeyFactor times as often as the average key
+  static constexpr double kHotKeyFactor = 8.0;
+  // Count the keys of one in kAccessSampleEvery Gets
+  static const uint32_t kAccessSampleEvery = 4;
 
  private:
+  void ReplicaGet(Message& msg);
+  void PublishHotKeys(int version);
+
   uint32_t model_id_;
   uint32_t staleness_;
 
   ThreadsafeQueue<Message>* reply_queue_;
+  // Serves the Gets from the storage snapshot if set and the storage supports it. Not owned.
+  ThreadPool* reader_pool_;
   std::unique_ptr<AbstractStorage> storage_;
   ProgressTracker progress_tracker_;
   PendingBuffer buffer_;
+
+  // Hot key replication
+  uint32_t server_id_;
+  uint32_t num_hot_keys_ = 0;
+  std::vector<uint32_t> replica_ids_;
+  std::vector<uint32_t> helper_ids_;
+  AccessCounter access_counter_{kAccessSampleEvery};
+  third_party::SArray<Key> hot_keys_;  // in ascending order
+  HotKeyReplicas replicas_;
+  int epoch_ = 0;  // the number of ResetWorker
+  std::vector<Message> pending_replica_gets_;
 };
 
 }  // namespace flexps
@@ -4,6 +4,7 @@
 #include "base/threadsafe_queue.hpp"
 #include "server/ssp_model.hpp"
 #include "server/map_storage.hpp"
+#include "server/vector_storage.hpp"
 
 namespace flexps {
 namespace {
@@ -181,6 +182,8 @@ TEST_F(TestSSPModel, CheckStaleness) {
   m1.AddData(m1_keys);
   model.get()->Get(m1);
   reply_queue.WaitAndPop(&m1);
+  // The replies are tagged with the min clock
+  EXPECT_EQ(m1.meta.version, 0);
 
   // Message2
   Message m2;
@@ -247,6 +250,187 @@ TEST_F(TestSSPModel, CheckStaleness) {
   m7.AddData(m7_keys);
   model.get()->Get(m7);
   EXPECT_EQ(dynamic_cast<SSPModel*>(model.get())->GetPendingSize(1), 0);
+  ASSERT_EQ(reply_queue.Size(), 2);
+  reply_queue.WaitAndPop(&m);
+  EXPECT_EQ(m.meta.version, 1);
+  reply_queue.WaitAndPop(&m7);
+  EXPECT_EQ(m7.meta.version, 1);
+}
+
+TEST_F(TestSSPModel, SnapshotReader) {
+  ThreadsafeQueue<Message> reply_queue;
+  ThreadPool reader_pool(2);
+  int staleness = 0;
+  int model_id = 0;
+  std::unique_ptr<AbstractStorage> storage(new VectorStorage<int>({0, 10}, 1, nullptr, true));
+  std::unique_ptr<AbstractModel> model(
+      new SSPModel(model_id, std::move(storage), staleness, &reply_queue, &reader_pool));
+  Message reset_msg;
+  third_party::SArray<uint32_t> tids({2, 3});
+  reset_msg.AddData(tids);
+  model->ResetWorker(reset_msg);
+  Message reset_reply_msg;
+  reply_queue.WaitAndPop(&reset_reply_msg);
+
+  Message check_msg;
+  Message msg = CreateMessage(Flag::kAdd, 0, 2, 0, 0, {0}, {1});
+  model->Add(msg);
+  // Served from the snapshot of clock 0, which does not have the Add
+  msg = CreateMessage(Flag::kGet, 0, 2, 0, 0, {0});
+  model->Get(msg);
+  reply_queue.WaitAndPop(&check_msg);
+  EXPECT_EQ(check_msg.meta.flag, Flag::kGetReply);
+  EXPECT_EQ(check_msg.meta.recver, 2);
+  EXPECT_EQ(third_party::SArray<int>(check_msg.data[1])[0], 0);
+
+  msg = CreateMessage(Flag::kClock, 0, 2, 0, 0);
+  model->Clock(msg);
+  msg = CreateMessage(Flag::kClock, 0, 3, 0, 0);
+  model->Clock(msg);
+  msg = CreateMessage(Flag::kGet, 0, 3, 0, 1, {0});
+  model->Get(msg);
+  reply_queue.WaitAndPop(&check_msg);
+  EXPECT_EQ(check_msg.meta.recver, 3);
+  EXPECT_EQ(third_party::SArray<int>(check_msg.data[1])[0], 1);
+}
+
+TEST_F(TestSSPModel, GetWithHeldClocks) {
+  ThreadsafeQueue<Message> reply_queue;
+  int staleness = 1;
+  int model_id = 0;
+  std::unique_ptr<AbstractStorage> storage(new MapStorage<int>());
+  std::unique_ptr<AbstractModel> model(new SSPModel(model_id, std::move(storage), staleness, &reply_queue));
+  Message reset_msg;
+  third_party::SArray<uint32_t> tids({2, 3});
+  reset_msg.AddData(tids);
+  model->ResetWorker(reset_msg);
+  Message reset_reply_msg;
+  reply_queue.WaitAndPop(&reset_reply_msg);
+
+  // Thread 2 is at clock 2 but holds its Clocks, so its Get waits for clock 1 all the same
+  Message msg = CreateMessage(Flag::kGet, 0, 2, 0, 2, {0});
+  model->Get(msg);
+  EXPECT_EQ(reply_queue.Size(), 0);
+  EXPECT_EQ(dynamic_cast<SSPModel*>(model.get())->GetPendingSize(1), 1);
+  for (int tid : {2, 3}) {
+    msg = CreateMessage(Flag::kClock, 0, tid, 0, 0);
+    model->Clock(msg);
+  }
+  ASSERT_EQ(reply_queue.Size(), 1);
+  Message check_msg;
+  reply_queue.WaitAndPop(&check_msg);
+  EXPECT_EQ(check_msg.meta.recver, 2);
+  EXPECT_EQ(check_msg.meta.version, 1);
+}
+
+// Pop the messages with flag from the queue, the others are dropped
+std::vector<Message> PopWithFlag(ThreadsafeQueue<Message>* queue, Flag flag) {
+  std::vector<Message> msgs;
+  while (queue->Size() > 0) {
+    Message msg;
+    queue->WaitAndPop(&msg);
+    if (msg.meta.flag == flag)
+      msgs.push_back(msg);
+  }
+  return msgs;
+}
+
+TEST_F(TestSSPModel, HotKeyReplication) {
+  ThreadsafeQueue<Message> owner_queue, replica_queue;
+  int staleness = 0;
+  int model_id = 0;
+  const uint32_t kOwner = 0, kReplica = 1, kHelper = 20;
+  std::unique_ptr<AbstractStorage> owner_storage(new MapStorage<int>());
+  std::unique_ptr<SSPModel> owner(new SSPModel(model_id, std::move(owner_storage), staleness, &owner_queue));
+  owner->EnableHotKeyReplication(kOwner, 1, {kReplica}, {kHelper});
+  std::unique_ptr<AbstractStorage> replica_storage(new MapStorage<int>());
+  std::unique_ptr<SSPModel> replica(new SSPModel(model_id, std::move(replica_storage), staleness, &replica_queue));
+  replica->EnableHotKeyReplication(kReplica, 1, {kOwner}, {kHelper});
+
+  Message reset_msg;
+  reset_msg.AddData(third_party::SArray<uint32_t>({2, 3}));
+  owner->ResetWorker(reset_msg);
+  replica->ResetWorker(reset_msg);
+  PopWithFlag(&replica_queue, Flag::kOther);
+
+  // 40 cold keys once, key 5 many times
+  Message msg = CreateMessage(Flag::kGet, 0, 2, kOwner, 0);
+  third_party::SArray<Key> cold;
+  for (Key key = 0; key < 40; ++key)
+    cold.push_back(key);
+  msg.AddData(cold);
+  for (int i = 0; i < 4; ++i)
+    owner->Get(msg);
+  for (int i = 0; i < 40; ++i) {
+    msg = CreateMessage(Flag::kGet, 0, 2, kOwner, 0, {5});
+    owner->Get(msg);
+  }
+  msg = CreateMessage(Flag::kAdd, 0, 2, kOwner, 0, {5}, {3});
+  owner->Add(msg);
+  PopWithFlag(&owner_queue, Flag::kOther);
+
+  // The hot keys are refreshed at min clock 4
+  for (int clock = 0; clock < 4; ++clock) {
+    for (int tid : {2, 3}) {
+      msg = CreateMessage(Flag::kClock, 0, tid, kOwner, 0);
+      owner->Clock(msg);
+      msg = CreateMessage(Flag::kClock, 0, tid, kReplica, 0);
+      replica->Clock(msg);
+    }
+  }
+  ASSERT_EQ(owner->GetHotKeys().size(), 1);
+  EXPECT_EQ(owner->GetHotKeys()[0], 5);
+  std::vector<Message> syncs = PopWithFlag(&owner_queue, Flag::kReplicaSync);
+  ASSERT_EQ(syncs.size(), 2);
+  EXPECT_EQ(syncs[0].meta.recver, kHelper);  // announce the hot keys
+  ASSERT_EQ(syncs[0].data.size(), 1);
+  EXPECT_EQ(syncs[1].meta.recver, kReplica);
+  EXPECT_EQ(syncs[1].meta.version, 4);
+  replica->ReplicaSync(syncs[1]);
+
+  // Served by the replica
+  msg = CreateMessage(Flag::kGetReplica, 0, 2, kReplica, 0, {5});
+  msg.AddData(third_party::SArray<uint32_t>({kOwner}));
+  replica->Get(msg);
+  Message reply;
+  ASSERT_EQ(replica_queue.Size(), 1);
+  replica_queue.WaitAndPop(&reply);
+  EXPECT_EQ(reply.meta.flag, Flag::kGetReply);
+  EXPECT_EQ(reply.meta.sender, kReplica);
+  EXPECT_EQ(reply.meta.recver, 2);
+  EXPECT_EQ(third_party::SArray<int>(reply.data[1])[0], 3);
+
+  // Blocked until the replica of clock 5 arrives
+  for (int tid : {2, 3}) {
+    msg = CreateMessage(Flag::kClock, 0, tid, kReplica, 0);
+    replica->Clock(msg);
+  }
+  msg = CreateMessage(Flag::kGetReplica, 0, 3, kReplica, 0, {5});
+  msg.AddData(third_party::SArray<uint32_t>({kOwner}));
+  replica->Get(msg);
+  EXPECT_EQ(replica_queue.Size(), 0);
+  for (int tid : {2, 3}) {
+    msg = CreateMessage(Flag::kClock, 0, tid, kOwner, 0);
+    owner->Clock(msg);
+  }
+  syncs = PopWithFlag(&owner_queue, Flag::kReplicaSync);
+  ASSERT_EQ(syncs.size(), 1);
+  EXPECT_EQ(syncs[0].meta.version, 5);
+  replica->ReplicaSync(syncs[0]);
+  ASSERT_EQ(replica_queue.Size(), 1);
+  replica_queue.WaitAndPop(&reply);
+  EXPECT_EQ(reply.meta.recver, 3);
+
+  // Not a hot key, forwarded to the owner
+  msg = CreateMessage(Flag::kGetReplica, 0, 3, kReplica, 0, {6});
+  msg.AddData(third_party::SArray<uint32_t>({kOwner}));
+  replica->Get(msg);
+  ASSERT_EQ(replica_queue.Size(), 1);
+  replica_queue.WaitAndPop(&reply);
+  EXPECT_EQ(reply.meta.flag, Flag::kGet);
+  EXPECT_EQ(reply.meta.sender, 3);
+  EXPECT_EQ(reply.meta.recver, kOwner);
+  ASSERT_EQ(reply.data.size(), 1);
 }
 
 }  // namespace
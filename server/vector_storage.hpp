@@ -3,9 +3,13 @@
 #include "base/message.hpp"
 #include "base/third_party/range.h"
 #include "server/abstract_storage.hpp"
+#include "server/initializer.hpp"
 
 #include "glog/logging.h"
 
+#include <algorithm>
+#include <functional>
+#include <memory>
 #include <vector>
 
 namespace flexps {
@@ -16,19 +20,39 @@ class VectorStorage : public AbstractStorage {
   VectorStorage() = delete;
   /*
    * The storage is in charge of range [range.begin(), range.end()).
+   * The storage is dense, so the initializer is applied to the whole range at construction.
+   * If enable_snapshot, Gets can also be served from the snapshot published in FinishIter().
    */
-  VectorStorage(third_party::Range range, uint32_t chunk_size = 1) : range_(range), storage_(range.size(), Val()), chunk_size_(chunk_size) {
+  VectorStorage(third_party::Range range, uint32_t chunk_size = 1, const Initializer<Val>& initializer = nullptr,
+                bool enable_snapshot = false)
+      : range_(range), storage_(range.size(), Val()), chunk_size_(chunk_size), initializer_(initializer),
+        enable_snapshot_(enable_snapshot) {
     CHECK_LE(range_.begin(), range_.end());
+    if (initializer_) {
+      for (size_t i = 0; i < storage_.size(); i++)
+        storage_[i] = initializer_(range_.begin() + i);
+    }
+    if (enable_snapshot_)
+      CommitSnapshot();
   }
 
   virtual void SubAdd(const third_party::SArray<Key>& typed_keys, 
       const third_party::SArray<char>& vals) override {
     auto typed_vals = third_party::SArray<Val>(vals);
-    for (size_t index = 0; index < typed_keys.size(); index++) { 
-      CHECK_GE(typed_keys[index], range_.begin());                                                                                                                                                    
-      CHECK_LT(typed_keys[index], range_.end());  
-      storage_[typed_keys[index] - range_.begin()] += typed_vals[index];  
+    if (enable_snapshot_) {
+      for (auto key : typed_keys) {
+        CHECK_GE(key, range_.begin());
+        CHECK_LT(key, range_.end());
+        MarkDirty(key - range_.begin());
+      }
     }
+    ForEachSubRange(typed_keys.size(), typed_keys.data(), [&](size_t begin, size_t end) {
+      for (size_t index = begin; index < end; index++) {
+        CHECK_GE(typed_keys[index], range_.begin());
+        CHECK_LT(typed_keys[index], range_.end());
+        storage_[typed_keys[index] - range_.begin()] += typed_vals[index];
+      }
+    });
   }
 
   virtual void SubAddChunk(const third_party::SArray<Key>& typed_keys, 
@@ -38,19 +62,77 @@ class VectorStorage : public AbstractStorage {
     for (size_t index = 0; index < typed_keys.size(); index++) {
       CHECK_GE(typed_keys[index] * chunk_size_, range_.begin());
       CHECK_LT(typed_keys[index] * chunk_size_, range_.end());
-      for (size_t chunk_index = 0; chunk_index < chunk_size_; chunk_index++)
+      for (size_t chunk_index = 0; chunk_index < chunk_size_; chunk_index++) {
+        if (enable_snapshot_)
+          MarkDirty(typed_keys[index] * chunk_size_ - range_.begin() + chunk_index);
         storage_[typed_keys[index] * chunk_size_ - range_.begin() + chunk_index] += typed_vals[index * chunk_size_ + chunk_index];
+      }
+    }
+  }
+
+  virtual void SubBufferAdd(const third_party::SArray<Key>& typed_keys,
+      const third_party::SArray<char>& vals) override {
+    if (typed_keys.empty())
+      return;
+    auto typed_vals = third_party::SArray<Val>(vals);
+    // Allocate the blocks and record the touched keys first, so that the sub-ranges only write the values
+    std::vector<Val*> slots(typed_keys.size());
+    for (size_t index = 0; index < typed_keys.size(); index++) {
+      CHECK_GE(typed_keys[index], range_.begin());
+      CHECK_LT(typed_keys[index], range_.end());
+      slots[index] = &DeltaAt(typed_keys[index] - range_.begin());
+    }
+    ForEachSubRange(typed_keys.size(), typed_keys.data(), [&](size_t begin, size_t end) {
+      for (size_t index = begin; index < end; index++)
+        *slots[index] += typed_vals[index];
+    });
+  }
+
+  virtual void SubBufferAddChunk(const third_party::SArray<Key>& typed_keys,
+      const third_party::SArray<char>& vals) override {
+    auto typed_vals = third_party::SArray<Val>(vals);
+    CHECK_EQ(typed_vals.size()/typed_keys.size(), chunk_size_);
+    for (size_t index = 0; index < typed_keys.size(); index++) {
+      CHECK_GE(typed_keys[index] * chunk_size_, range_.begin());
+      CHECK_LT(typed_keys[index] * chunk_size_, range_.end());
+      for (size_t chunk_index = 0; chunk_index < chunk_size_; chunk_index++)
+        DeltaAt(typed_keys[index] * chunk_size_ - range_.begin() + chunk_index) += typed_vals[index * chunk_size_ + chunk_index];
     }
   }
 
+  // Only the touched keys are applied, the blocks of the delta are then released
+  virtual void FlushAdds() override {
+    if (touched_.empty())
+      return;
+    ForEachSubRange(touched_.size(), nullptr, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        const size_t offset = touched_[i];
+        DeltaBlock& block = *delta_blocks_[offset / kDeltaBlockSize];
+        storage_[offset] += block.vals[offset % kDeltaBlockSize];
+        block.vals[offset % kDeltaBlockSize] = Val();
+        block.touched[offset % kDeltaBlockSize] = 0;
+      }
+    });
+    touched_.clear();
+    for (size_t block_index : allocated_blocks_) {
+      if (enable_snapshot_)
+        MarkDirty(block_index * kDeltaBlockSize);
+      if (spare_blocks_.size() < kMaxSpareBlocks)
+        spare_blocks_.push_back(std::move(delta_blocks_[block_index]));
+      delta_blocks_[block_index].reset();
+    }
+    allocated_blocks_.clear();
+  }
 
   virtual third_party::SArray<char> SubGet(const third_party::SArray<Key>& typed_keys) override {
     third_party::SArray<Val> reply_vals(typed_keys.size());
-    for (size_t i = 0; i < typed_keys.size(); i++) {                                                                                                                                      
-      CHECK_GE(typed_keys[i], range_.begin());                                                                                                                                                    
-      CHECK_LT(typed_keys[i], range_.end());
-      reply_vals[i] = storage_[typed_keys[i] - range_.begin()];
-    }  
+    ForEachSubRange(typed_keys.size(), nullptr, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        CHECK_GE(typed_keys[i], range_.begin());
+        CHECK_LT(typed_keys[i], range_.end());
+        reply_vals[i] = storage_[typed_keys[i] - range_.begin()];
+      }
+    });
     return third_party::SArray<char>(reply_vals);
   }
 
@@ -65,8 +147,113 @@ class VectorStorage : public AbstractStorage {
     return third_party::SArray<char>(reply_vals);
   }
 
+  virtual void LoadRange(const third_party::Range& range, const third_party::SArray<char>& vals) override {
+    auto typed_vals = third_party::SArray<Val>(vals);
+    CHECK_EQ(typed_vals.size(), range.size());
+    CHECK_GE(range.begin(), range_.begin());
+    CHECK_LE(range.end(), range_.end());
+    if (range.size() > 0)
+      memcpy(storage_.data() + (range.begin() - range_.begin()), typed_vals.data(), range.size() * sizeof(Val));
+    if (enable_snapshot_) {
+      for (uint64_t offset = range.begin() - range_.begin(); offset < range.end() - range_.begin();
+           offset += kDeltaBlockSize)
+        MarkDirty(offset);
+      if (range.size() > 0)
+        MarkDirty(range.end() - 1 - range_.begin());
+      CommitSnapshot();
+    }
+  }
+
+  virtual void ExportRange(const third_party::Range& range, third_party::SArray<Key>* keys,
+                           third_party::SArray<char>* vals) override {
+    CHECK(touched_.empty());
+    const uint64_t begin = std::max(range.begin(), range_.begin());
+    const uint64_t end = std::max(begin, std::min(range.end(), range_.end()));
+    third_party::SArray<Key> typed_keys(end - begin);
+    for (size_t i = 0; i < typed_keys.size(); i++)
+      typed_keys[i] = begin + i;
+    third_party::SArray<Val> typed_vals(end - begin);
+    if (end > begin)
+      memcpy(typed_vals.data(), storage_.data() + (begin - range_.begin()), (end - begin) * sizeof(Val));
+    *keys = typed_keys;
+    *vals = third_party::SArray<char>(typed_vals);
+  }
+
+  // The keys newly in charge start from the initializer value
+  virtual void ResetRange(const third_party::Range& range) override {
+    CHECK(touched_.empty());
+    CHECK_LE(range.begin(), range.end());
+    std::vector<Val> storage(range.size(), Val());
+    for (size_t i = 0; i < storage.size(); i++) {
+      Key key = range.begin() + i;
+      if (key >= range_.begin() && key < range_.end())
+        storage[i] = storage_[key - range_.begin()];
+      else if (initializer_)
+        storage[i] = initializer_(key);
+    }
+    storage_.swap(storage);
+    range_ = range;
+    delta_blocks_.clear();
+    if (enable_snapshot_)
+      CommitSnapshot(true);
+  }
+
+  virtual void ImportKeys(const third_party::SArray<Key>& keys, const third_party::SArray<char>& vals) override {
+    auto typed_vals = third_party::SArray<Val>(vals);
+    CHECK_EQ(keys.size(), typed_vals.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      CHECK_GE(keys[i], range_.begin());
+      CHECK_LT(keys[i], range_.end());
+      storage_[keys[i] - range_.begin()] = typed_vals[i];
+      if (enable_snapshot_)
+        MarkDirty(keys[i] - range_.begin());
+    }
+    if (enable_snapshot_)
+      CommitSnapshot();
+  }
+
+  /*
+   * Split the Adds, Gets and flushes of at least 2 * min_keys_per_task keys into sub-ranges applied in
+   * parallel by the executor threads and the calling thread. The sub-ranges write disjoint elements:
+   * the keys of a request are sorted as sliced by range, and equal keys are kept in one sub-range.
+   * The snapshot reads and the chunk APIs stay sequential.
+   */
+  virtual void SetExecutor(ThreadPool* executor) override { executor_ = executor; }
+  void SetMinKeysPerTask(size_t min_keys_per_task) {
+    CHECK_GT(min_keys_per_task, 0);
+    min_keys_per_task_ = min_keys_per_task;
+  }
 
-  virtual void FinishIter() override {}
+  virtual bool SupportSnapshot() const override { return enable_snapshot_; }
+
+  virtual third_party::SArray<char> SubGetSnapshot(const third_party::SArray<Key>& typed_keys) override {
+    // Holding the reference keeps the snapshot alive even if a newer one is published meanwhile
+    std::shared_ptr<Snapshot> snapshot = std::atomic_load(&snapshot_);
+    third_party::SArray<Val> reply_vals(typed_keys.size());
+    for (size_t i = 0; i < typed_keys.size(); i++) {
+      CHECK_GE(typed_keys[i], range_.begin());
+      CHECK_LT(typed_keys[i], range_.end());
+      reply_vals[i] = snapshot->At(typed_keys[i] - range_.begin());
+    }
+    return third_party::SArray<char>(reply_vals);
+  }
+
+  virtual third_party::SArray<char> SubGetChunkSnapshot(const third_party::SArray<Key>& typed_keys) override {
+    std::shared_ptr<Snapshot> snapshot = std::atomic_load(&snapshot_);
+    third_party::SArray<Val> reply_vals(typed_keys.size() * chunk_size_);
+    for (int i = 0; i < typed_keys.size(); ++ i) {
+      CHECK_GE(typed_keys[i] * chunk_size_, range_.begin());
+      CHECK_LT(typed_keys[i] * chunk_size_, range_.end());
+      for (int j = 0; j < chunk_size_; ++ j)
+        reply_vals[i * chunk_size_ + j] = snapshot->At(typed_keys[i] * chunk_size_ - range_.begin() + j);
+    }
+    return third_party::SArray<char>(reply_vals);
+  }
+
+  virtual void FinishIter() override {
+    if (enable_snapshot_)
+      CommitSnapshot();
+  }
 
   int GetBegin() {
     return range_.begin();
@@ -80,10 +267,173 @@ class VectorStorage : public AbstractStorage {
     CHECK_EQ(range_.size(), storage_.size());
     return storage_.size();
   }
+
+  // The blocks of the delta allocated since the last flush
+  size_t GetNumDeltaBlocks() const { return allocated_blocks_.size(); }
+  // The blocks copied by the last snapshot commit
+  size_t GetNumCopiedSnapshotBlocks() const { return num_copied_snapshot_blocks_; }
  private:
+  // The snapshot of storage_ in blocks of kDeltaBlockSize elements, a block unchanged since the previous
+  // snapshot is shared with it
+  struct Snapshot {
+    std::vector<std::shared_ptr<std::vector<Val>>> blocks;
+    const Val& At(size_t offset) const { return (*blocks[offset / kDeltaBlockSize])[offset % kDeltaBlockSize]; }
+  };
+
+  // Record that the block of the element at offset of storage_ changed since the last snapshot
+  void MarkDirty(size_t offset) {
+    const size_t block_index = offset / kDeltaBlockSize;
+    if (!snapshot_dirty_[block_index]) {
+      snapshot_dirty_[block_index] = 1;
+      dirty_snapshot_blocks_.push_back(block_index);
+    }
+  }
+
+  /*
+   * Publish the current version as the snapshot, copying only the blocks changed since the previous one.
+   * The blocks are double buffered: a changed block is copied into the buffer of the snapshot before the
+   * previous one if no reader holds that snapshot and it does not share the buffer, otherwise a new
+   * buffer is allocated. ResetRange() commits all the blocks.
+   */
+  void CommitSnapshot(bool all_blocks = false) {
+    const size_t num_blocks = (storage_.size() + kDeltaBlockSize - 1) / kDeltaBlockSize;
+    std::shared_ptr<Snapshot> prev = std::atomic_load(&snapshot_);
+    if (!prev || prev->blocks.size() != num_blocks)
+      all_blocks = true;
+    std::shared_ptr<Snapshot> next;
+    // Reuse the spare if it is unpublished, so no reader can get it again, and not resized by ResetRange()
+    if (!all_blocks && spare_ && spare_.use_count() == 1 && spare_->blocks.size() == num_blocks) {
+      next = std::move(spare_);
+      for (size_t block_index : dirty_snapshot_blocks_) {
+        std::shared_ptr<std::vector<Val>>& block = next->blocks[block_index];
+        if (block.use_count() != 1)
+          block.reset();
+      }
+      // The other blocks are shared with prev
+      for (size_t b = 0; b < num_blocks; ++b) {
+        if (!snapshot_dirty_[b])
+          next->blocks[b] = prev->blocks[b];
+      }
+    } else {
+      next = std::make_shared<Snapshot>();
+      next->blocks.resize(num_blocks);
+      if (!all_blocks) {
+        for (size_t b = 0; b < num_blocks; ++b) {
+          if (!snapshot_dirty_[b])
+            next->blocks[b] = prev->blocks[b];
+        }
+      }
+    }
+    num_copied_snapshot_blocks_ = 0;
+    auto copy_block = [&](size_t b) {
+      const size_t begin = b * kDeltaBlockSize;
+      const size_t end = std::min(storage_.size(), begin + kDeltaBlockSize);
+      std::shared_ptr<std::vector<Val>>& block = next->blocks[b];
+      // A buffer of the spare may have another size after ResetRange()
+      if (block && block->size() == end - begin)
+        std::copy(storage_.begin() + begin, storage_.begin() + end, block->begin());
+      else
+        block = std::make_shared<std::vector<Val>>(storage_.begin() + begin, storage_.begin() + end);
+      num_copied_snapshot_blocks_ += 1;
+    };
+    if (all_blocks) {
+      for (size_t b = 0; b < num_blocks; ++b)
+        copy_block(b);
+    } else {
+      for (size_t b : dirty_snapshot_blocks_)
+        copy_block(b);
+    }
+    dirty_snapshot_blocks_.clear();
+    snapshot_dirty_.assign(num_blocks, 0);
+    spare_ = std::move(prev);
+    std::atomic_store(&snapshot_, next);
+  }
+
+  /*
+   * The delta of the element at offset of storage_. The delta is split into blocks allocated on the first
+   * BufferAdd() to them, and the offsets touched since the last flush are recorded in touched_.
+   */
+  Val& DeltaAt(size_t offset) {
+    if (delta_blocks_.empty())
+      delta_blocks_.resize((storage_.size() + kDeltaBlockSize - 1) / kDeltaBlockSize);
+    const size_t block_index = offset / kDeltaBlockSize;
+    std::unique_ptr<DeltaBlock>& block = delta_blocks_[block_index];
+    if (!block) {
+      if (spare_blocks_.empty()) {
+        block.reset(new DeltaBlock());
+      } else {
+        block = std::move(spare_blocks_.back());
+        spare_blocks_.pop_back();
+      }
+      allocated_blocks_.push_back(block_index);
+    }
+    const size_t i = offset % kDeltaBlockSize;
+    if (!block->touched[i]) {
+      block->touched[i] = 1;
+      touched_.push_back(offset);
+    }
+    return block->vals[i];
+  }
+
+  /*
+   * Run f(begin, end) over sub-ranges covering [0, n), in parallel on the executor if n is large enough.
+   * If keys is given, a boundary never separates equal keys.
+   */
+  void ForEachSubRange(size_t n, const Key* keys, const std::function<void(size_t, size_t)>& f) {
+    size_t num_tasks = 1;
+    if (executor_)
+      num_tasks = std::min(n / min_keys_per_task_, kTasksPerThread * (executor_->GetNumThreads() + 1));
+    if (num_tasks <= 1) {
+      f(0, n);
+      return;
+    }
+    std::vector<size_t> bounds(num_tasks + 1, n);
+    bounds[0] = 0;
+    for (size_t t = 1; t < num_tasks; ++t) {
+      bounds[t] = std::max(bounds[t - 1], n * t / num_tasks);
+      while (keys && bounds[t] > 0 && bounds[t] < n && keys[bounds[t]] == keys[bounds[t] - 1])
+        bounds[t] += 1;
+    }
+    executor_->ParallelFor(num_tasks, [&bounds, &f](size_t t) {
+      if (bounds[t] < bounds[t + 1])
+        f(bounds[t], bounds[t + 1]);
+    });
+  }
+
+  // More tasks than threads, so that the threads finishing early balance the load
+  static const size_t kTasksPerThread = 4;
+  ThreadPool* executor_ = nullptr;  // not owned
+  size_t min_keys_per_task_ = 16384;
+
   third_party::Range range_;
   std::vector<Val> storage_;
   uint32_t chunk_size_;
+  // Kept to initialize the keys newly in charge after ResetRange()
+  Initializer<Val> initializer_;
+  // The Adds merged by BufferAdd(), in blocks of kDeltaBlockSize elements of storage_
+  struct DeltaBlock {
+    DeltaBlock() : vals(kDeltaBlockSize, Val()), touched(kDeltaBlockSize, 0) {}
+    std::vector<Val> vals;
+    std::vector<uint8_t> touched;
+  };
+  static const size_t kDeltaBlockSize = 4096;
+  // The released blocks kept for reuse, at most kMaxSpareBlocks
+  static const size_t kMaxSpareBlocks = 16;
+  std::vector<std::unique_ptr<DeltaBlock>> delta_blocks_;
+  std::vector<size_t> allocated_blocks_;
+  std::vector<std::unique_ptr<DeltaBlock>> spare_blocks_;
+  // The offsets with a delta since the last flush
+  std::vector<size_t> touched_;
+
+  bool enable_snapshot_;
+  // The last published snapshot, accessed with std::atomic_load/std::atomic_store as readers run concurrently
+  std::shared_ptr<Snapshot> snapshot_;
+  // The snapshot before snapshot_, its blocks are reused
+  std::shared_ptr<Snapshot> spare_;
+  // The blocks changed since snapshot_, as a flag per block and a list
+  std::vector<uint8_t> snapshot_dirty_;
+  std::vector<size_t> dirty_snapshot_blocks_;
+  size_t num_copied_snapshot_blocks_ = 0;
 };
 
 }  // namespace flexps
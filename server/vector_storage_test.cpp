@@ -104,6 +104,214 @@ TEST_F(TestVectorStorage, SubAddChunkSubGetChunk) {
 }
 
 
+TEST_F(TestVectorStorage, BufferAddAndFlush) {
+  VectorStorage<int> s({10, 20});
+
+  third_party::SArray<Key> s_keys({13, 14, 15});
+  s.SubBufferAdd(s_keys, third_party::SArray<char>(third_party::SArray<int>({1, 2, 3})));
+  s.SubBufferAdd(third_party::SArray<Key>({14}), third_party::SArray<char>(third_party::SArray<int>({20})));
+  third_party::SArray<int> ret = third_party::SArray<int>(s.SubGet(s_keys));
+  EXPECT_EQ(ret[1], 0);
+
+  s.FlushAdds();
+  ret = third_party::SArray<int>(s.SubGet(s_keys));
+  EXPECT_EQ(ret[0], 1);
+  EXPECT_EQ(ret[1], 22);
+  EXPECT_EQ(ret[2], 3);
+
+  // The delta is cleared after flush
+  s.SubBufferAdd(third_party::SArray<Key>({19}), third_party::SArray<char>(third_party::SArray<int>({5})));
+  s.FlushAdds();
+  ret = third_party::SArray<int>(s.SubGet(third_party::SArray<Key>({13, 14, 19})));
+  EXPECT_EQ(ret[0], 1);
+  EXPECT_EQ(ret[1], 22);
+  EXPECT_EQ(ret[2], 5);
+}
+
+TEST_F(TestVectorStorage, BufferAddSparse) {
+  // Adds at both ends of a large range only allocate and flush the blocks of the keys touched
+  const Key end = 1 << 20;
+  VectorStorage<int> s({0, end});
+  third_party::SArray<Key> s_keys({Key(1), end - 1});
+  for (int round = 1; round <= 2; ++round) {
+    s.SubBufferAdd(s_keys, third_party::SArray<char>(third_party::SArray<int>({1, 2})));
+    s.SubBufferAdd(third_party::SArray<Key>({end - 1}), third_party::SArray<char>(third_party::SArray<int>({3})));
+    EXPECT_EQ(s.GetNumDeltaBlocks(), 2);
+    s.FlushAdds();
+    EXPECT_EQ(s.GetNumDeltaBlocks(), 0);
+    third_party::SArray<int> ret = third_party::SArray<int>(s.SubGet(third_party::SArray<Key>({Key(0), Key(1), end - 1})));
+    EXPECT_EQ(ret[0], 0);
+    EXPECT_EQ(ret[1], round);
+    EXPECT_EQ(ret[2], 5 * round);
+  }
+}
+
+TEST_F(TestVectorStorage, BufferAddChunk) {
+  VectorStorage<int> s({10, 20}, 2);
+
+  Message m;
+  m.meta.flag = Flag::kAddChunk;
+  third_party::SArray<Key> s_keys({6});
+  m.AddData(s_keys);
+  m.AddData(third_party::SArray<int>({1, 2}));
+  s.BufferAdd(m);
+  s.BufferAdd(m);
+  s.FlushAdds();
+  third_party::SArray<int> ret = third_party::SArray<int>(s.SubGetChunk(s_keys));
+  ASSERT_EQ(ret.size(), 2);
+  EXPECT_EQ(ret[0], 2);
+  EXPECT_EQ(ret[1], 4);
+}
+
+TEST_F(TestVectorStorage, Snapshot) {
+  VectorStorage<int> s({10, 20}, 1, nullptr, true);
+  EXPECT_TRUE(s.SupportSnapshot());
+
+  third_party::SArray<Key> s_keys({13, 14});
+  s.SubAdd(s_keys, third_party::SArray<char>(third_party::SArray<int>({1, 2})));
+  // Adds are not visible in the snapshot until FinishIter
+  third_party::SArray<int> ret = third_party::SArray<int>(s.SubGetSnapshot(s_keys));
+  EXPECT_EQ(ret[0], 0);
+  EXPECT_EQ(ret[1], 0);
+  ret = third_party::SArray<int>(s.SubGet(s_keys));
+  EXPECT_EQ(ret[0], 1);
+
+  s.FinishIter();
+  ret = third_party::SArray<int>(s.SubGetSnapshot(s_keys));
+  EXPECT_EQ(ret[0], 1);
+  EXPECT_EQ(ret[1], 2);
+
+  // The snapshot buffers are reused across iterations
+  for (int i = 0; i < 3; ++i) {
+    s.SubAdd(s_keys, third_party::SArray<char>(third_party::SArray<int>({1, 1})));
+    s.FinishIter();
+  }
+  Message m;
+  m.meta.flag = Flag::kGet;
+  m.AddData(s_keys);
+  Message rep = s.GetFromSnapshot(m);
+  EXPECT_EQ(rep.meta.flag, Flag::kGetReply);
+  ret = third_party::SArray<int>(rep.data[1]);
+  EXPECT_EQ(ret[0], 4);
+  EXPECT_EQ(ret[1], 5);
+}
+
+TEST_F(TestVectorStorage, SnapshotBlocks) {
+  // 3 blocks of 4096 keys and a partial one
+  VectorStorage<int> s({0, 3 * 4096 + 10}, 1, nullptr, true);
+  EXPECT_EQ(s.GetNumCopiedSnapshotBlocks(), 4);
+  third_party::SArray<Key> s_keys({Key(5), Key(3 * 4096 + 1)});
+  for (int i = 1; i <= 3; ++i) {
+    s.SubBufferAdd(third_party::SArray<Key>({Key(5)}), third_party::SArray<char>(third_party::SArray<int>({1})));
+    s.FlushAdds();
+    s.FinishIter();
+    // Only the block of key 5 is copied
+    EXPECT_EQ(s.GetNumCopiedSnapshotBlocks(), 1);
+    third_party::SArray<int> ret = third_party::SArray<int>(s.SubGetSnapshot(s_keys));
+    EXPECT_EQ(ret[0], i);
+    EXPECT_EQ(ret[1], 0);
+  }
+  s.SubAdd(third_party::SArray<Key>({Key(3 * 4096 + 1)}), third_party::SArray<char>(third_party::SArray<int>({7})));
+  s.FinishIter();
+  EXPECT_EQ(s.GetNumCopiedSnapshotBlocks(), 1);
+  third_party::SArray<int> ret = third_party::SArray<int>(s.SubGetSnapshot(s_keys));
+  EXPECT_EQ(ret[0], 3);
+  EXPECT_EQ(ret[1], 7);
+  s.FinishIter();
+  EXPECT_EQ(s.GetNumCopiedSnapshotBlocks(), 0);
+}
+
+TEST_F(TestVectorStorage, SnapshotDisabled) {
+  VectorStorage<int> s({10, 20});
+  EXPECT_FALSE(s.SupportSnapshot());
+}
+
+TEST_F(TestVectorStorage, KeylessGet) {
+  VectorStorage<int> s({10, 20}, 1, ConstantInitializer<int>(3));
+  Message m;
+  m.meta.flag = Flag::kGet;
+  m.meta.req_id = 7;
+  m.AddData(third_party::SArray<Key>({12, 15}));
+  Message rep = s.Get(m);
+  EXPECT_EQ(rep.meta.req_id, 7);
+  ASSERT_EQ(rep.data.size(), 1);
+  third_party::SArray<int> ret(rep.data[0]);
+  ASSERT_EQ(ret.size(), 2);
+  EXPECT_EQ(ret[0], 3);
+
+  // Replies carry the keys without req_id
+  m.meta.req_id = 0;
+  rep = s.Get(m);
+  EXPECT_EQ(rep.data.size(), 2);
+}
+
+TEST_F(TestVectorStorage, Migrate) {
+  VectorStorage<int> s1({10, 20}, 1, ConstantInitializer<int>(7), true);
+  VectorStorage<int> s2({20, 30}, 1, ConstantInitializer<int>(7), true);
+  s1.SubAdd(third_party::SArray<Key>({15, 18}), third_party::SArray<char>(third_party::SArray<int>({1, 2})));
+
+  // Move [15, 20) from s1 to s2
+  third_party::SArray<Key> keys;
+  third_party::SArray<char> vals;
+  s1.ExportRange({15, 25}, &keys, &vals);
+  ASSERT_EQ(keys.size(), 5);
+  EXPECT_EQ(keys[0], 15);
+  EXPECT_EQ(keys[4], 19);
+  s1.ResetRange({10, 15});
+  s2.ResetRange({15, 30});
+  s2.ImportKeys(keys, vals);
+  EXPECT_EQ(s1.Size(), 5);
+  EXPECT_EQ(s2.Size(), 15);
+
+  third_party::SArray<Key> s_keys({15, 17, 18, 25});
+  third_party::SArray<int> ret = third_party::SArray<int>(s2.SubGet(s_keys));
+  EXPECT_EQ(ret[0], 8);
+  EXPECT_EQ(ret[1], 7);
+  EXPECT_EQ(ret[2], 9);
+  EXPECT_EQ(ret[3], 7);
+  // The snapshot follows the new range
+  ret = third_party::SArray<int>(s2.SubGetSnapshot(s_keys));
+  EXPECT_EQ(ret[0], 8);
+  EXPECT_EQ(ret[2], 9);
+  s2.FinishIter();
+  ret = third_party::SArray<int>(s2.SubGetSnapshot(s_keys));
+  EXPECT_EQ(ret[3], 7);
+
+  // Keys newly in charge without import start from the initializer
+  s1.ResetRange({5, 12});
+  ret = third_party::SArray<int>(s1.SubGet(third_party::SArray<Key>({5, 11})));
+  EXPECT_EQ(ret[0], 7);
+  EXPECT_EQ(ret[1], 7);
+}
+
+TEST_F(TestVectorStorage, ParallelSubRanges) {
+  ThreadPool executor(3);
+  VectorStorage<int> s({0, 100});
+  s.SetExecutor(&executor);
+  s.SetMinKeysPerTask(4);
+
+  // Every key appears 3 times, so the task boundaries must not split equal keys
+  std::vector<Key> key_vec;
+  for (Key k = 0; k < 100; k += 2) {
+    for (int i = 0; i < 3; ++i)
+      key_vec.push_back(k);
+  }
+  third_party::SArray<Key> keys(key_vec);
+  third_party::SArray<int> vals(keys.size(), 1);
+  s.SubAdd(keys, third_party::SArray<char>(vals));
+  s.SubBufferAdd(keys, third_party::SArray<char>(vals));
+  s.SubBufferAdd(keys, third_party::SArray<char>(vals));
+  s.FlushAdds();
+
+  third_party::SArray<Key> get_keys(100);
+  for (Key k = 0; k < 100; ++k)
+    get_keys[k] = k;
+  third_party::SArray<int> ret = third_party::SArray<int>(s.SubGet(get_keys));
+  ASSERT_EQ(ret.size(), 100);
+  for (Key k = 0; k < 100; ++k)
+    EXPECT_EQ(ret[k], k % 2 == 0 ? 9 : 0);
+}
+
 }  // namespace
 }  // namespace flexps
 
@@ -6,6 +6,15 @@
 
 namespace flexps {
 
+/*
+ * A request of an app thread to a model is sent as one message per server. The req_id of the messages
+ * carries the id of the request in its high bits and the index of the message in the low bits,
+ * so that the responses to several outstanding requests can be told apart.
+ */
+const uint32_t kReqIdSliceBits = 12;
+inline uint32_t MakeReqId(uint32_t request_id, uint32_t slice) { return (request_id << kReqIdSliceBits) | slice; }
+inline uint32_t GetRequestId(uint32_t req_id) { return req_id >> kReqIdSliceBits; }
+
 class AbstractCallbackRunner {
  public:
   virtual ~AbstractCallbackRunner() {}
@@ -16,6 +25,16 @@ class AbstractCallbackRunner {
 
   virtual void NewRequest(uint32_t app_thread_id, uint32_t model_id, uint32_t expected_responses) = 0;
   virtual void WaitRequest(uint32_t app_thread_id, uint32_t model_id) = 0;
+
+  /*
+   * Asynchronous requests, several of them may be outstanding for an (app_thread_id, model_id) besides the
+   * one of NewRequest(). The responses with GetRequestId(req_id) == request_id go to the recv handle, and
+   * finish_handle runs after the last one. A request need not be waited on, WaitAsyncRequest() returns
+   * at once for a request that has completed.
+   */
+  virtual void NewAsyncRequest(uint32_t app_thread_id, uint32_t model_id, uint32_t request_id,
+                               uint32_t expected_responses, const std::function<void()>& finish_handle) = 0;
+  virtual void WaitAsyncRequest(uint32_t app_thread_id, uint32_t model_id, uint32_t request_id) = 0;
 };
 
 }  // namespace flexps
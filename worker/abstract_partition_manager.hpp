@@ -21,13 +21,28 @@ class AbstractPartitionManager {
 
   size_t GetNumServers() const { return server_thread_ids_.size(); }
   const std::vector<uint32_t>& GetServerThreadIds() const { return server_thread_ids_; }
+  // The version of the layout, a repartitioned table gets a manager with the next version
+  uint32_t GetVersion() const { return version_; }
 
   // slice key-value pairs into <server_id, key_value_partition> pairs
   virtual SlicedKVs Slice(const KVPairs<char>& kvs) const = 0;
   virtual SlicedKVs SliceChunk(const KVPairs<char>& kvs) const = 0;
 
+  /*
+   * Slice the keys of a Get. A partition manager with replicas may send a slice to a replica instead of
+   * the owner: (*replica_of)[i] is the owner of slice i if slice i goes to a replica, -1 otherwise.
+   */
+  virtual SlicedKVs SliceGet(const KVPairs<char>& kvs, std::vector<int>* replica_of) const {
+    SlicedKVs sliced = Slice(kvs);
+    replica_of->assign(sliced.size(), -1);
+    return sliced;
+  }
+
+  virtual ~AbstractPartitionManager() {}
+
  protected:
   std::vector<uint32_t> server_thread_ids_;
+  uint32_t version_ = 0;
 };  // class AbstractPartitionManager
 
 }  // namespace flexps
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "base/magic.hpp"
+#include "base/message.hpp"
+#include "base/third_party/sarray.h"
+#include "base/threadsafe_queue.hpp"
+
+#include "worker/abstract_partition_manager.hpp"
+
+#include "glog/logging.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace flexps {
+
+class AbstractAddCombiner {
+ public:
+  virtual ~AbstractAddCombiner() {}
+  // Called before the local threads of a task start, num_threads of them use the table
+  virtual void Reset(uint32_t num_threads) = 0;
+  // Send what is left, called after the local threads of a task are done
+  virtual void FlushAll() = 0;
+};
+
+/*
+ * Combine the Adds of the local worker threads to a table, so that a hot key is sent to its server once
+ * per clock by the node instead of once by each thread. The Adds are summed per (server, clock), the
+ * clock being the progress of the thread that adds.
+ *
+ * The combined Adds of a clock are sent right before the Clock message of the last local thread
+ * finishing that clock, on behalf of that thread. Since the min clock of the server cannot pass the
+ * clock before this Clock arrives, and the messages of a thread are handled in order, the servers see
+ * the Adds of a clock before the clock ends, as BSP and SSP require. If the first Adds of a clock
+ * have waited longer than deadline, they are sent early on behalf of the thread that adds or clocks.
+ *
+ * Thread-safe, shared by the local threads.
+ */
+template <typename Val>
+class AddCombiner : public AbstractAddCombiner {
+ public:
+  using SlicedKVs = AbstractPartitionManager::SlicedKVs;
+
+  AddCombiner(uint32_t model_id, ThreadsafeQueue<Message>* const send_queue,
+              std::chrono::milliseconds deadline = std::chrono::milliseconds(10))
+      : model_id_(model_id), send_queue_(send_queue), deadline_(deadline) {}
+
+  virtual void Reset(uint32_t num_threads) override;
+  virtual void FlushAll() override;
+
+  void Add(uint32_t app_thread_id, int clock, const SlicedKVs& sliced);
+  // Send the Clock messages of a thread at the end of clock
+  void Clock(uint32_t app_thread_id, int clock, std::vector<Message>&& clock_msgs);
+
+  // The number of key-value pairs added by the threads and sent to the servers
+  size_t GetNumAdded() const { return num_added_; }
+  size_t GetNumSent() const { return num_sent_; }
+
+ private:
+  struct Bucket {
+    std::map<uint32_t, std::unordered_map<Key, Val>> updates;  // by server
+    uint32_t num_clocked = 0;
+    uint32_t first_sender = 0;
+    std::chrono::steady_clock::time_point first_add;
+  };
+  // Send the Adds of bucket on behalf of sender, mu_ is held
+  void Emit(Bucket* bucket, uint32_t sender);
+  bool Expired(const Bucket& bucket) const {
+    return !bucket.updates.empty() && std::chrono::steady_clock::now() - bucket.first_add >= deadline_;
+  }
+
+  const uint32_t model_id_;
+  // Not owned.
+  ThreadsafeQueue<Message>* const send_queue_;
+  const std::chrono::milliseconds deadline_;
+
+  std::mutex mu_;
+  std::map<int, Bucket> buckets_;  // by clock
+  uint32_t num_threads_ = 0;
+  size_t num_added_ = 0;
+  size_t num_sent_ = 0;
+};
+
+template <typename Val>
+void AddCombiner<Val>::Reset(uint32_t num_threads) {
+  std::lock_guard<std::mutex> lk(mu_);
+  CHECK(buckets_.empty()) << "Adds left from the last task";
+  num_threads_ = num_threads;
+}
+
+template <typename Val>
+void AddCombiner<Val>::FlushAll() {
+  std::lock_guard<std::mutex> lk(mu_);
+  for (auto& kv : buckets_)
+    Emit(&kv.second, kv.second.first_sender);
+  buckets_.clear();
+}
+
+template <typename Val>
+void AddCombiner<Val>::Add(uint32_t app_thread_id, int clock, const SlicedKVs& sliced) {
+  std::lock_guard<std::mutex> lk(mu_);
+  Bucket& bucket = buckets_[clock];
+  if (bucket.updates.empty()) {
+    bucket.first_sender = app_thread_id;
+    bucket.first_add = std::chrono::steady_clock::now();
+  }
+  for (const auto& slice : sliced) {
+    third_party::SArray<Val> vals(slice.second.vals);
+    CHECK_EQ(slice.second.keys.size(), vals.size());
+    auto& updates = bucket.updates[slice.first];
+    for (size_t i = 0; i < vals.size(); ++i)
+      updates[slice.second.keys[i]] += vals[i];
+    num_added_ += vals.size();
+  }
+  // The thread has not finished this clock, so its Clock follows the early Adds
+  if (Expired(bucket))
+    Emit(&bucket, app_thread_id);
+}
+
+template <typename Val>
+void AddCombiner<Val>::Clock(uint32_t app_thread_id, int clock, std::vector<Message>&& clock_msgs) {
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = buckets_.find(clock);
+    if (it == buckets_.end())
+      it = buckets_.emplace(clock, Bucket()).first;
+    it->second.num_clocked += 1;
+    if (it->second.num_clocked >= num_threads_) {
+      Emit(&it->second, app_thread_id);
+      buckets_.erase(it);
+    } else if (Expired(it->second)) {
+      Emit(&it->second, app_thread_id);
+    }
+  }
+  for (auto& msg : clock_msgs)
+    send_queue_->Push(std::move(msg));
+}
+
+template <typename Val>
+void AddCombiner<Val>::Emit(Bucket* bucket, uint32_t sender) {
+  for (auto& kv : bucket->updates) {
+    std::vector<std::pair<Key, Val>> updates(kv.second.begin(), kv.second.end());
+    std::sort(updates.begin(), updates.end(),
+              [](const std::pair<Key, Val>& a, const std::pair<Key, Val>& b) { return a.first < b.first; });
+    third_party::SArray<Key> keys(updates.size());
+    third_party::SArray<Val> vals(updates.size());
+    for (size_t i = 0; i < updates.size(); ++i) {
+      keys[i] = updates[i].first;
+      vals[i] = updates[i].second;
+    }
+    Message msg;
+    msg.meta.sender = sender;
+    msg.meta.recver = kv.first;
+    msg.meta.model_id = model_id_;
+    msg.meta.flag = Flag::kAdd;
+    msg.AddData(keys);
+    msg.AddData(vals);
+    send_queue_->Push(std::move(msg));
+    num_sent_ += updates.size();
+  }
+  bucket->updates.clear();
+}
+
+}  // namespace flexps
@@ -0,0 +1,134 @@
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+
+#include "worker/add_combiner.hpp"
+#include "worker/kv_table_box.hpp"
+#include "worker/simple_range_manager.hpp"
+
+#include <thread>
+
+namespace flexps {
+namespace {
+
+class TestAddCombiner : public testing::Test {
+ public:
+  TestAddCombiner() {}
+  ~TestAddCombiner() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+const uint32_t kTestModelId = 23;
+
+TEST_F(TestAddCombiner, CombineAtLastClock) {
+  ThreadsafeQueue<Message> queue;
+  SimpleRangePartitionManager manager({{2, 4}, {4, 7}}, {0, 1});
+  AddCombiner<float> combiner(kTestModelId, &queue, std::chrono::hours(1));
+  combiner.Reset(2);
+  KVTableBox<float> box1(10, kTestModelId, &queue, &manager, &combiner);
+  KVTableBox<float> box2(11, kTestModelId, &queue, &manager, &combiner);
+
+  box1.Add(third_party::SArray<Key>({3, 5}), third_party::SArray<float>({0.1, 0.2}));
+  box2.Add(third_party::SArray<Key>({5, 6}), third_party::SArray<float>({0.3, 0.4}));
+  // The Adds of the next clock are kept apart
+  box1.Clock();
+  box1.Add(third_party::SArray<Key>({5}), third_party::SArray<float>({1.0}));
+  ASSERT_EQ(queue.Size(), 2);
+  Message m;
+  queue.WaitAndPop(&m);
+  EXPECT_EQ(m.meta.flag, Flag::kClock);
+  queue.WaitAndPop(&m);
+  EXPECT_EQ(m.meta.flag, Flag::kClock);
+
+  // The last thread to clock sends one Add per server before its Clocks
+  box2.Clock();
+  ASSERT_EQ(queue.Size(), 4);
+  Message m1, m2;
+  queue.WaitAndPop(&m1);
+  queue.WaitAndPop(&m2);
+  EXPECT_EQ(m1.meta.flag, Flag::kAdd);
+  EXPECT_EQ(m1.meta.sender, 11);
+  EXPECT_EQ(m1.meta.recver, 0);
+  EXPECT_EQ(m1.meta.model_id, kTestModelId);
+  EXPECT_EQ(third_party::SArray<Key>(m1.data[0]).size(), 1);
+  EXPECT_EQ(m2.meta.flag, Flag::kAdd);
+  EXPECT_EQ(m2.meta.sender, 11);
+  EXPECT_EQ(m2.meta.recver, 1);
+  third_party::SArray<Key> keys(m2.data[0]);
+  third_party::SArray<float> vals(m2.data[1]);
+  ASSERT_EQ(keys.size(), 2);
+  EXPECT_EQ(keys[0], 5);
+  EXPECT_EQ(keys[1], 6);
+  EXPECT_EQ(vals[0], 0.2f + 0.3f);
+  EXPECT_EQ(vals[1], 0.4f);
+  queue.WaitAndPop(&m);
+  EXPECT_EQ(m.meta.flag, Flag::kClock);
+  EXPECT_EQ(m.meta.sender, 11);
+  queue.WaitAndPop(&m);
+  EXPECT_EQ(m.meta.flag, Flag::kClock);
+  EXPECT_EQ(combiner.GetNumAdded(), 5);
+  EXPECT_EQ(combiner.GetNumSent(), 3);
+
+  // The Adds left are sent at the end of the task
+  combiner.FlushAll();
+  ASSERT_EQ(queue.Size(), 1);
+  queue.WaitAndPop(&m);
+  EXPECT_EQ(m.meta.flag, Flag::kAdd);
+  EXPECT_EQ(m.meta.sender, 10);
+  EXPECT_EQ(third_party::SArray<float>(m.data[1])[0], 1.0f);
+}
+
+TEST_F(TestAddCombiner, Deadline) {
+  ThreadsafeQueue<Message> queue;
+  SimpleRangePartitionManager manager({{2, 4}, {4, 7}}, {0, 1});
+  AddCombiner<int> combiner(kTestModelId, &queue, std::chrono::milliseconds(0));
+  combiner.Reset(2);
+  KVTableBox<int> box(10, kTestModelId, &queue, &manager, &combiner);
+  box.Add(third_party::SArray<Key>({3}), third_party::SArray<int>({1}));
+  // Sent on behalf of the thread that adds
+  ASSERT_EQ(queue.Size(), 1);
+  Message m;
+  queue.WaitAndPop(&m);
+  EXPECT_EQ(m.meta.flag, Flag::kAdd);
+  EXPECT_EQ(m.meta.sender, 10);
+}
+
+TEST_F(TestAddCombiner, ConcurrentThreads) {
+  ThreadsafeQueue<Message> queue;
+  SimpleRangePartitionManager manager({{0, 100}}, {0});
+  AddCombiner<int> combiner(kTestModelId, &queue, std::chrono::hours(1));
+  const int kNumThreads = 4;
+  const int kNumClocks = 3;
+  combiner.Reset(kNumThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&queue, &manager, &combiner, t]() {
+      KVTableBox<int> box(10 + t, kTestModelId, &queue, &manager, &combiner);
+      for (int c = 0; c < kNumClocks; ++c) {
+        box.Add(third_party::SArray<Key>({1, 2}), third_party::SArray<int>({1, c}));
+        box.Clock();
+      }
+    });
+  }
+  for (auto& th : threads)
+    th.join();
+  ASSERT_EQ(queue.Size(), kNumClocks * (1 + kNumThreads));
+  int num_adds = 0;
+  while (queue.Size() > 0) {
+    Message m;
+    queue.WaitAndPop(&m);
+    if (m.meta.flag != Flag::kAdd)
+      continue;
+    third_party::SArray<int> vals(m.data[1]);
+    ASSERT_EQ(vals.size(), 2);
+    EXPECT_EQ(vals[0], kNumThreads);
+    EXPECT_EQ(vals[1], num_adds * kNumThreads);
+    num_adds += 1;
+  }
+  EXPECT_EQ(num_adds, kNumClocks);
+}
+
+}  // namespace
+}  // namespace flexps
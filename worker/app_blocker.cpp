@@ -4,59 +4,154 @@
 
 namespace flexps {
 
-void AppBlocker::SanityCheck(uint32_t app_thread_id, uint32_t model_id) {
-  CHECK(recv_handle_.find(app_thread_id) != recv_handle_.end()) << "recv_handle_ for app_thread_id:" << app_thread_id
-                                                                << " is not registered";
-  CHECK(recv_handle_[app_thread_id].find(model_id) != recv_handle_[app_thread_id].end())
-      << "recv_handle_ for model:" << model_id << " is not registered";
+AppBlocker::~AppBlocker() {
+  for (auto& bucket : buckets_) {
+    Slot* slot = bucket.load();
+    while (slot) {
+      Slot* next = slot->next;
+      delete slot;
+      slot = next;
+    }
+  }
+}
+
+AppBlocker::Slot* AppBlocker::FindSlot(uint32_t app_thread_id, uint32_t model_id) const {
+  Slot* slot = buckets_[GetBucket(app_thread_id, model_id)].load(std::memory_order_acquire);
+  while (slot && (slot->app_thread_id != app_thread_id || slot->model_id != model_id))
+    slot = slot->next;
+  return slot;
+}
+
+AppBlocker::Slot* AppBlocker::GetSlot(uint32_t app_thread_id, uint32_t model_id, bool need_finish_handle) const {
+  Slot* slot = FindSlot(app_thread_id, model_id);
+  CHECK(slot && slot->recv_handle) << "recv_handle_ for app_thread_id:" << app_thread_id << ", model:" << model_id
+                                   << " is not registered";
+  CHECK(!need_finish_handle || slot->recv_finish_handle)
+      << "recv_finish_handle_ for app_thread_id:" << app_thread_id << ", model:" << model_id << " is not registered";
+  return slot;
+}
 
-  CHECK(recv_finish_handle_.find(app_thread_id) != recv_finish_handle_.end())
-      << "recv_finish_handle_ for model:" << app_thread_id << " is not registered";
-  CHECK(recv_finish_handle_[app_thread_id].find(model_id) != recv_finish_handle_[app_thread_id].end())
-      << "recv_finish_handle_ for model:" << model_id << " is not registered";
+AppBlocker::Slot* AppBlocker::FindOrCreateSlot(uint32_t app_thread_id, uint32_t model_id) {
+  std::lock_guard<std::mutex> lk(create_mu_);
+  Slot* slot = FindSlot(app_thread_id, model_id);
+  if (slot)
+    return slot;
+  auto& bucket = buckets_[GetBucket(app_thread_id, model_id)];
+  slot = new Slot(app_thread_id, model_id);
+  slot->next = bucket.load(std::memory_order_relaxed);
+  bucket.store(slot, std::memory_order_release);
+  return slot;
 }
 
 void AppBlocker::RegisterRecvHandle(uint32_t app_thread_id, uint32_t model_id,
                                     const std::function<void(Message&)>& recv_handle) {
-  std::lock_guard<std::mutex> lk(mu_);
-  recv_handle_[app_thread_id][model_id] = recv_handle;
+  Slot* slot = FindOrCreateSlot(app_thread_id, model_id);
+  std::lock_guard<std::mutex> lk(slot->mu);
+  slot->recv_handle = recv_handle;
 }
 
 void AppBlocker::RegisterRecvFinishHandle(uint32_t app_thread_id, uint32_t model_id,
                                           const std::function<void()>& recv_finish_handle) {
-  std::lock_guard<std::mutex> lk(mu_);
-  recv_finish_handle_[app_thread_id][model_id] = recv_finish_handle;
+  Slot* slot = FindOrCreateSlot(app_thread_id, model_id);
+  std::lock_guard<std::mutex> lk(slot->mu);
+  slot->recv_finish_handle = recv_finish_handle;
 }
 
 void AppBlocker::NewRequest(uint32_t app_thread_id, uint32_t model_id, uint32_t expected_responses) {
-  std::lock_guard<std::mutex> lk(mu_);
-  SanityCheck(app_thread_id, model_id);
-  tracker_[app_thread_id][model_id] = {expected_responses, 0};
+  Slot* slot = GetSlot(app_thread_id, model_id, true);
+  std::lock_guard<std::mutex> lk(slot->mu);
+  slot->received.store(0, std::memory_order_relaxed);
+  slot->expected.store(expected_responses, std::memory_order_release);
 }
+
 void AppBlocker::WaitRequest(uint32_t app_thread_id, uint32_t model_id) {
-  std::unique_lock<std::mutex> lk(mu_);
-  SanityCheck(app_thread_id, model_id);
-  cond_.wait(lk, [this, app_thread_id, model_id] {
-    return tracker_[app_thread_id][model_id].first == tracker_[app_thread_id][model_id].second;
-  });
+  Slot* slot = GetSlot(app_thread_id, model_id, true);
+  auto done = [slot] {
+    return slot->received.load(std::memory_order_acquire) == slot->expected.load(std::memory_order_relaxed);
+  };
+  if (done())
+    return;
+  std::unique_lock<std::mutex> lk(slot->mu);
+  slot->cond.wait(lk, done);
 }
-void AppBlocker::AddResponse(uint32_t app_thread_id, uint32_t model_id, Message& msg) {
-  bool recv_finish = false;
+
+void AppBlocker::NewAsyncRequest(uint32_t app_thread_id, uint32_t model_id, uint32_t request_id,
+                                 uint32_t expected_responses, const std::function<void()>& finish_handle) {
+  Slot* slot = GetSlot(app_thread_id, model_id, false);
+  CHECK_NE(request_id, 0);
+  std::lock_guard<std::mutex> lk(slot->mu);
+  CHECK(slot->async_trackers.find(request_id) == slot->async_trackers.end())
+      << "request " << request_id << " is outstanding";
+  slot->async_trackers[request_id] = {expected_responses, 0, finish_handle, 0};
+}
+
+void AppBlocker::WaitAsyncRequest(uint32_t app_thread_id, uint32_t model_id, uint32_t request_id) {
+  Slot* slot = GetSlot(app_thread_id, model_id, false);
+  std::unique_lock<std::mutex> lk(slot->mu);
+  auto it = slot->async_trackers.find(request_id);
+  // Already completed and reclaimed
+  if (it == slot->async_trackers.end())
+    return;
+  AsyncTracker& tracker = it->second;
+  tracker.num_waiters += 1;
+  slot->cond.wait(lk, [&tracker] { return tracker.expected == tracker.current; });
+  tracker.num_waiters -= 1;
+  if (tracker.num_waiters == 0)
+    slot->async_trackers.erase(it);
+}
+
+size_t AppBlocker::GetNumAsyncRequests(uint32_t app_thread_id, uint32_t model_id) {
+  Slot* slot = GetSlot(app_thread_id, model_id, false);
+  std::lock_guard<std::mutex> lk(slot->mu);
+  return slot->async_trackers.size();
+}
+
+bool AppBlocker::AddAsyncResponse(Slot* slot, Message& msg) {
+  const uint32_t request_id = GetRequestId(msg.meta.req_id);
+  std::function<void()> finish_handle;
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    recv_finish =
-        tracker_[app_thread_id][model_id].first == tracker_[app_thread_id][model_id].second + 1 ? true : false;
-  }
-  recv_handle_[app_thread_id][model_id](msg);
-  if (recv_finish) {
-    recv_finish_handle_[app_thread_id][model_id]();
+    std::lock_guard<std::mutex> lk(slot->mu);
+    auto it = slot->async_trackers.find(request_id);
+    if (it == slot->async_trackers.end())
+      return false;
+    if (it->second.current + 1 == it->second.expected)
+      finish_handle = it->second.finish_handle;
   }
+  slot->recv_handle(msg);
+  if (finish_handle)
+    finish_handle();
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    tracker_[app_thread_id][model_id].second += 1;
-    if (recv_finish) {
-      cond_.notify_all();
+    std::lock_guard<std::mutex> lk(slot->mu);
+    auto it = slot->async_trackers.find(request_id);
+    it->second.current += 1;
+    // A handle that is never waited on must not keep its request id outstanding
+    if (finish_handle && it->second.num_waiters == 0)
+      slot->async_trackers.erase(it);
+  }
+  if (finish_handle)
+    slot->cond.notify_all();
+  return true;
+}
+
+void AppBlocker::AddResponse(uint32_t app_thread_id, uint32_t model_id, Message& msg) {
+  Slot* slot = FindSlot(app_thread_id, model_id);
+  CHECK(slot && slot->recv_handle) << "recv_handle_ for app_thread_id:" << app_thread_id << ", model:" << model_id
+                                   << " is not registered";
+  if (msg.meta.req_id != 0 && AddAsyncResponse(slot, msg))
+    return;
+  const uint32_t received = slot->received.load(std::memory_order_relaxed) + 1;
+  const bool recv_finish = received == slot->expected.load(std::memory_order_acquire);
+  slot->recv_handle(msg);
+  if (recv_finish) {
+    slot->recv_finish_handle();
+    // Under the lock, so that the waiter either sees the request done or is notified
+    {
+      std::lock_guard<std::mutex> lk(slot->mu);
+      slot->received.store(received, std::memory_order_release);
     }
+    slot->cond.notify_all();
+  } else {
+    slot->received.store(received, std::memory_order_release);
   }
 }
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <condition_variable>
 #include <map>
 #include <mutex>
@@ -20,9 +22,18 @@ namespace flexps {
  *
  * Should register handle before use.
  * Should call NewRequest before sending out the request.
+ *
+ * Each (app_thread_id, model_id) has its own slot, allocated when its handle is registered, with the
+ * counters of its request and its own condition variable, so that a response only touches and wakes up
+ * the thread waiting for it. The slots are found through a fixed array of buckets without locking.
  */
 class AppBlocker : public AbstractCallbackRunner, public AbstractReceiver {
  public:
+  AppBlocker() = default;
+  ~AppBlocker();
+  AppBlocker(const AppBlocker&) = delete;
+  AppBlocker& operator=(const AppBlocker&) = delete;
+
   virtual void RegisterRecvHandle(uint32_t app_thread_id, uint32_t model_id,
                                   const std::function<void(Message&)>& recv_handle) override;
   virtual void RegisterRecvFinishHandle(uint32_t app_thread_id, uint32_t model_id,
@@ -31,20 +42,60 @@ class AppBlocker : public AbstractCallbackRunner, public AbstractReceiver {
   virtual void NewRequest(uint32_t app_thread_id, uint32_t model_id, uint32_t expected_responses) override;
   virtual void WaitRequest(uint32_t app_thread_id, uint32_t model_id) override;
 
+  virtual void NewAsyncRequest(uint32_t app_thread_id, uint32_t model_id, uint32_t request_id,
+                               uint32_t expected_responses, const std::function<void()>& finish_handle) override;
+  virtual void WaitAsyncRequest(uint32_t app_thread_id, uint32_t model_id, uint32_t request_id) override;
+
   virtual void AddResponse(uint32_t app_thread_id, uint32_t model_id, Message& msg) override;
 
+  // The asynchronous requests of the slot not completed, or completed with a waiter that has not returned yet
+  size_t GetNumAsyncRequests(uint32_t app_thread_id, uint32_t model_id);
+
+  static const uint32_t kNumBuckets = 1024;
+
  private:
-  void SanityCheck(uint32_t app_thread_id, uint32_t model_id);
+  struct AsyncTracker {
+    uint32_t expected;
+    uint32_t current;
+    std::function<void()> finish_handle;
+    // The threads in WaitAsyncRequest(), the last one erases the tracker. Without waiters, the tracker
+    // is erased by the last response.
+    int num_waiters;
+  };
+  struct Slot {
+    Slot(uint32_t app_thread_id, uint32_t model_id) : app_thread_id(app_thread_id), model_id(model_id) {}
+    const uint32_t app_thread_id;
+    const uint32_t model_id;
+    // The next slot in the bucket, immutable once the slot is published
+    Slot* next = nullptr;
+
+    // Set before the requests of the slot are sent, read by AddResponse() without locking
+    std::function<void(Message&)> recv_handle;
+    std::function<void()> recv_finish_handle;
+
+    // The request of NewRequest(), received is only written by the thread calling AddResponse()
+    std::atomic<uint32_t> expected{0};
+    std::atomic<uint32_t> received{0};
 
-  std::condition_variable cond_;
-  std::mutex mu_;
+    // Protects async_trackers, and the completion of a request against the waiter
+    std::mutex mu;
+    std::condition_variable cond;
+    std::map<uint32_t, AsyncTracker> async_trackers;
+  };
 
-  // app_thread_id, model_id, <expected, current>
-  std::map<uint32_t, std::map<uint32_t, std::pair<uint32_t, uint32_t>>> tracker_;
+  static uint32_t GetBucket(uint32_t app_thread_id, uint32_t model_id) {
+    return (app_thread_id * 0x9e3779b1u ^ model_id) % kNumBuckets;
+  }
+  Slot* FindSlot(uint32_t app_thread_id, uint32_t model_id) const;
+  // Find the slot, CHECK it has its handles registered
+  Slot* GetSlot(uint32_t app_thread_id, uint32_t model_id, bool need_finish_handle) const;
+  Slot* FindOrCreateSlot(uint32_t app_thread_id, uint32_t model_id);
+  // Return false if msg does not belong to an asynchronous request
+  bool AddAsyncResponse(Slot* slot, Message& msg);
 
-  // app_thread_id, model_id, callback
-  std::map<uint32_t, std::map<uint32_t, std::function<void(Message& message)>>> recv_handle_;
-  std::map<uint32_t, std::map<uint32_t, std::function<void()>>> recv_finish_handle_;
+  std::array<std::atomic<Slot*>, kNumBuckets> buckets_{};
+  // Serializes the creation of slots
+  std::mutex create_mu_;
 };
 
 }  // namespace flexps
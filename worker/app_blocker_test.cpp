@@ -2,6 +2,7 @@
 
 #include <future>
 #include <thread>
+#include <vector>
 #include "glog/logging.h"
 
 #include "app_blocker.hpp"
@@ -125,5 +126,98 @@ TEST_F(TestAppBlocker, MultiThreadsReused) {
   }
 }
 
+TEST_F(TestAppBlocker, AsyncRequests) {
+  AppBlocker blocker;
+  int f1_counter = 0;
+  auto f1 = [&f1_counter](Message& message) { f1_counter += 1; };
+  blocker.RegisterRecvHandle(0, 0, f1);
+  int finished_3 = 0, finished_4 = 0;
+  blocker.NewAsyncRequest(0, 0, 3, 2, [&finished_3]() { finished_3 += 1; });
+  blocker.NewAsyncRequest(0, 0, 4, 1, [&finished_4]() { finished_4 += 1; });
+  Message m3, m4;
+  m3.meta.req_id = MakeReqId(3, 0);
+  m4.meta.req_id = MakeReqId(4, 0);
+  // The responses of the outstanding requests interleave
+  blocker.AddResponse(0, 0, m3);
+  blocker.AddResponse(0, 0, m4);
+  EXPECT_EQ(finished_3, 0);
+  EXPECT_EQ(finished_4, 1);
+  blocker.WaitAsyncRequest(0, 0, 4);
+
+  std::thread th([&blocker] { blocker.WaitAsyncRequest(0, 0, 3); });
+  m3.meta.req_id = MakeReqId(3, 1);
+  blocker.AddResponse(0, 0, m3);
+  th.join();
+  EXPECT_EQ(finished_3, 1);
+  EXPECT_EQ(f1_counter, 3);
+}
+
+TEST_F(TestAppBlocker, AsyncRequestsNotWaited) {
+  AppBlocker blocker;
+  blocker.RegisterRecvHandle(0, 0, [](Message&) {});
+  for (int round = 0; round < 3; ++round) {
+    // The request id is reused without waiting on its previous request
+    int finished = 0;
+    blocker.NewAsyncRequest(0, 0, 5, 2, [&finished]() { finished += 1; });
+    EXPECT_EQ(blocker.GetNumAsyncRequests(0, 0), 1);
+    Message m;
+    m.meta.req_id = MakeReqId(5, 0);
+    blocker.AddResponse(0, 0, m);
+    m.meta.req_id = MakeReqId(5, 1);
+    blocker.AddResponse(0, 0, m);
+    EXPECT_EQ(finished, 1);
+    EXPECT_EQ(blocker.GetNumAsyncRequests(0, 0), 0);
+  }
+  // Waiting on a reclaimed request returns at once
+  blocker.WaitAsyncRequest(0, 0, 5);
+}
+
+TEST_F(TestAppBlocker, ManySlots) {
+  // Slots that share a bucket and requests of different slots completing independently
+  AppBlocker blocker;
+  const int kNumThreads = 8;
+  const int kNumModels = 3;
+  std::vector<int> counters(kNumThreads * kNumModels, 0);
+  for (int t = 0; t < kNumThreads; ++t) {
+    for (int m = 0; m < kNumModels; ++m) {
+      uint32_t tid = t * AppBlocker::kNumBuckets;
+      int* counter = &counters[t * kNumModels + m];
+      blocker.RegisterRecvHandle(tid, m, [counter](Message&) { *counter += 1; });
+      blocker.RegisterRecvFinishHandle(tid, m, [counter]() { *counter += 100; });
+    }
+  }
+  const int kRounds = 50;
+  std::vector<std::thread> app_threads;
+  std::vector<std::thread> worker_threads;
+  std::vector<std::promise<void>> requested(kNumThreads * kNumModels * kRounds);
+  for (int t = 0; t < kNumThreads; ++t) {
+    app_threads.push_back(std::thread([&blocker, &requested, t] {
+      for (int r = 0; r < kRounds; ++r) {
+        for (int m = 0; m < kNumModels; ++m) {
+          blocker.NewRequest(t * AppBlocker::kNumBuckets, m, 2);
+          requested[(t * kNumModels + m) * kRounds + r].set_value();
+          blocker.WaitRequest(t * AppBlocker::kNumBuckets, m);
+        }
+      }
+    }));
+    worker_threads.push_back(std::thread([&blocker, &requested, t] {
+      for (int r = 0; r < kRounds; ++r) {
+        for (int m = 0; m < kNumModels; ++m) {
+          requested[(t * kNumModels + m) * kRounds + r].get_future().wait();
+          Message msg;
+          blocker.AddResponse(t * AppBlocker::kNumBuckets, m, msg);
+          blocker.AddResponse(t * AppBlocker::kNumBuckets, m, msg);
+        }
+      }
+    }));
+  }
+  for (auto& th : app_threads)
+    th.join();
+  for (auto& th : worker_threads)
+    th.join();
+  for (int counter : counters)
+    EXPECT_EQ(counter, kRounds * 102);
+}
+
 }  // namespace
 }  // namespace flexps
@@ -1,5 +1,7 @@
 #include "worker/abstract_callback_runner.hpp"
 
+#include <map>
+
 #include "glog/logging.h"
 
 namespace flexps {
@@ -32,8 +34,26 @@ class FakeCallbackRunner : public AbstractCallbackRunner {
     std::unique_lock<std::mutex> lk(mu_);
     cond_.wait(lk, [this] { return tracker_.first == tracker_.second; });
   }
+  virtual void NewAsyncRequest(uint32_t app_thread_id, uint32_t model_id, uint32_t request_id,
+                               uint32_t expected_responses, const std::function<void()>& finish_handle) override {
+    CHECK_EQ(app_thread_id, kTestAppThreadId_);
+    CHECK_EQ(model_id, kTestModelId_);
+    std::lock_guard<std::mutex> lk(mu_);
+    async_trackers_[request_id] = {expected_responses, 0, finish_handle};
+  }
+  virtual void WaitAsyncRequest(uint32_t app_thread_id, uint32_t model_id, uint32_t request_id) override {
+    CHECK_EQ(app_thread_id, kTestAppThreadId_);
+    CHECK_EQ(model_id, kTestModelId_);
+    std::unique_lock<std::mutex> lk(mu_);
+    cond_.wait(lk, [this, request_id] {
+      return async_trackers_[request_id].expected == async_trackers_[request_id].current;
+    });
+    async_trackers_.erase(request_id);
+  }
   void AddResponse(Message m) {
     EXPECT_NE(recv_handle_, nullptr);
+    if (m.meta.req_id != 0 && AddAsyncResponse(m))
+      return;
     bool recv_finish = false;
     {
       std::lock_guard<std::mutex> lk(mu_);
@@ -60,6 +80,32 @@ class FakeCallbackRunner : public AbstractCallbackRunner {
   std::condition_variable cond_;
   std::pair<uint32_t, uint32_t> tracker_;
 
+  struct AsyncTracker {
+    uint32_t expected;
+    uint32_t current;
+    std::function<void()> finish_handle;
+  };
+  std::map<uint32_t, AsyncTracker> async_trackers_;
+
+  bool AddAsyncResponse(Message& m) {
+    std::function<void()> finish_handle;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      auto it = async_trackers_.find(GetRequestId(m.meta.req_id));
+      if (it == async_trackers_.end())
+        return false;
+      if (it->second.current + 1 == it->second.expected)
+        finish_handle = it->second.finish_handle;
+    }
+    recv_handle_(m);
+    if (finish_handle)
+      finish_handle();
+    std::lock_guard<std::mutex> lk(mu_);
+    async_trackers_[GetRequestId(m.meta.req_id)].current += 1;
+    cond_.notify_all();
+    return true;
+  }
+
   const uint32_t kTestAppThreadId_;
   const uint32_t kTestModelId_;
 };
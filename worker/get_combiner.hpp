@@ -0,0 +1,133 @@
+#pragma once
+
+#include "base/magic.hpp"
+#include "base/third_party/sarray.h"
+
+#include "glog/logging.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace flexps {
+
+class AbstractGetCombiner {
+ public:
+  virtual ~AbstractGetCombiner() {}
+  // Called before the local threads of a task start, num_threads of them use the table
+  virtual void Reset(uint32_t num_threads) = 0;
+};
+
+/*
+ * Combine the concurrent Gets of the local worker threads to a table, so that the keys wanted by several
+ * threads are fetched and served once by the node, e.g. the centers that all the threads of kmeans pull.
+ *
+ * Only the Gets at the same clock are combined, they have the same consistency requirement at the
+ * servers. The first thread at a clock becomes the leader: it waits up to window for the other local
+ * threads at this clock to join, fetches the union of their keys, and hands each thread its values.
+ * The threads arriving after the fetch starts form the next batch.
+ *
+ * Thread-safe, shared by the local threads.
+ */
+template <typename Val>
+class GetCombiner : public AbstractGetCombiner {
+ public:
+  // Fetch the values of the keys from the servers and return the min clock tagged on the replies
+  using FetchFunc = std::function<int(const third_party::SArray<Key>&, third_party::SArray<Val>*)>;
+
+  explicit GetCombiner(std::chrono::microseconds window = std::chrono::microseconds(1000)) : window_(window) {}
+
+  virtual void Reset(uint32_t num_threads) override {
+    std::lock_guard<std::mutex> lk(mu_);
+    CHECK(open_batches_.empty());
+    num_threads_ = num_threads;
+  }
+
+  // Get the values of keys at clock, return the min clock tagged on the replies
+  template <typename C>
+  int Get(int clock, const third_party::SArray<Key>& keys, C* vals, const FetchFunc& fetch);
+
+  // The number of Gets and of fetches from the servers, and the keys requested and fetched
+  size_t GetNumGets() const { return num_gets_; }
+  size_t GetNumFetches() const { return num_fetches_; }
+  size_t GetNumKeysRequested() const { return num_keys_requested_; }
+  size_t GetNumKeysFetched() const { return num_keys_fetched_; }
+
+ private:
+  struct Batch {
+    std::vector<third_party::SArray<Key>> keys;
+    bool done = false;
+    third_party::SArray<Key> union_keys;
+    third_party::SArray<Val> union_vals;
+    int reply_clock = 0;
+  };
+
+  const std::chrono::microseconds window_;
+
+  std::mutex mu_;
+  std::condition_variable cond_;
+  std::map<int, std::shared_ptr<Batch>> open_batches_;  // by clock, not fetched yet
+  uint32_t num_threads_ = 0;
+  size_t num_gets_ = 0;
+  size_t num_fetches_ = 0;
+  size_t num_keys_requested_ = 0;
+  size_t num_keys_fetched_ = 0;
+};
+
+template <typename Val>
+template <typename C>
+int GetCombiner<Val>::Get(int clock, const third_party::SArray<Key>& keys, C* vals, const FetchFunc& fetch) {
+  std::unique_lock<std::mutex> lk(mu_);
+  num_gets_ += 1;
+  num_keys_requested_ += keys.size();
+  std::shared_ptr<Batch>& open = open_batches_[clock];
+  const bool is_leader = !open;
+  if (is_leader)
+    open = std::make_shared<Batch>();
+  std::shared_ptr<Batch> batch = open;
+  batch->keys.push_back(keys);
+
+  if (is_leader) {
+    cond_.wait_for(lk, window_, [&]() { return batch->keys.size() >= num_threads_; });
+    open_batches_.erase(clock);
+    std::vector<Key> all;
+    for (const auto& k : batch->keys)
+      all.insert(all.end(), k.begin(), k.end());
+    lk.unlock();
+    std::sort(all.begin(), all.end());
+    all.erase(std::unique(all.begin(), all.end()), all.end());
+    third_party::SArray<Key> union_keys(all);
+    third_party::SArray<Val> union_vals;
+    int reply_clock = fetch(union_keys, &union_vals);
+    CHECK_EQ(union_vals.size(), union_keys.size());
+    lk.lock();
+    batch->union_keys = union_keys;
+    batch->union_vals = union_vals;
+    batch->reply_clock = reply_clock;
+    batch->done = true;
+    num_fetches_ += 1;
+    num_keys_fetched_ += union_keys.size();
+    cond_.notify_all();
+  } else {
+    if (batch->keys.size() >= num_threads_)
+      cond_.notify_all();  // the leader need not wait any longer
+    cond_.wait(lk, [&]() { return batch->done; });
+  }
+  lk.unlock();
+
+  const auto& union_keys = batch->union_keys;
+  vals->resize(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    auto pos = std::lower_bound(union_keys.begin(), union_keys.end(), keys[i]);
+    CHECK(pos != union_keys.end() && *pos == keys[i]);
+    (*vals)[i] = batch->union_vals[pos - union_keys.begin()];
+  }
+  return batch->reply_clock;
+}
+
+}  // namespace flexps
@@ -0,0 +1,79 @@
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+
+#include "worker/get_combiner.hpp"
+
+#include <atomic>
+#include <thread>
+
+namespace flexps {
+namespace {
+
+class TestGetCombiner : public testing::Test {
+ public:
+  TestGetCombiner() {}
+  ~TestGetCombiner() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+// The value of a key is key * 10 + the number of fetches so far
+TEST_F(TestGetCombiner, CombineOverlappingGets) {
+  GetCombiner<int> combiner(std::chrono::seconds(10));
+  const int kNumThreads = 4;
+  combiner.Reset(kNumThreads);
+  std::atomic<int> num_fetches(0);
+  auto fetch = [&num_fetches](const third_party::SArray<Key>& keys, third_party::SArray<int>* vals) {
+    int n = num_fetches++;
+    vals->resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+      (*vals)[i] = keys[i] * 10 + n;
+    return 7;
+  };
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&combiner, &fetch, t]() {
+      third_party::SArray<Key> keys({1, 2, static_cast<Key>(10 + t)});
+      std::vector<int> vals;
+      int reply_clock = combiner.Get(0, keys, &vals, fetch);
+      EXPECT_EQ(reply_clock, 7);
+      ASSERT_EQ(vals.size(), 3);
+      EXPECT_EQ(vals[0], 10);
+      EXPECT_EQ(vals[1], 20);
+      EXPECT_EQ(vals[2], (10 + t) * 10);
+    });
+  }
+  for (auto& th : threads)
+    th.join();
+  // The window is long, the leader fetches once all threads joined
+  EXPECT_EQ(num_fetches, 1);
+  EXPECT_EQ(combiner.GetNumGets(), kNumThreads);
+  EXPECT_EQ(combiner.GetNumFetches(), 1);
+  EXPECT_EQ(combiner.GetNumKeysRequested(), 3 * kNumThreads);
+  EXPECT_EQ(combiner.GetNumKeysFetched(), 2 + kNumThreads);
+}
+
+TEST_F(TestGetCombiner, SeparateClocks) {
+  GetCombiner<int> combiner(std::chrono::microseconds(0));
+  combiner.Reset(2);
+  int num_fetches = 0;
+  auto fetch = [&num_fetches](const third_party::SArray<Key>& keys, third_party::SArray<int>* vals) {
+    num_fetches += 1;
+    vals->resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+      (*vals)[i] = keys[i];
+    return 0;
+  };
+  // Not waiting for the other thread beyond the window
+  third_party::SArray<int> vals;
+  combiner.Get(0, third_party::SArray<Key>({3, 4}), &vals, fetch);
+  combiner.Get(1, third_party::SArray<Key>({4}), &vals, fetch);
+  EXPECT_EQ(num_fetches, 2);
+  ASSERT_EQ(vals.size(), 1);
+  EXPECT_EQ(vals[0], 4);
+}
+
+}  // namespace
+}  // namespace flexps
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "worker/abstract_partition_manager.hpp"
+#include "worker/kvpairs.hpp"
+
+#include "glog/logging.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace flexps {
+
+/*
+ * Partition the keys by consistent hashing, so that clustered keys (e.g. hashed feature ids) are
+ * spread over the server threads. Each server thread owns num_virtual_nodes points on a 32-bit hash
+ * ring, and a key goes to the owner of the first point at or after the hash of the key.
+ *
+ * The keys need not be sorted. Slicing buckets the keys by owner in two linear passes without
+ * sorting, keeping the input order within each slice, and sets the positions of each slice
+ * (the index of each sliced key in the input) to scatter the replies back.
+ * The keys are hashed as given, so the chunk APIs partition by chunk id. Works with MapStorage only,
+ * as a server thread does not own a contiguous range.
+ */
+class HashPartitionManager : public AbstractPartitionManager {
+ public:
+  HashPartitionManager(const std::vector<uint32_t>& server_thread_ids, uint32_t num_virtual_nodes = 64)
+      : AbstractPartitionManager(server_thread_ids) {
+    CHECK(!server_thread_ids_.empty());
+    CHECK_GT(num_virtual_nodes, 0);
+    for (size_t i = 0; i < server_thread_ids_.size(); ++i) {
+      for (uint32_t v = 0; v < num_virtual_nodes; ++v) {
+        ring_.push_back({Hash(server_thread_ids_[i] * 0x10000u + v), static_cast<uint32_t>(i)});
+      }
+    }
+    std::sort(ring_.begin(), ring_.end());
+    // bucket_start_[b] is the first point of the ring in bucket b, so a lookup scans only a few points
+    bucket_start_.resize((1u << kBucketBits) + 1);
+    size_t point = 0;
+    for (uint64_t b = 0; b <= (1u << kBucketBits); ++b) {
+      while (point < ring_.size() && ring_[point].first < (b << (32 - kBucketBits)))
+        ++point;
+      bucket_start_[b] = point;
+    }
+  }
+
+  SlicedKVs Slice(const KVPairs<char>& kvs) const override { return Bucket(kvs); }
+  SlicedKVs SliceChunk(const KVPairs<char>& kvs) const override { return Bucket(kvs); }
+
+  // The index of the owner of key in GetServerThreadIds()
+  uint32_t GetOwnerIndex(Key key) const {
+    uint32_t hash = Hash(key);
+    size_t point = bucket_start_[hash >> (32 - kBucketBits)];
+    while (point < ring_.size() && ring_[point].first < hash)
+      ++point;
+    return point == ring_.size() ? ring_.front().second : ring_[point].second;
+  }
+
+ private:
+  static const uint32_t kBucketBits = 16;
+
+  // murmur3 finalizer
+  static uint32_t Hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x85ebca6b;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35;
+    x ^= x >> 16;
+    return x;
+  }
+
+  SlicedKVs Bucket(const KVPairs<char>& kvs) const {
+    SlicedKVs sliced;
+    const size_t n = kvs.keys.size();
+    if (n == 0)
+      return sliced;
+    const size_t n_servers = server_thread_ids_.size();
+    const size_t width = kvs.vals.size() / n;  // bytes per key, 0 for Get
+    std::vector<uint32_t> owners(n);
+    std::vector<size_t> counts(n_servers, 0);
+    for (size_t i = 0; i < n; ++i) {
+      owners[i] = GetOwnerIndex(kvs.keys[i]);
+      counts[owners[i]] += 1;
+    }
+    std::vector<int> slot(n_servers, -1);
+    for (size_t s = 0; s < n_servers; ++s) {
+      if (counts[s] == 0)
+        continue;
+      slot[s] = sliced.size();
+      KVPairs<char> part;
+      part.keys.resize(counts[s]);
+      part.positions.resize(counts[s]);
+      if (width > 0)
+        part.vals.resize(counts[s] * width);
+      sliced.push_back(std::make_pair(server_thread_ids_[s], std::move(part)));
+      counts[s] = 0;  // reused as the fill count
+    }
+    for (size_t i = 0; i < n; ++i) {
+      const uint32_t s = owners[i];
+      KVPairs<char>& part = sliced[slot[s]].second;
+      const size_t j = counts[s]++;
+      part.keys[j] = kvs.keys[i];
+      part.positions[j] = i;
+      if (width > 0)
+        memcpy(part.vals.data() + j * width, kvs.vals.data() + i * width, width);
+    }
+    return sliced;
+  }
+
+  // (hash, index of server thread) in ascending order of hash
+  std::vector<std::pair<uint32_t, uint32_t>> ring_;
+  std::vector<size_t> bucket_start_;
+};
+
+}  // namespace flexps
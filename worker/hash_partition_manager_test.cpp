@@ -0,0 +1,87 @@
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "worker/hash_partition_manager.hpp"
+
+namespace flexps {
+namespace {
+
+class TestHashPartitionManager : public testing::Test {
+ public:
+  TestHashPartitionManager() {}
+  ~TestHashPartitionManager() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+TEST_F(TestHashPartitionManager, Slice) {
+  HashPartitionManager manager({1000, 1001, 2000});
+  KVPairs<char> kvs;
+  // Unsorted and clustered keys
+  kvs.keys = third_party::SArray<Key>({42, 7, 100, 3, 99, 1000, 5, 6});
+  third_party::SArray<int> vals({0, 1, 2, 3, 4, 5, 6, 7});
+  kvs.vals = third_party::SArray<char>(vals);
+  auto sliced = manager.Slice(kvs);
+
+  size_t total = 0;
+  std::vector<bool> seen(kvs.keys.size(), false);
+  for (const auto& slice : sliced) {
+    const auto& part = slice.second;
+    ASSERT_EQ(part.positions.size(), part.keys.size());
+    third_party::SArray<int> part_vals(part.vals);
+    ASSERT_EQ(part_vals.size(), part.keys.size());
+    for (size_t i = 0; i < part.keys.size(); ++i) {
+      uint32_t pos = part.positions[i];
+      EXPECT_EQ(part.keys[i], kvs.keys[pos]);
+      EXPECT_EQ(part_vals[i], vals[pos]);
+      EXPECT_EQ(slice.first, manager.GetServerThreadIds()[manager.GetOwnerIndex(part.keys[i])]);
+      // The input order is kept within a slice
+      if (i > 0) {
+        EXPECT_LT(part.positions[i - 1], pos);
+      }
+      seen[pos] = true;
+    }
+    total += part.keys.size();
+  }
+  EXPECT_EQ(total, kvs.keys.size());
+  EXPECT_EQ(std::count(seen.begin(), seen.end(), true), kvs.keys.size());
+
+  // Get has no vals
+  KVPairs<char> get_kvs;
+  get_kvs.keys = kvs.keys;
+  for (const auto& slice : manager.Slice(get_kvs))
+    EXPECT_TRUE(slice.second.vals.empty());
+}
+
+TEST_F(TestHashPartitionManager, Balance) {
+  HashPartitionManager manager({0, 1, 2, 3}, 128);
+  std::vector<int> counts(4, 0);
+  // Keys clustered in a small sub-range
+  for (Key key = 5000; key < 45000; ++key)
+    counts[manager.GetOwnerIndex(key)] += 1;
+  for (auto count : counts) {
+    EXPECT_GT(count, 10000 * 0.7);
+    EXPECT_LT(count, 10000 * 1.3);
+  }
+}
+
+TEST_F(TestHashPartitionManager, Consistent) {
+  HashPartitionManager manager3({0, 1, 2}, 128);
+  HashPartitionManager manager4({0, 1, 2, 3}, 128);
+  // Adding a server thread only moves keys to the new one
+  int moved = 0;
+  for (Key key = 0; key < 10000; ++key) {
+    uint32_t owner3 = manager3.GetServerThreadIds()[manager3.GetOwnerIndex(key)];
+    uint32_t owner4 = manager4.GetServerThreadIds()[manager4.GetOwnerIndex(key)];
+    if (owner3 != owner4) {
+      EXPECT_EQ(owner4, 3);
+      moved += 1;
+    }
+  }
+  EXPECT_LT(moved, 10000 * 0.4);
+}
+
+}  // namespace
+}  // namespace flexps
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "worker/abstract_partition_manager.hpp"
+#include "worker/kvpairs.hpp"
+
+#include "glog/logging.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace flexps {
+
+/*
+ * Route the Gets of hot keys to a local replica, on top of another partition manager.
+ *
+ * The owner server threads announce their hot keys (see SSPModel::EnableHotKeyReplication) to the
+ * worker helper thread, which calls UpdateHotKeys() while the app threads are slicing. The hot keys
+ * of an owner are sent to the local server thread chosen by the owner id, so that the Gets of
+ * different owners are spread over the local server threads. Adds are always sliced to the owners.
+ */
+class HotKeyPartitionManager : public AbstractPartitionManager {
+ public:
+  HotKeyPartitionManager(std::unique_ptr<AbstractPartitionManager>&& base,
+                         const std::vector<uint32_t>& local_server_thread_ids)
+      : AbstractPartitionManager(base->GetServerThreadIds()),
+        base_(std::move(base)),
+        local_server_thread_ids_(local_server_thread_ids),
+        hot_keys_(std::make_shared<HotKeys>()) {
+    CHECK(!local_server_thread_ids_.empty());
+  }
+
+  SlicedKVs Slice(const KVPairs<char>& kvs) const override { return base_->Slice(kvs); }
+  SlicedKVs SliceChunk(const KVPairs<char>& kvs) const override { return base_->SliceChunk(kvs); }
+
+  SlicedKVs SliceGet(const KVPairs<char>& kvs, std::vector<int>* replica_of) const override {
+    SlicedKVs sliced = base_->Slice(kvs);
+    replica_of->assign(sliced.size(), -1);
+    std::shared_ptr<const HotKeys> hot_keys = std::atomic_load(&hot_keys_);
+    if (hot_keys->empty())
+      return sliced;
+
+    size_t num_slices = sliced.size();
+    for (size_t i = 0; i < num_slices; ++i) {
+      uint32_t owner = sliced[i].first;
+      uint32_t replica = local_server_thread_ids_[owner % local_server_thread_ids_.size()];
+      if (replica == owner)
+        continue;
+      const auto& keys = sliced[i].second.keys;
+      third_party::SArray<Key> cold, hot;
+      for (auto key : keys) {
+        if (hot_keys->find(key) == hot_keys->end())
+          cold.push_back(key);
+        else
+          hot.push_back(key);
+      }
+      if (hot.empty())
+        continue;
+      if (cold.empty()) {  // the whole slice goes to the replica
+        sliced[i].first = replica;
+        (*replica_of)[i] = owner;
+      } else {
+        sliced[i].second.keys = cold;
+        KVPairs<char> hot_kvs;
+        hot_kvs.keys = hot;
+        sliced.push_back(std::make_pair(replica, std::move(hot_kvs)));
+        replica_of->push_back(owner);
+      }
+    }
+    return sliced;
+  }
+
+  // Replace the hot keys of owner, thread-safe
+  void UpdateHotKeys(uint32_t owner, const third_party::SArray<Key>& keys) {
+    std::lock_guard<std::mutex> lk(mu_);
+    owner_hot_keys_[owner] = keys;
+    std::shared_ptr<HotKeys> hot_keys = std::make_shared<HotKeys>();
+    for (const auto& kv : owner_hot_keys_) {
+      hot_keys->insert(kv.second.begin(), kv.second.end());
+    }
+    std::atomic_store(&hot_keys_, std::shared_ptr<const HotKeys>(hot_keys));
+  }
+
+  const AbstractPartitionManager* GetBase() const { return base_.get(); }
+
+ private:
+  using HotKeys = std::unordered_set<Key>;
+
+  std::unique_ptr<AbstractPartitionManager> base_;
+  std::vector<uint32_t> local_server_thread_ids_;
+
+  std::mutex mu_;
+  std::map<uint32_t, third_party::SArray<Key>> owner_hot_keys_;
+  // The hot keys of all owners, accessed with std::atomic_load/std::atomic_store
+  std::shared_ptr<const HotKeys> hot_keys_;
+};
+
+}  // namespace flexps
@@ -0,0 +1,107 @@
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "worker/fake_callback_runner.hpp"
+#include "worker/hot_key_partition_manager.hpp"
+#include "worker/kv_client_table.hpp"
+#include "worker/simple_range_manager.hpp"
+
+#include <thread>
+
+namespace flexps {
+namespace {
+
+class TestHotKeyPartitionManager : public testing::Test {
+ public:
+  TestHotKeyPartitionManager() {}
+  ~TestHotKeyPartitionManager() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+const uint32_t kTestAppThreadId = 15;
+const uint32_t kTestModelId = 23;
+
+std::unique_ptr<AbstractPartitionManager> CreateRangeManager() {
+  // server 0: [0, 10), server 1: [10, 20), server 1000 (remote): [20, 30)
+  return std::unique_ptr<AbstractPartitionManager>(
+      new SimpleRangePartitionManager({{0, 10}, {10, 20}, {20, 30}}, {0, 1, 1000}));
+}
+
+TEST_F(TestHotKeyPartitionManager, NoHotKeys) {
+  HotKeyPartitionManager manager(CreateRangeManager(), {0, 1});
+  KVPairs<char> kvs;
+  kvs.keys = third_party::SArray<Key>({3, 12, 25});
+  std::vector<int> replica_of;
+  auto sliced = manager.SliceGet(kvs, &replica_of);
+  ASSERT_EQ(sliced.size(), 3);
+  EXPECT_EQ(replica_of, std::vector<int>({-1, -1, -1}));
+}
+
+TEST_F(TestHotKeyPartitionManager, SliceGet) {
+  HotKeyPartitionManager manager(CreateRangeManager(), {0, 1});
+  manager.UpdateHotKeys(1000, third_party::SArray<Key>({22, 25}));
+  manager.UpdateHotKeys(1, third_party::SArray<Key>({12}));
+  KVPairs<char> kvs;
+  kvs.keys = third_party::SArray<Key>({3, 12, 22, 24, 25});
+  std::vector<int> replica_of;
+  auto sliced = manager.SliceGet(kvs, &replica_of);
+  // {3} -> 0, {12} -> 1 (the owner is local), {24} -> 1000, {22, 25} -> replica 0 (1000 % 2)
+  ASSERT_EQ(sliced.size(), 4);
+  EXPECT_EQ(replica_of, std::vector<int>({-1, -1, -1, 1000}));
+  EXPECT_EQ(sliced[1].first, 1);
+  EXPECT_EQ(sliced[2].first, 1000);
+  ASSERT_EQ(sliced[2].second.keys.size(), 1);
+  EXPECT_EQ(sliced[2].second.keys[0], 24);
+  EXPECT_EQ(sliced[3].first, 0);
+  ASSERT_EQ(sliced[3].second.keys.size(), 2);
+  EXPECT_EQ(sliced[3].second.keys[0], 22);
+  EXPECT_EQ(sliced[3].second.keys[1], 25);
+
+  // Adds always go to the owners
+  kvs.vals = third_party::SArray<float>({0.1, 0.1, 0.1, 0.1, 0.1});
+  auto sliced_add = manager.Slice(kvs);
+  ASSERT_EQ(sliced_add.size(), 3);
+  EXPECT_EQ(sliced_add[2].first, 1000);
+  EXPECT_EQ(sliced_add[2].second.keys.size(), 3);
+}
+
+TEST_F(TestHotKeyPartitionManager, GetFromReplica) {
+  ThreadsafeQueue<Message> queue;
+  HotKeyPartitionManager manager(CreateRangeManager(), {0, 1});
+  manager.UpdateHotKeys(1000, third_party::SArray<Key>({22}));
+  FakeCallbackRunner callback_runner(kTestAppThreadId, kTestModelId);
+  std::thread th([&queue, &manager, &callback_runner]() {
+    KVClientTable<float> table(kTestAppThreadId, kTestModelId, &queue, &manager, &callback_runner);
+    std::vector<Key> keys = {21, 22, 23};
+    std::vector<float> vals;
+    table.Get(keys, &vals);  // {21, 23} -> 1000, {22} -> replica 0
+    std::vector<float> expected{0.1, 0.2, 0.3};
+    EXPECT_EQ(vals, expected);
+  });
+  Message m1, m2;
+  queue.WaitAndPop(&m1);
+  queue.WaitAndPop(&m2);
+  EXPECT_EQ(m1.meta.recver, 1000);
+  EXPECT_EQ(m1.meta.flag, Flag::kGet);
+  ASSERT_EQ(m1.data.size(), 1);
+  EXPECT_EQ(m2.meta.recver, 0);
+  EXPECT_EQ(m2.meta.flag, Flag::kGetReplica);
+  ASSERT_EQ(m2.data.size(), 2);
+  EXPECT_EQ(third_party::SArray<uint32_t>(m2.data[1])[0], 1000);
+
+  // The replies interleave in keys
+  Message r1, r2;
+  r1.AddData(third_party::SArray<Key>({22}));
+  r1.AddData(third_party::SArray<float>({0.2}));
+  r2.AddData(third_party::SArray<Key>({21, 23}));
+  r2.AddData(third_party::SArray<float>({0.1, 0.3}));
+  callback_runner.AddResponse(r1);
+  callback_runner.AddResponse(r2);
+  th.join();
+}
+
+}  // namespace
+}  // namespace flexps
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "base/magic.hpp"
+#include "base/third_party/sarray.h"
+
+#include <numeric>
+#include <vector>
+
+namespace flexps {
+
+/*
+ * Sort the keys of a Get or an Add that may be unsorted and have duplicates, see KVClientTable::GetUnsorted.
+ * *unique_keys gets the distinct keys in ascending order, and (*index)[i] the position of keys[i] in it.
+ *
+ * An LSD radix sort of the 32-bit keys with 8-bit digits, which carries the original positions along.
+ * The digits that are the same in all the keys are skipped, so a small key space takes fewer passes.
+ */
+inline void SortUniqueKeys(const Key* keys, size_t num_keys, third_party::SArray<Key>* unique_keys,
+                           std::vector<uint32_t>* index) {
+  static_assert(sizeof(Key) == 4, "the radix sort assumes 32-bit keys");
+  std::vector<Key> sorted(keys, keys + num_keys), sorted_tmp(num_keys);
+  std::vector<uint32_t> perm(num_keys), perm_tmp(num_keys);
+  std::iota(perm.begin(), perm.end(), 0);
+  Key diff = 0;
+  for (size_t i = 1; i < num_keys; ++i)
+    diff |= keys[i] ^ keys[0];
+
+  for (int shift = 0; shift < 32; shift += 8) {
+    if (((diff >> shift) & 0xff) == 0)
+      continue;
+    size_t count[257] = {0};
+    for (size_t i = 0; i < num_keys; ++i)
+      count[((sorted[i] >> shift) & 0xff) + 1] += 1;
+    for (int d = 0; d < 256; ++d)
+      count[d + 1] += count[d];
+    for (size_t i = 0; i < num_keys; ++i) {
+      size_t dst = count[(sorted[i] >> shift) & 0xff]++;
+      sorted_tmp[dst] = sorted[i];
+      perm_tmp[dst] = perm[i];
+    }
+    sorted.swap(sorted_tmp);
+    perm.swap(perm_tmp);
+  }
+
+  third_party::SArray<Key> unique(num_keys);
+  index->resize(num_keys);
+  size_t num_unique = 0;
+  for (size_t i = 0; i < num_keys; ++i) {
+    if (i == 0 || sorted[i] != sorted[i - 1])
+      unique[num_unique++] = sorted[i];
+    (*index)[perm[i]] = num_unique - 1;
+  }
+  unique.resize(num_unique);
+  *unique_keys = unique;
+}
+
+}  // namespace flexps
@@ -0,0 +1,62 @@
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+
+#include "worker/key_sorter.hpp"
+
+#include <algorithm>
+#include <random>
+
+namespace flexps {
+namespace {
+
+class TestKeySorter : public testing::Test {
+ public:
+  TestKeySorter() {}
+  ~TestKeySorter() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+TEST_F(TestKeySorter, SortUnique) {
+  std::vector<Key> keys{7, 3, 7, 1 << 20, 0, 3, 300};
+  third_party::SArray<Key> unique_keys;
+  std::vector<uint32_t> index;
+  SortUniqueKeys(keys.data(), keys.size(), &unique_keys, &index);
+  ASSERT_EQ(unique_keys.size(), 5);
+  EXPECT_EQ(std::vector<Key>(unique_keys.begin(), unique_keys.end()), std::vector<Key>({0, 3, 7, 300, 1 << 20}));
+  EXPECT_EQ(index, std::vector<uint32_t>({2, 1, 2, 4, 0, 1, 3}));
+}
+
+TEST_F(TestKeySorter, Random) {
+  std::mt19937 gen(0);
+  for (Key max_key : {Key(100), Key(70000), std::numeric_limits<Key>::max()}) {
+    std::uniform_int_distribution<Key> dist(0, max_key);
+    std::vector<Key> keys(2000);
+    for (auto& k : keys)
+      k = dist(gen);
+    third_party::SArray<Key> unique_keys;
+    std::vector<uint32_t> index;
+    SortUniqueKeys(keys.data(), keys.size(), &unique_keys, &index);
+
+    std::vector<Key> expected(keys);
+    std::sort(expected.begin(), expected.end());
+    expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+    EXPECT_EQ(std::vector<Key>(unique_keys.begin(), unique_keys.end()), expected);
+    ASSERT_EQ(index.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+      EXPECT_EQ(unique_keys[index[i]], keys[i]);
+  }
+}
+
+TEST_F(TestKeySorter, Empty) {
+  third_party::SArray<Key> unique_keys;
+  std::vector<uint32_t> index;
+  SortUniqueKeys(nullptr, 0, &unique_keys, &index);
+  EXPECT_EQ(unique_keys.size(), 0);
+  EXPECT_EQ(index.size(), 0);
+}
+
+}  // namespace
+}  // namespace flexps
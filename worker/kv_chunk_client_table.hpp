@@ -29,40 +29,94 @@ class KVChunkClientTable: public KVClientTable<Val> {
   // The chunk version, it will tranform 2-dimension vector to 1-dimension one
   void AddChunk(const std::vector<Key>& keys, const std::vector<std::vector<Val>>& chunk_vals);
   void GetChunk(const std::vector<Key>& keys, std::vector<std::vector<Val>*>& chunk_vals);
+  /*
+   * The flat versions, the chunk of keys[i] is the chunk_size values at vals + i * row_stride, e.g. the rows
+   * of an embedding matrix. AddChunk copies the rows into the message once, GetChunk writes the replies
+   * directly into the rows.
+   */
+  void AddChunk(const std::vector<Key>& keys, const Val* vals, size_t chunk_size, size_t row_stride);
+  void GetChunk(const std::vector<Key>& keys, Val* vals, size_t chunk_size, size_t row_stride);
+  // The SArray versions with row-major chunks, AddChunk sends vals without copying
+  void AddChunk(const third_party::SArray<Key>& keys, const third_party::SArray<Val>& vals);
+  void GetChunk(const third_party::SArray<Key>& keys, third_party::SArray<Val>* vals);
 
+ private:
+  // Send the Get of the chunks of keys and wait for the replies, which finish assembles
+  template <typename F>
+  void GetChunk_(const third_party::SArray<Key>& keys, F finish);
 };
 // chunk version Add
 template <typename Val>
 void KVChunkClientTable<Val>::AddChunk(const std::vector<Key>& keys, const std::vector<std::vector<Val>>& chunk_vals){
   CHECK_EQ(keys.size(), chunk_vals.size());
   CHECK(!chunk_vals.empty());
-  int key_size = keys.size();
-  int chunk_size = chunk_vals[0].size();
-  std::vector<Val> vector_chunk_vals(key_size * chunk_size);
-  for (int i = 0; i < key_size; i++){
-    for (int j = 0; j < chunk_size; j++){
-      vector_chunk_vals[i * chunk_size + j] = chunk_vals[i][j];
-    }
+  size_t chunk_size = chunk_vals[0].size();
+  third_party::SArray<Val> flat_vals(keys.size() * chunk_size);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    CHECK_EQ(chunk_vals[i].size(), chunk_size);
+    memcpy(flat_vals.data() + i * chunk_size, chunk_vals[i].data(), chunk_size * sizeof(Val));
   }
-  KVClientTable<Val>::kv_table_box_.AddChunk(third_party::SArray<Key>(keys), third_party::SArray<Val>(vector_chunk_vals));
+  kv_table_box_.AddChunk(third_party::SArray<Key>(keys), flat_vals);
+}
+
+template <typename Val>
+void KVChunkClientTable<Val>::AddChunk(const std::vector<Key>& keys, const Val* vals, size_t chunk_size,
+                                       size_t row_stride) {
+  CHECK(!keys.empty());
+  CHECK_LE(chunk_size, row_stride);
+  third_party::SArray<Val> flat_vals;
+  if (chunk_size == row_stride) {
+    flat_vals.CopyFrom(vals, keys.size() * chunk_size);
+  } else {
+    flat_vals.resize(keys.size() * chunk_size);
+    for (size_t i = 0; i < keys.size(); ++i)
+      memcpy(flat_vals.data() + i * chunk_size, vals + i * row_stride, chunk_size * sizeof(Val));
+  }
+  kv_table_box_.AddChunk(third_party::SArray<Key>(keys), flat_vals);
+}
+
+template <typename Val>
+void KVChunkClientTable<Val>::AddChunk(const third_party::SArray<Key>& keys, const third_party::SArray<Val>& vals) {
+  CHECK(!keys.empty());
+  CHECK_EQ(vals.size() % keys.size(), 0);
+  kv_table_box_.AddChunk(keys, vals);
 }
 
 template <typename Val>
 void KVChunkClientTable<Val>::GetChunk(const std::vector<Key>& keys, std::vector<std::vector<Val>*>& chunk_vals){
+  third_party::SArray<Key> sarray_keys(keys);
+  GetChunk_(sarray_keys, [&]() { kv_table_box_.HandleChunkFinish(sarray_keys, chunk_vals); });
+}
+
+template <typename Val>
+void KVChunkClientTable<Val>::GetChunk(const std::vector<Key>& keys, Val* vals, size_t chunk_size,
+                                       size_t row_stride) {
+  third_party::SArray<Key> sarray_keys(keys);
+  GetChunk_(sarray_keys, [&]() { kv_table_box_.HandleChunkFinish(sarray_keys, vals, chunk_size, row_stride); });
+}
+
+template <typename Val>
+void KVChunkClientTable<Val>::GetChunk(const third_party::SArray<Key>& keys, third_party::SArray<Val>* vals) {
+  GetChunk_(keys, [&]() { kv_table_box_.HandleChunkFinish(keys, vals); });
+}
+
+template <typename Val>
+template <typename F>
+void KVChunkClientTable<Val>::GetChunk_(const third_party::SArray<Key>& keys, F finish) {
   KVPairs<char> kvs;
   kvs.keys = keys;
   // 1. slice
   SlicedKVs sliced = kv_table_box_.SliceChunk(kvs);
-  // 2. register handle
-  callback_runner_->RegisterRecvFinishHandle(kv_table_box_.app_thread_id_, kv_table_box_.model_id_,
-                                             [&]() { kv_table_box_.HandleChunkFinish(third_party::SArray<Key>(keys), chunk_vals); });
+  // 2. register handle, the replies are assembled on this thread, see KVClientTable::Fetch
+  callback_runner_->RegisterRecvFinishHandle(kv_table_box_.app_thread_id_, kv_table_box_.model_id_, []() {});
   // 3. add request
   int num_reqs = sliced.size();
   callback_runner_->NewRequest(kv_table_box_.app_thread_id_, kv_table_box_.model_id_, num_reqs);
   // 4. send
-  kv_table_box_.SendChunk(sliced, false);
+  kv_table_box_.SendChunk(sliced, false, kvs.keys);
   // 5. wait request
   callback_runner_->WaitRequest(kv_table_box_.app_thread_id_, kv_table_box_.model_id_);
+  finish();
 }
 
 } //namespace flexps
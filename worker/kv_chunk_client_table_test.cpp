@@ -149,5 +149,49 @@ TEST_F(TestKVChunkClientTable, VectorChunkGet) {
   th.join();
 }
 
+TEST_F(TestKVChunkClientTable, FlatChunkAdd) {
+  ThreadsafeQueue<Message> queue;
+  SimpleRangePartitionManager manager({{0, 40}, {40, 80}}, {0, 1}, 10);
+  FakeCallbackRunner callback_runner(kTestAppThreadId, kTestModelId);
+  KVChunkClientTable<float> table(kTestAppThreadId, kTestModelId, &queue, &manager, &callback_runner);
+  // 2 rows of 3 values, with 1 padding value per row
+  std::vector<float> matrix = {1, 2, 3, -1, 4, 5, 6, -1};
+  table.AddChunk(std::vector<Key>({3, 5}), matrix.data(), 3, 4);  // {3, 5} -> {3}, {5}
+  Message m1, m2;
+  queue.WaitAndPop(&m1);
+  queue.WaitAndPop(&m2);
+  EXPECT_EQ(m1.meta.flag, Flag::kAddChunk);
+  ASSERT_EQ(m1.data.size(), 2);
+  third_party::SArray<float> res_vals(m1.data[1]);
+  EXPECT_EQ(std::vector<float>(res_vals.begin(), res_vals.end()), std::vector<float>({1, 2, 3}));
+  res_vals = m2.data[1];
+  EXPECT_EQ(std::vector<float>(res_vals.begin(), res_vals.end()), std::vector<float>({4, 5, 6}));
+}
+
+TEST_F(TestKVChunkClientTable, FlatChunkGet) {
+  ThreadsafeQueue<Message> queue;
+  SimpleRangePartitionManager manager({{0, 40}, {40, 80}}, {0, 1}, 10);
+  FakeCallbackRunner callback_runner(kTestAppThreadId, kTestModelId);
+  std::thread th([&queue, &manager, &callback_runner]() {
+    KVChunkClientTable<float> table(kTestAppThreadId, kTestModelId, &queue, &manager, &callback_runner);
+    // The rows of an embedding matrix with a stride of 3 for chunks of 2
+    std::vector<float> matrix(9, -1);
+    table.GetChunk(std::vector<Key>({3, 4, 5}), matrix.data(), 2, 3);  // {3, 4, 5} -> {3}, {4, 5}
+    EXPECT_EQ(matrix, std::vector<float>({0.3, 0.3, -1, 0.4, 0.4, -1, 0.5, 0.5, -1}));
+  });
+  Message m1, m2;
+  queue.WaitAndPop(&m1);
+  queue.WaitAndPop(&m2);
+  // Key-less replies
+  Message r1, r2;
+  r2.meta.req_id = m2.meta.req_id;
+  r2.AddData(third_party::SArray<float>({0.4, 0.4, 0.5, 0.5}));
+  r1.meta.req_id = m1.meta.req_id;
+  r1.AddData(third_party::SArray<float>({0.3, 0.3}));
+  callback_runner.AddResponse(r2);
+  callback_runner.AddResponse(r1);
+  th.join();
+}
+
 }  // namespace
 }  // namespace flexps
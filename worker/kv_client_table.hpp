@@ -4,23 +4,38 @@
 
 #include "worker/abstract_callback_runner.hpp"
 #include "worker/abstract_partition_manager.hpp"
+#include "worker/get_combiner.hpp"
+#include "worker/key_sorter.hpp"
+#include "worker/node_cache.hpp"
+#include "worker/update_buffer.hpp"
+
+#include <cstring>
+#include <memory>
 
 namespace flexps {
 
 /*
  * Get (optional) -> Add (optional) -> Clock ->
  *
- * Do not need to protect HandleMsg and HandleFinish since:
- * 1. Now we assume only 1 background thread using app_blocker
- * 2. The Get() call will always wait for the result
- * If we add more background threads later, we need to lock this.
+ * The replies are handled by the worker helper thread, KVTableBox keeps the replies of the outstanding
+ * Gets apart by their request ids.
+ *
+ * With a NodeCache (SSP tables only), a Get reads the keys fresh enough from the cache shared by the
+ * threads of the node, and only fetches the misses from the servers.
  *
+ * With an UpdateBuffer, the Adds are merged locally and sent as one message per server when
+ * flushed, and the Clocks are held after them, see UpdateBufferOptions. With an AddCombiner, the Adds
+ * of the threads of the node are summed before they are sent. With a GetCombiner, the concurrent Gets
+ * of the threads of the node at the same clock are fetched together.
  */
 template <typename Val>
 class KVClientTable {
  public:
   KVClientTable(uint32_t app_thread_id, uint32_t model_id, ThreadsafeQueue<Message>* const send_queue,
-                const AbstractPartitionManager* const partition_manager, AbstractCallbackRunner* const callback_runner);
+                const AbstractPartitionManager* const partition_manager, AbstractCallbackRunner* const callback_runner,
+                NodeCache<Val>* const node_cache = nullptr, AddCombiner<Val>* const add_combiner = nullptr,
+                GetCombiner<Val>* const get_combiner = nullptr);
+  ~KVClientTable();
   KVClientTable(const KVClientTable&) = delete;
   KVClientTable& operator=(const KVClientTable&) = delete;
   KVClientTable(KVClientTable&& other) = delete;
@@ -35,14 +50,68 @@ class KVClientTable {
 
   void Clock();
 
+  /*
+   * The keys may be in any order and have duplicates. The distinct keys are sorted (see worker/key_sorter.hpp)
+   * and sent once: GetUnsorted scatters the values back to the order of keys, AddUnsorted sums the values
+   * of the duplicate keys.
+   */
+  void GetUnsorted(const std::vector<Key>& keys, std::vector<Val>* vals);
+  void GetUnsorted(const third_party::SArray<Key>& keys, third_party::SArray<Val>* vals);
+  void AddUnsorted(const std::vector<Key>& keys, const std::vector<Val>& vals);
+  void AddUnsorted(const third_party::SArray<Key>& keys, const third_party::SArray<Val>& vals);
+
+  /*
+   * Get the values as a view over the received replies, without assembling them into an array,
+   * see worker/kv_view.hpp. GetView reads the servers directly, not through the node cache or the get combiner.
+   */
+  void GetView(const std::vector<Key>& keys, KVView<Val>* view);
+  void GetView(const third_party::SArray<Key>& keys, KVView<Val>* view);
+
+  /*
+   * The asynchronous versions, so that the next Get can be in flight while computing on the current one.
+   * Several requests may be outstanding, *vals must stay alive until Wait(handle) returns.
+   * GetAsync reads the servers directly, not through the node cache or the get combiner.
+   * The Adds are never waited for, AddAsync is Add and returns a completed handle.
+   */
+  using Handle = uint32_t;
+  Handle GetAsync(const std::vector<Key>& keys, std::vector<Val>* vals);
+  Handle GetAsync(const third_party::SArray<Key>& keys, third_party::SArray<Val>* vals);
+  Handle AddAsync(const third_party::SArray<Key>& keys, const third_party::SArray<Val>& vals);
+  void Wait(Handle handle);
+
+  // Buffer the Adds and Clocks from now on, see worker/update_buffer.hpp and KVEngine::EnableUpdateBuffer
+  void EnableUpdateBuffer(const UpdateBufferOptions& options);
+  // Send the buffered Adds, then the held Clocks
+  void Flush();
+
   using SlicedKVs = AbstractPartitionManager::SlicedKVs;
 
  protected:
   template <typename C>
   void Get_(const third_party::SArray<Key>& keys, C* vals);
+  // Get through the get combiner if any, reply_clock is set to the min clock tagged on the replies if given
+  template <typename C>
+  void GetFromServers(const third_party::SArray<Key>& keys, C* vals, int* reply_clock = nullptr);
+  template <typename C>
+  void Fetch(const third_party::SArray<Key>& keys, C* vals);
+  template <typename C>
+  void GetUnsorted_(const Key* keys, size_t num_keys, C* vals);
+  void AddUnsorted_(const Key* keys, size_t num_keys, const Val* vals, size_t num_vals);
+  void FlushAdds();
+  template <typename C>
+  Handle GetAsync_(const third_party::SArray<Key>& keys, C* vals);
 
   // Not owned.
   AbstractCallbackRunner* const callback_runner_;
+  // Not owned, may be nullptr.
+  NodeCache<Val>* const node_cache_;
+  // Not owned, may be nullptr.
+  GetCombiner<Val>* const get_combiner_;
+
+  std::unique_ptr<UpdateBuffer<Val>> update_buffer_;
+  UpdateBufferOptions update_buffer_options_;
+  // Whether an Add is buffered after the last Clock
+  bool adds_since_clock_ = false;
 
   // Most of the operations are delegated to KVTableBox
   KVTableBox<Val> kv_table_box_;
@@ -51,22 +120,40 @@ class KVClientTable {
 template <typename Val>
 KVClientTable<Val>::KVClientTable(uint32_t app_thread_id, uint32_t model_id, ThreadsafeQueue<Message>* const send_queue,
                                   const AbstractPartitionManager* const partition_manager,
-                                  AbstractCallbackRunner* const callback_runner)
-    : kv_table_box_(app_thread_id, model_id, send_queue, partition_manager), callback_runner_(callback_runner) {
+                                  AbstractCallbackRunner* const callback_runner, NodeCache<Val>* const node_cache,
+                                  AddCombiner<Val>* const add_combiner, GetCombiner<Val>* const get_combiner)
+    : kv_table_box_(app_thread_id, model_id, send_queue, partition_manager, add_combiner),
+      callback_runner_(callback_runner),
+      node_cache_(node_cache),
+      get_combiner_(get_combiner) {
   callback_runner_->RegisterRecvHandle(kv_table_box_.app_thread_id_, kv_table_box_.model_id_,
                                        [&](Message& msg) { kv_table_box_.HandleMsg(msg); });
 }
 
+template <typename Val>
+KVClientTable<Val>::~KVClientTable() {
+  CHECK(!adds_since_clock_) << "The buffered Adds after the last Clock() would not be in any clock";
+  Flush();
+}
+
 // vector version Add
 template <typename Val>
 void KVClientTable<Val>::Add(const std::vector<Key>& keys, const std::vector<Val>& vals) {
-  kv_table_box_.Add(third_party::SArray<Key>(keys), third_party::SArray<Val>(vals));
+  Add(third_party::SArray<Key>(keys), third_party::SArray<Val>(vals));
 }
 
 // SArray version Add
 template <typename Val>
 void KVClientTable<Val>::Add(const third_party::SArray<Key>& keys, const third_party::SArray<Val>& vals) {
-  kv_table_box_.Add(third_party::SArray<Key>(keys), third_party::SArray<Val>(vals));
+  if (!update_buffer_) {
+    kv_table_box_.Add(third_party::SArray<Key>(keys), third_party::SArray<Val>(vals));
+    return;
+  }
+  update_buffer_->Add(keys, vals);
+  adds_since_clock_ = true;
+  // Sending the Adds ahead of their Clocks is safe, they only reach the servers earlier
+  if (update_buffer_->GetBytes() >= update_buffer_options_.max_bytes)
+    FlushAdds();
 }
 
 // vector version Get
@@ -85,25 +172,216 @@ void KVClientTable<Val>::Get(const third_party::SArray<Key>& keys, third_party::
 template <typename Val>
 template <typename C>
 void KVClientTable<Val>::Get_(const third_party::SArray<Key>& keys, C* vals) {
+  if (node_cache_ == nullptr) {
+    GetFromServers(keys, vals);
+    return;
+  }
+  vals->resize(keys.size());
+  third_party::SArray<Key> miss_keys;
+  std::vector<uint32_t> miss_positions;
+  node_cache_->Lookup(keys, kv_table_box_.GetClock(), vals->data(), &miss_keys, &miss_positions);
+  if (miss_keys.empty())
+    return;
+  third_party::SArray<Val> miss_vals;
+  int reply_clock;
+  GetFromServers(miss_keys, &miss_vals, &reply_clock);
+  CHECK_EQ(miss_vals.size(), miss_keys.size());
+  node_cache_->Update(miss_keys, miss_vals.data(), reply_clock);
+  for (size_t i = 0; i < miss_positions.size(); ++i)
+    (*vals)[miss_positions[i]] = miss_vals[i];
+}
+
+template <typename Val>
+template <typename C>
+void KVClientTable<Val>::GetFromServers(const third_party::SArray<Key>& keys, C* vals, int* reply_clock) {
+  if (get_combiner_ == nullptr) {
+    Fetch(keys, vals);
+    if (reply_clock)
+      *reply_clock = kv_table_box_.TakeReplyClock();
+    return;
+  }
+  auto fetch = [this](const third_party::SArray<Key>& union_keys, third_party::SArray<Val>* union_vals) {
+    Fetch(union_keys, union_vals);
+    return kv_table_box_.TakeReplyClock();
+  };
+  int clock = get_combiner_->Get(kv_table_box_.GetClock(), keys, vals, fetch);
+  if (reply_clock)
+    *reply_clock = clock;
+}
+
+template <typename Val>
+template <typename C>
+void KVClientTable<Val>::Fetch(const third_party::SArray<Key>& keys, C* vals) {
   KVPairs<char> kvs;
   kvs.keys = keys;
   // 1. slice
-  SlicedKVs sliced = kv_table_box_.Slice(kvs);
-  // 2. register handle
-  callback_runner_->RegisterRecvFinishHandle(kv_table_box_.app_thread_id_, kv_table_box_.model_id_,
-                                             [&]() { kv_table_box_.HandleFinish(keys, vals); });
+  std::vector<int> replica_of;
+  SlicedKVs sliced = kv_table_box_.SliceGet(kvs, &replica_of);
+  // 2. register handle, the replies are assembled on this thread to offload the worker helper thread
+  callback_runner_->RegisterRecvFinishHandle(kv_table_box_.app_thread_id_, kv_table_box_.model_id_, []() {});
   // 3. add request
   int num_reqs = sliced.size();
   callback_runner_->NewRequest(kv_table_box_.app_thread_id_, kv_table_box_.model_id_, num_reqs);
   // 4. send
-  kv_table_box_.Send(sliced, false);
+  uint32_t request_id = kv_table_box_.SendGet(keys, sliced, replica_of);
   // 5. wait request
   callback_runner_->WaitRequest(kv_table_box_.app_thread_id_, kv_table_box_.model_id_);
+  kv_table_box_.HandleFinish(request_id, keys, vals);
+}
+
+template <typename Val>
+void KVClientTable<Val>::GetUnsorted(const std::vector<Key>& keys, std::vector<Val>* vals) {
+  GetUnsorted_(keys.data(), keys.size(), vals);
+}
+
+template <typename Val>
+void KVClientTable<Val>::GetUnsorted(const third_party::SArray<Key>& keys, third_party::SArray<Val>* vals) {
+  GetUnsorted_(keys.data(), keys.size(), vals);
+}
+
+template <typename Val>
+template <typename C>
+void KVClientTable<Val>::GetUnsorted_(const Key* keys, size_t num_keys, C* vals) {
+  CHECK_NOTNULL(vals);
+  if (num_keys == 0) {
+    vals->resize(0);
+    return;
+  }
+  third_party::SArray<Key> unique_keys;
+  std::vector<uint32_t> index;
+  SortUniqueKeys(keys, num_keys, &unique_keys, &index);
+  third_party::SArray<Val> unique_vals;
+  Get_(unique_keys, &unique_vals);
+  CHECK_EQ(unique_vals.size() % unique_keys.size(), 0);
+  const size_t val_width = unique_vals.size() / unique_keys.size();
+  vals->resize(num_keys * val_width);
+  for (size_t i = 0; i < num_keys; ++i)
+    memcpy(vals->data() + i * val_width, unique_vals.data() + index[i] * val_width, val_width * sizeof(Val));
+}
+
+template <typename Val>
+void KVClientTable<Val>::AddUnsorted(const std::vector<Key>& keys, const std::vector<Val>& vals) {
+  AddUnsorted_(keys.data(), keys.size(), vals.data(), vals.size());
+}
+
+template <typename Val>
+void KVClientTable<Val>::AddUnsorted(const third_party::SArray<Key>& keys, const third_party::SArray<Val>& vals) {
+  AddUnsorted_(keys.data(), keys.size(), vals.data(), vals.size());
+}
+
+template <typename Val>
+void KVClientTable<Val>::AddUnsorted_(const Key* keys, size_t num_keys, const Val* vals, size_t num_vals) {
+  if (num_keys == 0)
+    return;
+  CHECK_EQ(num_vals % num_keys, 0);
+  const size_t val_width = num_vals / num_keys;
+  third_party::SArray<Key> unique_keys;
+  std::vector<uint32_t> index;
+  SortUniqueKeys(keys, num_keys, &unique_keys, &index);
+  third_party::SArray<Val> unique_vals(unique_keys.size() * val_width, Val());
+  for (size_t i = 0; i < num_keys; ++i) {
+    for (size_t j = 0; j < val_width; ++j)
+      unique_vals[index[i] * val_width + j] += vals[i * val_width + j];
+  }
+  Add(unique_keys, unique_vals);
+}
+
+template <typename Val>
+void KVClientTable<Val>::GetView(const std::vector<Key>& keys, KVView<Val>* view) {
+  GetView(third_party::SArray<Key>(keys), view);
+}
+
+template <typename Val>
+void KVClientTable<Val>::GetView(const third_party::SArray<Key>& keys, KVView<Val>* view) {
+  KVPairs<char> kvs;
+  kvs.keys = keys;
+  std::vector<int> replica_of;
+  SlicedKVs sliced = kv_table_box_.SliceGet(kvs, &replica_of);
+  callback_runner_->RegisterRecvFinishHandle(kv_table_box_.app_thread_id_, kv_table_box_.model_id_, []() {});
+  callback_runner_->NewRequest(kv_table_box_.app_thread_id_, kv_table_box_.model_id_, sliced.size());
+  uint32_t request_id = kv_table_box_.SendGet(keys, sliced, replica_of);
+  callback_runner_->WaitRequest(kv_table_box_.app_thread_id_, kv_table_box_.model_id_);
+  kv_table_box_.HandleFinishView(request_id, keys, view);
+}
+
+template <typename Val>
+typename KVClientTable<Val>::Handle KVClientTable<Val>::GetAsync(const std::vector<Key>& keys,
+                                                                 std::vector<Val>* vals) {
+  return GetAsync_(third_party::SArray<Key>(keys), vals);
+}
+
+template <typename Val>
+typename KVClientTable<Val>::Handle KVClientTable<Val>::GetAsync(const third_party::SArray<Key>& keys,
+                                                                 third_party::SArray<Val>* vals) {
+  return GetAsync_(keys, vals);
+}
+
+template <typename Val>
+template <typename C>
+typename KVClientTable<Val>::Handle KVClientTable<Val>::GetAsync_(const third_party::SArray<Key>& keys, C* vals) {
+  KVPairs<char> kvs;
+  kvs.keys = keys;
+  std::vector<int> replica_of;
+  SlicedKVs sliced = kv_table_box_.SliceGet(kvs, &replica_of);
+  // The request must be known before its first reply
+  uint32_t request_id = kv_table_box_.NextRequestId();
+  callback_runner_->NewAsyncRequest(kv_table_box_.app_thread_id_, kv_table_box_.model_id_, request_id, sliced.size(),
+                                    [this, request_id, keys, vals]() {
+                                      kv_table_box_.HandleFinish(request_id, keys, vals);
+                                    });
+  kv_table_box_.SendGet(keys, sliced, replica_of, request_id);
+  return request_id;
+}
+
+template <typename Val>
+typename KVClientTable<Val>::Handle KVClientTable<Val>::AddAsync(const third_party::SArray<Key>& keys,
+                                                                 const third_party::SArray<Val>& vals) {
+  Add(keys, vals);
+  return 0;
+}
+
+template <typename Val>
+void KVClientTable<Val>::Wait(Handle handle) {
+  if (handle == 0)
+    return;
+  callback_runner_->WaitAsyncRequest(kv_table_box_.app_thread_id_, kv_table_box_.model_id_, handle);
 }
 
 template <typename Val>
 void KVClientTable<Val>::Clock() {
-  kv_table_box_.Clock();
+  if (!update_buffer_) {
+    kv_table_box_.Clock();
+    return;
+  }
+  // The Clock is held with the Adds, so that the Adds of a clock always reach the servers before its Clock
+  kv_table_box_.HoldClock();
+  adds_since_clock_ = false;
+  if (kv_table_box_.GetNumHeldClocks() > update_buffer_options_.max_delay_clocks)
+    Flush();
+}
+
+template <typename Val>
+void KVClientTable<Val>::EnableUpdateBuffer(const UpdateBufferOptions& options) {
+  CHECK_GE(options.max_delay_clocks, 0);
+  CHECK(!update_buffer_) << "The update buffer is already enabled";
+  update_buffer_options_ = options;
+  update_buffer_.reset(new UpdateBuffer<Val>());
+}
+
+template <typename Val>
+void KVClientTable<Val>::Flush() {
+  FlushAdds();
+  kv_table_box_.SendHeldClocks();
+}
+
+template <typename Val>
+void KVClientTable<Val>::FlushAdds() {
+  if (!update_buffer_ || update_buffer_->Empty())
+    return;
+  third_party::SArray<Key> keys;
+  third_party::SArray<Val> vals;
+  update_buffer_->Take(&keys, &vals);
+  kv_table_box_.Add(keys, vals);
 }
 
 }  // namespace flexps
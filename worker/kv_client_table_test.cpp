@@ -3,6 +3,8 @@
 
 #include "worker/kv_client_table.hpp"
 #include "worker/fake_callback_runner.hpp"
+#include "worker/hash_partition_manager.hpp"
+#include "worker/online_range_partition_manager.hpp"
 
 #include <condition_variable>
 #include <mutex>
@@ -226,6 +228,376 @@ TEST_F(TestKVClientTable, SArrayGet) {
   th.join();
 }
 
+TEST_F(TestKVClientTable, HashGet) {
+  ThreadsafeQueue<Message> queue;
+  HashPartitionManager manager({0, 1});
+  FakeCallbackRunner callback_runner(kTestAppThreadId, kTestModelId);
+  std::vector<Key> keys = {9, 2, 7, 4, 3};
+  std::thread th([&queue, &manager, &callback_runner, &keys]() {
+    KVClientTable<float> table(kTestAppThreadId, kTestModelId, &queue, &manager, &callback_runner);
+    std::vector<float> vals;
+    table.Get(keys, &vals);
+    // The server replies key * 0.5 in the order of the caller
+    ASSERT_EQ(vals.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+      EXPECT_EQ(vals[i], keys[i] * 0.5f);
+  });
+  KVPairs<char> kvs;
+  kvs.keys = third_party::SArray<Key>(keys);
+  size_t num_slices = manager.Slice(kvs).size();
+  for (size_t i = 0; i < num_slices; ++i) {
+    Message m;
+    queue.WaitAndPop(&m);
+    EXPECT_EQ(m.meta.flag, Flag::kGet);
+    third_party::SArray<Key> req_keys(m.data[0]);
+    third_party::SArray<float> rep_vals(req_keys.size());
+    for (size_t j = 0; j < req_keys.size(); ++j)
+      rep_vals[j] = req_keys[j] * 0.5f;
+    Message r;
+    r.meta.sender = m.meta.recver;
+    r.meta.req_id = m.meta.req_id;
+    r.AddData(rep_vals);
+    callback_runner.AddResponse(r);
+  }
+  th.join();
+}
+
+TEST_F(TestKVClientTable, KeylessGet) {
+  ThreadsafeQueue<Message> queue;
+  SimpleRangePartitionManager manager({{2, 4}, {4, 7}}, {0, 1});
+  FakeCallbackRunner callback_runner(kTestAppThreadId, kTestModelId);
+  std::thread th([&queue, &manager, &callback_runner]() {
+    KVClientTable<float> table(kTestAppThreadId, kTestModelId, &queue, &manager, &callback_runner);
+    third_party::SArray<Key> keys = {3, 4, 5, 6};
+    third_party::SArray<float> vals;
+    table.Get(keys, &vals);
+    ASSERT_EQ(vals.size(), 4);
+    EXPECT_EQ(vals[0], 0.1f);
+    EXPECT_EQ(vals[1], 0.4f);
+    EXPECT_EQ(vals[2], 0.2f);
+    EXPECT_EQ(vals[3], 0.3f);
+  });
+  Message m1, m2;
+  queue.WaitAndPop(&m1);
+  queue.WaitAndPop(&m2);
+  EXPECT_NE(m1.meta.req_id, 0);
+  EXPECT_NE(m2.meta.req_id, 0);
+  EXPECT_NE(m1.meta.req_id, m2.meta.req_id);
+
+  // The replies carry the values only, in any order
+  Message r1, r2;
+  r2.meta.req_id = m2.meta.req_id;
+  r2.AddData(third_party::SArray<float>({0.4, 0.2, 0.3}));
+  r1.meta.req_id = m1.meta.req_id;
+  r1.AddData(third_party::SArray<float>({0.1}));
+  callback_runner.AddResponse(r2);
+  callback_runner.AddResponse(r1);
+  th.join();
+}
+
+TEST_F(TestKVClientTable, GetView) {
+  ThreadsafeQueue<Message> queue;
+  HashPartitionManager manager({0, 1});
+  FakeCallbackRunner callback_runner(kTestAppThreadId, kTestModelId);
+  std::vector<Key> keys = {9, 2, 7, 4, 3};
+  std::vector<const float*> reply_data;
+  std::thread th([&queue, &manager, &callback_runner, &keys, &reply_data]() {
+    KVClientTable<float> table(kTestAppThreadId, kTestModelId, &queue, &manager, &callback_runner);
+    KVView<float> view;
+    table.GetView(keys, &view);
+    ASSERT_EQ(view.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+      EXPECT_EQ(view[i], keys[i] * 0.5f);
+    // The segments point into the replies
+    for (const auto& segment : view.GetSegments()) {
+      bool in_reply = false;
+      for (const float* data : reply_data)
+        in_reply = in_reply || (segment.vals.data() >= data && segment.vals.data() < data + keys.size());
+      EXPECT_TRUE(in_reply);
+    }
+    EXPECT_EQ(view.Flatten(), std::vector<float>({4.5, 1, 3.5, 2, 1.5}));
+  });
+  KVPairs<char> kvs;
+  kvs.keys = third_party::SArray<Key>(keys);
+  size_t num_slices = manager.Slice(kvs).size();
+  for (size_t i = 0; i < num_slices; ++i) {
+    Message m;
+    queue.WaitAndPop(&m);
+    third_party::SArray<Key> req_keys(m.data[0]);
+    third_party::SArray<float> rep_vals(req_keys.size());
+    for (size_t j = 0; j < req_keys.size(); ++j)
+      rep_vals[j] = req_keys[j] * 0.5f;
+    reply_data.push_back(rep_vals.data());
+    Message r;
+    r.meta.sender = m.meta.recver;
+    r.meta.req_id = m.meta.req_id;
+    r.AddData(rep_vals);
+    callback_runner.AddResponse(r);
+  }
+  th.join();
+}
+
+TEST_F(TestKVClientTable, UnsortedAdd) {
+  ThreadsafeQueue<Message> queue;
+  SimpleRangePartitionManager manager({{2, 4}, {4, 7}}, {0, 1});
+  FakeCallbackRunner callback_runner(kTestAppThreadId, kTestModelId);
+  KVClientTable<float> table(kTestAppThreadId, kTestModelId, &queue, &manager, &callback_runner);
+  table.AddUnsorted(std::vector<Key>({6, 3, 6, 4, 3}), std::vector<float>({1, 2, 3, 4, 5}));
+  Message m1, m2;
+  queue.WaitAndPop(&m1);
+  queue.WaitAndPop(&m2);
+  EXPECT_EQ(m1.meta.flag, Flag::kAdd);
+  EXPECT_EQ(m1.meta.recver, 0);
+  third_party::SArray<Key> res_keys(m1.data[0]);
+  third_party::SArray<float> res_vals(m1.data[1]);
+  ASSERT_EQ(res_keys.size(), 1);
+  EXPECT_EQ(res_keys[0], 3);
+  EXPECT_EQ(res_vals[0], 7);
+  EXPECT_EQ(m2.meta.recver, 1);
+  res_keys = m2.data[0];
+  res_vals = m2.data[1];
+  ASSERT_EQ(res_keys.size(), 2);
+  EXPECT_EQ(res_keys[0], 4);
+  EXPECT_EQ(res_keys[1], 6);
+  EXPECT_EQ(res_vals[0], 4);
+  EXPECT_EQ(res_vals[1], 4);
+}
+
+TEST_F(TestKVClientTable, UnsortedGet) {
+  ThreadsafeQueue<Message> queue;
+  SimpleRangePartitionManager manager({{2, 4}, {4, 7}}, {0, 1});
+  FakeCallbackRunner callback_runner(kTestAppThreadId, kTestModelId);
+  std::thread th([&queue, &manager, &callback_runner]() {
+    KVClientTable<float> table(kTestAppThreadId, kTestModelId, &queue, &manager, &callback_runner);
+    std::vector<float> vals;
+    table.GetUnsorted(std::vector<Key>({6, 3, 6, 4, 3}), &vals);
+    EXPECT_EQ(vals, std::vector<float>({0.6, 0.3, 0.6, 0.4, 0.3}));
+  });
+  for (int i = 0; i < 2; ++i) {
+    Message m;
+    queue.WaitAndPop(&m);
+    // Each distinct key is requested once, in order
+    third_party::SArray<Key> req_keys(m.data[0]);
+    third_party::SArray<float> rep_vals(req_keys.size());
+    for (size_t j = 0; j < req_keys.size(); ++j) {
+      if (j > 0) {
+        EXPECT_LT(req_keys[j - 1], req_keys[j]);
+      }
+      rep_vals[j] = req_keys[j] * 0.1f;
+    }
+    EXPECT_EQ(req_keys.size(), m.meta.recver == 0 ? 1 : 2);
+    Message r;
+    r.meta.req_id = m.meta.req_id;
+    r.AddData(rep_vals);
+    callback_runner.AddResponse(r);
+  }
+  th.join();
+}
+
+TEST_F(TestKVClientTable, CachedGet) {
+  ThreadsafeQueue<Message> queue;
+  SimpleRangePartitionManager manager({{2, 4}, {4, 7}}, {0, 1});
+  FakeCallbackRunner callback_runner(kTestAppThreadId, kTestModelId);
+  NodeCache<float> cache(1);
+  cache.Update(third_party::SArray<Key>({3, 4}), std::vector<float>({0.1, 0.4}).data(), 0);
+  std::thread th([&queue, &manager, &callback_runner, &cache]() {
+    KVClientTable<float> table(kTestAppThreadId, kTestModelId, &queue, &manager, &callback_runner, &cache);
+    third_party::SArray<Key> keys = {3, 4, 5, 6};
+    third_party::SArray<float> vals;
+    table.Get(keys, &vals);
+    ASSERT_EQ(vals.size(), 4);
+    EXPECT_EQ(vals[0], 0.1f);
+    EXPECT_EQ(vals[1], 0.4f);
+    EXPECT_EQ(vals[2], 0.2f);
+    EXPECT_EQ(vals[3], 0.3f);
+  });
+  // Only the misses are fetched
+  Message m;
+  queue.WaitAndPop(&m);
+  EXPECT_EQ(m.meta.recver, 1);
+  ASSERT_EQ(m.data.size(), 1);
+  third_party::SArray<Key> res_keys(m.data[0]);
+  ASSERT_EQ(res_keys.size(), 2);
+  EXPECT_EQ(res_keys[0], 5);
+  EXPECT_EQ(res_keys[1], 6);
+
+  Message r;
+  r.meta.req_id = m.meta.req_id;
+  r.meta.version = 2;
+  r.AddData(third_party::SArray<float>({0.2, 0.3}));
+  callback_runner.AddResponse(r);
+  th.join();
+  EXPECT_EQ(queue.Size(), 0);
+
+  // The replies are cached with the min clock of the servers
+  third_party::SArray<Key> miss_keys;
+  std::vector<uint32_t> miss_positions;
+  std::vector<float> cached(2);
+  cache.Lookup(third_party::SArray<Key>({5, 6}), 3, cached.data(), &miss_keys, &miss_positions);
+  EXPECT_TRUE(miss_keys.empty());
+  EXPECT_EQ(cached, std::vector<float>({0.2, 0.3}));
+}
+
+TEST_F(TestKVClientTable, BufferedAdd) {
+  ThreadsafeQueue<Message> queue;
+  SimpleRangePartitionManager manager({{2, 4}, {4, 7}}, {0, 1});
+  FakeCallbackRunner callback_runner(kTestAppThreadId, kTestModelId);
+  KVClientTable<float> table(kTestAppThreadId, kTestModelId, &queue, &manager, &callback_runner);
+  UpdateBufferOptions options;
+  options.max_delay_clocks = 1;
+  table.EnableUpdateBuffer(options);
+  table.Add(std::vector<Key>({3, 5}), std::vector<float>({0.1, 0.2}));
+  EXPECT_EQ(queue.Size(), 0);
+  // Within the delay, the Clock is held with the Adds
+  table.Clock();
+  EXPECT_EQ(queue.Size(), 0);
+  table.Add(std::vector<Key>({5, 6}), std::vector<float>({0.3, 0.4}));
+
+  // One merged Add per server, then the Clocks of the two clocks
+  table.Clock();
+  ASSERT_EQ(queue.Size(), 6);
+  Message m1, m2;
+  queue.WaitAndPop(&m1);
+  queue.WaitAndPop(&m2);
+  EXPECT_EQ(m1.meta.flag, Flag::kAdd);
+  EXPECT_EQ(m1.meta.recver, 0);
+  EXPECT_EQ(third_party::SArray<Key>(m1.data[0]).size(), 1);
+  EXPECT_EQ(m2.meta.flag, Flag::kAdd);
+  EXPECT_EQ(m2.meta.recver, 1);
+  third_party::SArray<Key> res_keys(m2.data[0]);
+  third_party::SArray<float> res_vals(m2.data[1]);
+  ASSERT_EQ(res_keys.size(), 2);
+  EXPECT_EQ(res_keys[0], 5);
+  EXPECT_EQ(res_keys[1], 6);
+  EXPECT_EQ(res_vals[0], 0.2f + 0.3f);
+  EXPECT_EQ(res_vals[1], 0.4f);
+  for (int i = 0; i < 4; ++i) {
+    Message m;
+    queue.WaitAndPop(&m);
+    EXPECT_EQ(m.meta.flag, Flag::kClock);
+  }
+
+  // Sent once the byte threshold is reached
+  options.max_bytes = 2 * (sizeof(Key) + sizeof(float));
+  KVClientTable<float> table2(kTestAppThreadId, kTestModelId, &queue, &manager, &callback_runner);
+  table2.EnableUpdateBuffer(options);
+  table2.Add(std::vector<Key>({3}), std::vector<float>({0.1}));
+  EXPECT_EQ(queue.Size(), 0);
+  table2.Add(std::vector<Key>({4}), std::vector<float>({0.1}));
+  EXPECT_EQ(queue.Size(), 2);
+  table2.Clock();
+}
+
+TEST_F(TestKVClientTable, BufferedAddGet) {
+  ThreadsafeQueue<Message> queue;
+  SimpleRangePartitionManager manager({{2, 4}, {4, 7}}, {0, 1});
+  FakeCallbackRunner callback_runner(kTestAppThreadId, kTestModelId);
+  KVClientTable<float> table(kTestAppThreadId, kTestModelId, &queue, &manager, &callback_runner);
+  UpdateBufferOptions options;
+  options.max_delay_clocks = 3;
+  table.EnableUpdateBuffer(options);
+  table.Add(std::vector<Key>({3}), std::vector<float>({0.1}));
+  table.Clock();
+  EXPECT_EQ(queue.Size(), 0);
+
+  // A Get leaves the Add and the held Clock buffered, and carries the real clock of the thread
+  std::vector<float> vals;
+  table.GetAsync(std::vector<Key>({5}), &vals);
+  ASSERT_EQ(queue.Size(), 1);
+  Message m;
+  queue.WaitAndPop(&m);
+  EXPECT_EQ(m.meta.flag, Flag::kGet);
+  EXPECT_EQ(m.meta.version, 1);
+}
+
+TEST_F(TestKVClientTable, BufferedAddGetLoop) {
+  ThreadsafeQueue<Message> queue;
+  SimpleRangePartitionManager manager({{2, 4}, {4, 7}}, {0, 1});
+  FakeCallbackRunner callback_runner(kTestAppThreadId, kTestModelId);
+  KVClientTable<float> table(kTestAppThreadId, kTestModelId, &queue, &manager, &callback_runner);
+  const int kDelay = 2;
+  UpdateBufferOptions options;
+  options.max_delay_clocks = kDelay;
+  table.EnableUpdateBuffer(options);
+  std::vector<float> vals;
+  int num_adds = 0;
+  for (int clock = 0; clock < 3 * (kDelay + 1); ++clock) {
+    table.GetAsync(std::vector<Key>({3, 5}), &vals);
+    table.Add(std::vector<Key>({3, 5}), std::vector<float>({1.0, 1.0}));
+    table.Clock();
+    bool flushed = (clock + 1) % (kDelay + 1) == 0;
+    // The two Gets, then on a flush one merged Add per server and the held Clocks
+    ASSERT_EQ(queue.Size(), flushed ? 2 + 2 + 2 * (kDelay + 1) : 2);
+    for (int i = 0; i < 2; ++i) {
+      Message m;
+      queue.WaitAndPop(&m);
+      EXPECT_EQ(m.meta.flag, Flag::kGet);
+      EXPECT_EQ(m.meta.version, clock);
+    }
+    if (!flushed)
+      continue;
+    for (int i = 0; i < 2; ++i) {
+      Message m;
+      queue.WaitAndPop(&m);
+      ASSERT_EQ(m.meta.flag, Flag::kAdd);
+      EXPECT_EQ(m.meta.recver, i);
+      third_party::SArray<float> res_vals(m.data[1]);
+      ASSERT_EQ(res_vals.size(), 1);
+      EXPECT_EQ(res_vals[0], 1.0f * (kDelay + 1));
+      num_adds += 1;
+    }
+    for (int i = 0; i < 2 * (kDelay + 1); ++i) {
+      Message m;
+      queue.WaitAndPop(&m);
+      EXPECT_EQ(m.meta.flag, Flag::kClock);
+    }
+  }
+  EXPECT_EQ(num_adds, 2 * 3);
+}
+
+TEST_F(TestKVClientTable, GetAsync) {
+  ThreadsafeQueue<Message> queue;
+  SimpleRangePartitionManager manager({{2, 4}, {4, 7}}, {0, 1});
+  FakeCallbackRunner callback_runner(kTestAppThreadId, kTestModelId);
+  KVClientTable<float> table(kTestAppThreadId, kTestModelId, &queue, &manager, &callback_runner);
+  third_party::SArray<float> vals1;
+  std::vector<float> vals2;
+  auto h1 = table.GetAsync(third_party::SArray<Key>({3, 4}), &vals1);
+  auto h2 = table.GetAsync(std::vector<Key>({5}), &vals2);
+  EXPECT_NE(h1, h2);
+  Message m1, m2, m3;
+  queue.WaitAndPop(&m1);
+  queue.WaitAndPop(&m2);
+  queue.WaitAndPop(&m3);
+  EXPECT_EQ(m3.meta.recver, 1);
+
+  // The replies of the two Gets interleave
+  Message r3;
+  r3.meta.req_id = m3.meta.req_id;
+  r3.AddData(third_party::SArray<float>({0.5}));
+  callback_runner.AddResponse(r3);
+  table.Wait(h2);
+  EXPECT_EQ(vals2, std::vector<float>({0.5}));
+
+  std::thread th([&table, h1]() { table.Wait(h1); });
+  Message r1, r2;
+  r2.meta.req_id = m2.meta.req_id;
+  r2.AddData(third_party::SArray<float>({0.4}));
+  r1.meta.req_id = m1.meta.req_id;
+  r1.AddData(third_party::SArray<float>({0.3}));
+  callback_runner.AddResponse(r2);
+  callback_runner.AddResponse(r1);
+  th.join();
+  ASSERT_EQ(vals1.size(), 2);
+  EXPECT_EQ(vals1[0], 0.3f);
+  EXPECT_EQ(vals1[1], 0.4f);
+
+  table.Wait(table.AddAsync(third_party::SArray<Key>({3}), third_party::SArray<float>({0.1})));
+  Message add;
+  queue.WaitAndPop(&add);
+  EXPECT_EQ(add.meta.flag, Flag::kAdd);
+}
+
 TEST_F(TestKVClientTable, Clock) {
   ThreadsafeQueue<Message> queue;
   SimpleRangePartitionManager manager({{2, 4}, {4, 7}}, {0, 1});
@@ -247,5 +619,40 @@ TEST_F(TestKVClientTable, Clock) {
   EXPECT_EQ(m2.meta.flag, Flag::kClock);
 }
 
+
+TEST_F(TestKVClientTable, OnlineLayout) {
+  ThreadsafeQueue<Message> queue;
+  std::unique_ptr<SimpleRangePartitionManager> layout(new SimpleRangePartitionManager({{2, 4}, {4, 7}}, {0, 1}));
+  OnlineRangePartitionManager manager(std::move(layout), 2);
+  FakeCallbackRunner callback_runner(kTestAppThreadId, kTestModelId);
+  KVClientTable<float> table(kTestAppThreadId, kTestModelId, &queue, &manager, &callback_runner);
+  std::vector<Key> keys = {3, 4};
+  std::vector<float> vals = {0.1, 0.1};
+  table.Add(keys, vals);  // version 0: {3, 4} -> {3}, {4}
+  Message m1, m2;
+  queue.WaitAndPop(&m1);
+  queue.WaitAndPop(&m2);
+  EXPECT_EQ(m1.meta.layout_version, 0);
+  EXPECT_EQ(m2.meta.layout_version, 0);
+  EXPECT_EQ(m2.meta.recver, 1);
+
+  table.Clock();
+  table.Clock();
+  for (int i = 0; i < 4; ++i)
+    queue.WaitAndPop(&m1);
+  // Clock 2 uses version 1, the Add waits until it is announced
+  std::thread th([&table, &keys, &vals] { table.Add(keys, vals); });
+  manager.AddLayout(1, {{2, 5}, {5, 7}});
+  th.join();
+  queue.WaitAndPop(&m1);  // version 1: {3, 4} -> server 0
+  EXPECT_EQ(m1.meta.flag, Flag::kAdd);
+  EXPECT_EQ(m1.meta.recver, 0);
+  EXPECT_EQ(m1.meta.layout_version, 1);
+  third_party::SArray<Key> res_keys(m1.data[0]);
+  ASSERT_EQ(res_keys.size(), 2);
+  EXPECT_EQ(res_keys[1], 4);
+  EXPECT_EQ(queue.Size(), 0);
+}
+
 }  // namespace
 }  // namespace flexps
@@ -6,12 +6,19 @@
 #include "base/third_party/sarray.h"
 #include "base/threadsafe_queue.hpp"
 
+#include "worker/abstract_callback_runner.hpp"
+#include "worker/add_combiner.hpp"
 #include "worker/kvpairs.hpp"
+#include "worker/kv_view.hpp"
+#include "worker/online_range_partition_manager.hpp"
 #include "worker/simple_range_manager.hpp"
 
 #include "glog/logging.h"
 
 #include <algorithm>
+#include <limits>
+#include <map>
+#include <mutex>
 #include <vector>
 
 namespace flexps {
@@ -22,8 +29,9 @@ namespace flexps {
 template <typename Val>
 class KVTableBox {
  public:
+  // The Adds and Clocks go through add_combiner if it is given, see worker/add_combiner.hpp
   KVTableBox(uint32_t app_thread_id, uint32_t model_id, ThreadsafeQueue<Message>* const send_queue,
-             const AbstractPartitionManager* const partition_manager);
+             const AbstractPartitionManager* const partition_manager, AddCombiner<Val>* const add_combiner = nullptr);
   KVTableBox(const KVTableBox&) = delete;
   KVTableBox& operator=(const KVTableBox&) = delete;
   KVTableBox(KVTableBox&& other) = delete;
@@ -33,17 +41,63 @@ class KVTableBox {
 
   void Clock();
   void Send(const SlicedKVs& sliced, bool is_add);
-  void SendChunk(const SlicedKVs& sliced, bool is_add);
+  /*
+   * Send the Get slices of keys, the slices to replicas (see AbstractPartitionManager::SliceGet) carry their owners.
+   * The Gets request key-less replies, see HandleMsg(). Return the id of the request (see MakeReqId()),
+   * which is request_id if given, or the next one.
+   */
+  uint32_t SendGet(const third_party::SArray<Key>& keys, const SlicedKVs& sliced, const std::vector<int>& replica_of,
+                   uint32_t request_id = 0);
+  // Allocate the id of a request
+  uint32_t NextRequestId();
+  // keys is the sliced input, only needed for a Get
+  void SendChunk(const SlicedKVs& sliced, bool is_add, const third_party::SArray<Key>& keys = {});
   void Add(const third_party::SArray<Key>& keys, const third_party::SArray<Val>& vals);
   void AddChunk(const third_party::SArray<Key>& keys, const third_party::SArray<Val>& vals);
   SlicedKVs Slice(const KVPairs<char>& send);
+  SlicedKVs SliceGet(const KVPairs<char>& send, std::vector<int>* replica_of);
   SlicedKVs SliceChunk(const KVPairs<char>& send);
+  /*
+   * The layout the requests are sliced with: the partition manager, or if it is an OnlineRangePartitionManager,
+   * the layout of the clock of the thread, waiting for it to be announced by the server threads.
+   * The sent requests carry its version in meta.layout_version.
+   */
+  const AbstractPartitionManager* GetLayout();
+  uint32_t GetLayoutVersion() const;
   
+  /*
+   * A Get reply is either key-less (the values only, tagged with the req_id of its slice), or carries the keys
+   * as well (req_id 0). A key-less reply is placed by the offset or positions of its slice in the Get,
+   * recorded when the slice is sent, so the replies are half the size for 4-byte values.
+   *
+   * The replies of several outstanding Gets are kept apart by their request ids, HandleMsg() may run on
+   * another thread than the one sending the Gets.
+   */
   void HandleMsg(Message& msg);
+  // Assemble the values of the Get with request_id
+  template <typename C>
+  void HandleFinish(uint32_t request_id, const third_party::SArray<Key>& keys, C* vals);
+  // Assemble the values of the last Get
   template <typename C>
   void HandleFinish(const third_party::SArray<Key>& keys, C* vals);
+  // Build a view over the replies of the Get with request_id instead of copying them out
+  void HandleFinishView(uint32_t request_id, const third_party::SArray<Key>& keys, KVView<Val>* view);
   template <typename C>
   void HandleChunkFinish(const third_party::SArray<Key>& keys, std::vector<C*> &vals);
+  // Write the chunk of keys[i] to vals + i * row_stride directly, the chunks must have chunk_size values
+  void HandleChunkFinish(const third_party::SArray<Key>& keys, Val* vals, size_t chunk_size, size_t row_stride);
+  // Write the chunks row-major to *vals
+  void HandleChunkFinish(const third_party::SArray<Key>& keys, third_party::SArray<Val>* vals);
+
+  // The number of Clock() and HoldClock() calls so far, i.e. the progress of the thread in the table.
+  // The Gets carry it in meta.version, as the servers may not have received the held Clocks yet.
+  int GetClock() const { return clock_ + held_clocks_; }
+  // Advance the clock without sending the Clock, until SendHeldClocks(), see KVClientTable::EnableUpdateBuffer
+  void HoldClock() { held_clocks_ += 1; }
+  void SendHeldClocks();
+  int GetNumHeldClocks() const { return held_clocks_; }
+  // The min version tagged on the Get replies received since the last call, see NodeCache
+  int TakeReplyClock();
   
   uint32_t app_thread_id_;
   uint32_t model_id_;
@@ -53,17 +107,52 @@ class KVTableBox {
   ThreadsafeQueue<Message>* const send_queue_;
   // Not owned.
   const AbstractPartitionManager* const partition_manager_;
+  // partition_manager_ if the table is rebalanced online, nullptr otherwise
+  const OnlineRangePartitionManager* const online_manager_;
+  // Not owned, may be nullptr.
+  AddCombiner<Val>* const add_combiner_;
 
+  // Where the values of a key-less reply go in the Get: at positions, or from offset if positions is empty
+  struct Placement {
+    size_t offset = 0;
+    third_party::SArray<uint32_t> positions;
+  };
+  Placement Place(const third_party::SArray<Key>& keys, const KVPairs<char>& slice) const;
+  using KeylessReplies = std::vector<std::pair<Placement, third_party::SArray<Val>>>;
+  // Add the values of the keys at positions to view, one segment per run of consecutive positions
+  static void AddRuns(const uint32_t* positions, size_t num_keys, const third_party::SArray<Val>& vals,
+                      size_t val_width, KVView<Val>* view);
+  // get_row(i, chunk_size) gives where the chunk of keys[i] goes
+  template <typename RowFunc>
+  void HandleChunkFinish_(const third_party::SArray<Key>& keys, RowFunc get_row);
+  // Take the replies received for request_id
+  void TakeReplies(uint32_t request_id, KeylessReplies* keyless, std::vector<KVPairs<Val>>* recv_kvs);
+
+  // Protects the fields below, which are accessed by HandleMsg()
+  std::mutex mu_;
+  // The replies with keys, of the only outstanding Get
   std::vector<KVPairs<Val>> recv_kvs_;
+  // The Get slices in flight by req_id, and the key-less replies received by request id
+  std::map<uint32_t, Placement> placements_;
+  std::map<uint32_t, KeylessReplies> recv_keyless_;
+  uint32_t next_request_id_ = 1;
+  uint32_t last_request_id_ = 0;
+  // The Clocks sent, and those held after them
+  int clock_ = 0;
+  int held_clocks_ = 0;
+  int reply_clock_ = std::numeric_limits<int>::max();
 };
 
 template <typename Val>
 KVTableBox<Val>::KVTableBox(uint32_t app_thread_id, uint32_t model_id, ThreadsafeQueue<Message>* const send_queue,
-                            const AbstractPartitionManager* const partition_manager)
+                            const AbstractPartitionManager* const partition_manager,
+                            AddCombiner<Val>* const add_combiner)
     : app_thread_id_(app_thread_id),
       model_id_(model_id),
       send_queue_(send_queue),
-      partition_manager_(partition_manager) {}
+      partition_manager_(partition_manager),
+      online_manager_(dynamic_cast<const OnlineRangePartitionManager*>(partition_manager)),
+      add_combiner_(add_combiner) {}
 
 // SArray version Add
 template <typename Val>
@@ -71,8 +160,7 @@ void KVTableBox<Val>::Add(const third_party::SArray<Key>& keys, const third_part
   KVPairs<char> kvs;
   kvs.keys = keys;
   kvs.vals = vals;
-  CHECK_NOTNULL(partition_manager_);
-  SlicedKVs sliced = partition_manager_->Slice(kvs);
+  SlicedKVs sliced = GetLayout()->Slice(kvs);
   Send(sliced, true);
 }
 
@@ -81,27 +169,111 @@ void KVTableBox<Val>::AddChunk(const third_party::SArray<Key>& keys, const third
   KVPairs<char> kvs;
   kvs.keys = keys;
   kvs.vals = vals;
-  CHECK_NOTNULL(partition_manager_);
-  SlicedKVs sliced = partition_manager_->SliceChunk(kvs);
+  SlicedKVs sliced = GetLayout()->SliceChunk(kvs);
   SendChunk(sliced, true);
 }
 
 
 template <typename Val>
 typename KVTableBox<Val>::SlicedKVs KVTableBox<Val>::Slice(const KVPairs<char>& send) {
-  CHECK_NOTNULL(partition_manager_);
-  return partition_manager_->Slice(send);
+  return GetLayout()->Slice(send);
+}
+
+template <typename Val>
+typename KVTableBox<Val>::SlicedKVs KVTableBox<Val>::SliceGet(const KVPairs<char>& send, std::vector<int>* replica_of) {
+  return GetLayout()->SliceGet(send, replica_of);
+}
+
+template <typename Val>
+uint32_t KVTableBox<Val>::SendGet(const third_party::SArray<Key>& keys, const SlicedKVs& sliced,
+                                  const std::vector<int>& replica_of, uint32_t request_id) {
+  CHECK_EQ(sliced.size(), replica_of.size());
+  CHECK_LT(sliced.size(), 1u << kReqIdSliceBits);
+  if (request_id == 0)
+    request_id = NextRequestId();
+  for (size_t i = 0; i < sliced.size(); ++i) {
+    Message msg;
+    msg.meta.sender = app_thread_id_;
+    msg.meta.recver = sliced[i].first;
+    msg.meta.model_id = model_id_;
+    msg.meta.flag = replica_of[i] == -1 ? Flag::kGet : Flag::kGetReplica;
+    msg.meta.version = GetClock();
+    msg.meta.req_id = MakeReqId(request_id, i);
+    msg.meta.layout_version = GetLayoutVersion();
+    const auto& kvs = sliced[i].second;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      placements_[msg.meta.req_id] = Place(keys, kvs);
+    }
+    if (kvs.keys.size()) {
+      msg.AddData(kvs.keys);
+      if (replica_of[i] != -1) {
+        msg.AddData(third_party::SArray<uint32_t>({static_cast<uint32_t>(replica_of[i])}));
+      }
+    }
+    send_queue_->Push(std::move(msg));
+  }
+  return request_id;
+}
+
+template <typename Val>
+typename KVTableBox<Val>::Placement KVTableBox<Val>::Place(const third_party::SArray<Key>& keys,
+                                                           const KVPairs<char>& slice) const {
+  Placement placement;
+  if (!slice.positions.empty()) {
+    placement.positions = slice.positions;
+  } else if (slice.keys.empty() || (slice.keys.data() >= keys.data() && slice.keys.data() < keys.data() + keys.size())) {
+    // A segment of the sorted keys, as sliced by range
+    placement.offset = slice.keys.empty() ? 0 : slice.keys.data() - keys.data();
+  } else {
+    // A slice built from a subset of the sorted keys, e.g. the hot keys sent to a replica
+    const Key* pos = keys.begin();
+    for (auto key : slice.keys) {
+      pos = std::lower_bound(pos, keys.end(), key);
+      CHECK(pos != keys.end() && *pos == key) << "sliced key not in the Get: " << key;
+      placement.positions.push_back(pos - keys.begin());
+    }
+  }
+  return placement;
+}
+
+template <typename Val>
+uint32_t KVTableBox<Val>::NextRequestId() {
+  // 0 is reserved for the replies with keys
+  if (next_request_id_ >= (1u << (32 - kReqIdSliceBits)))
+    next_request_id_ = 1;
+  last_request_id_ = next_request_id_++;
+  return last_request_id_;
+}
+
+template <typename Val>
+void KVTableBox<Val>::TakeReplies(uint32_t request_id, KeylessReplies* keyless, std::vector<KVPairs<Val>>* recv_kvs) {
+  std::lock_guard<std::mutex> lk(mu_);
+  auto it = recv_keyless_.find(request_id);
+  if (it != recv_keyless_.end()) {
+    keyless->swap(it->second);
+    recv_keyless_.erase(it);
+  } else {
+    recv_kvs->swap(recv_kvs_);
+  }
 }
 
 template <typename Val>
 void KVTableBox<Val>::Send(const SlicedKVs& sliced, bool is_add) {
   CHECK_NOTNULL(partition_manager_);
+  if (is_add && add_combiner_) {
+    add_combiner_->Add(app_thread_id_, clock_, sliced);
+    return;
+  }
   for (size_t i = 0; i < sliced.size(); ++i) {
     Message msg;
     msg.meta.sender = app_thread_id_;
     msg.meta.recver = sliced[i].first;
     msg.meta.model_id = model_id_;
     msg.meta.flag = is_add ? Flag::kAdd : Flag::kGet;
+    if (!is_add)
+      msg.meta.version = GetClock();
+    msg.meta.layout_version = GetLayoutVersion();
     const auto& kvs = sliced[i].second;
     if (kvs.keys.size()) {
       msg.AddData(kvs.keys);
@@ -115,20 +287,27 @@ void KVTableBox<Val>::Send(const SlicedKVs& sliced, bool is_add) {
 
 template <typename Val>
 typename KVTableBox<Val>::SlicedKVs KVTableBox<Val>::SliceChunk(const KVPairs<char>& send) {
-  CHECK_NOTNULL(partition_manager_);
-  return partition_manager_->SliceChunk(send);
+  return GetLayout()->SliceChunk(send);
 }
 
 template <typename Val>
-void KVTableBox<Val>::SendChunk(const SlicedKVs& sliced, bool is_add) {
+void KVTableBox<Val>::SendChunk(const SlicedKVs& sliced, bool is_add, const third_party::SArray<Key>& keys) {
   CHECK_NOTNULL(partition_manager_);
+  const uint32_t request_id = is_add ? 0 : NextRequestId();
   for (size_t i = 0; i < sliced.size(); ++i) {
     Message msg;
     msg.meta.sender = app_thread_id_;
     msg.meta.recver = sliced[i].first;
     msg.meta.model_id = model_id_;
     msg.meta.flag = is_add ? Flag::kAddChunk : Flag::kGetChunk;
+    msg.meta.layout_version = GetLayoutVersion();
     const auto& kvs = sliced[i].second;
+    if (!is_add) {
+      msg.meta.version = GetClock();
+      msg.meta.req_id = MakeReqId(request_id, i);
+      std::lock_guard<std::mutex> lk(mu_);
+      placements_[msg.meta.req_id] = Place(keys, kvs);
+    }
     if (kvs.keys.size()) {
       msg.AddData(kvs.keys);
       if (is_add) {
@@ -144,18 +323,66 @@ template <typename Val>
 void KVTableBox<Val>::Clock() {
   CHECK_NOTNULL(partition_manager_);
   const auto& server_thread_ids = partition_manager_->GetServerThreadIds();
+  std::vector<Message> clock_msgs;
   for (uint32_t server_id : server_thread_ids) {
     Message msg;
     msg.meta.sender = app_thread_id_;
     msg.meta.recver = server_id;
     msg.meta.model_id = model_id_;
     msg.meta.flag = Flag::kClock;
-    send_queue_->Push(std::move(msg));
+    clock_msgs.push_back(std::move(msg));
+  }
+  if (add_combiner_) {
+    add_combiner_->Clock(app_thread_id_, clock_, std::move(clock_msgs));
+  } else {
+    for (auto& msg : clock_msgs)
+      send_queue_->Push(std::move(msg));
   }
+  clock_ += 1;
+}
+
+template <typename Val>
+const AbstractPartitionManager* KVTableBox<Val>::GetLayout() {
+  CHECK_NOTNULL(partition_manager_);
+  if (online_manager_ == nullptr)
+    return partition_manager_;
+  // The layout follows the Clocks sent, not the held ones: the server threads switch once they have the Clocks
+  return online_manager_->WaitLayout(GetLayoutVersion());
+}
+
+template <typename Val>
+uint32_t KVTableBox<Val>::GetLayoutVersion() const {
+  CHECK_NOTNULL(partition_manager_);
+  return online_manager_ ? online_manager_->GetVersionAt(clock_) : partition_manager_->GetVersion();
+}
+
+template <typename Val>
+void KVTableBox<Val>::SendHeldClocks() {
+  for (; held_clocks_ > 0; --held_clocks_)
+    Clock();
+}
+
+template <typename Val>
+int KVTableBox<Val>::TakeReplyClock() {
+  std::lock_guard<std::mutex> lk(mu_);
+  int reply_clock = reply_clock_;
+  reply_clock_ = std::numeric_limits<int>::max();
+  return reply_clock;
 }
 
 template <typename Val>
 void KVTableBox<Val>::HandleMsg(Message& msg) {
+  std::lock_guard<std::mutex> lk(mu_);
+  reply_clock_ = std::min(reply_clock_, static_cast<int>(msg.meta.version));
+  if (msg.meta.req_id != 0) {
+    CHECK_EQ(msg.data.size(), 1);
+    auto it = placements_.find(msg.meta.req_id);
+    CHECK(it != placements_.end()) << "unexpected req_id: " << msg.meta.req_id;
+    recv_keyless_[GetRequestId(msg.meta.req_id)].push_back(
+        std::make_pair(it->second, third_party::SArray<Val>(msg.data[0])));
+    placements_.erase(it);
+    return;
+  }
   CHECK_EQ(msg.data.size(), 2);
   KVPairs<Val> kvs;
   kvs.keys = msg.data[0];
@@ -166,31 +393,187 @@ void KVTableBox<Val>::HandleMsg(Message& msg) {
 template <typename Val>
 template <typename C>
 void KVTableBox<Val>::HandleFinish(const third_party::SArray<Key>& keys, C* vals) {
+  HandleFinish(last_request_id_, keys, vals);
+}
+
+template <typename Val>
+template <typename C>
+void KVTableBox<Val>::HandleFinish(uint32_t request_id, const third_party::SArray<Key>& keys, C* vals) {
+  CHECK_NOTNULL(vals);
+  KeylessReplies recv_keyless;
+  std::vector<KVPairs<Val>> recv_kvs;
+  TakeReplies(request_id, &recv_keyless, &recv_kvs);
+  if (!recv_keyless.empty()) {
+    CHECK(recv_kvs.empty()) << "mixed key-less replies and replies with keys";
+    size_t total_val = 0;
+    for (const auto& r : recv_keyless)
+      total_val += r.second.size();
+    CHECK_EQ(total_val % keys.size(), 0) << "lost some servers?";
+    const size_t val_width = total_val / keys.size();
+    vals->resize(total_val);
+    for (const auto& r : recv_keyless) {
+      const Placement& placement = r.first;
+      const auto& reply_vals = r.second;
+      if (placement.positions.empty()) {
+        CHECK_LE((placement.offset * val_width + reply_vals.size()), total_val);
+        memcpy(vals->data() + placement.offset * val_width, reply_vals.data(), reply_vals.size() * sizeof(Val));
+      } else {
+        CHECK_EQ(placement.positions.size() * val_width, reply_vals.size());
+        for (size_t i = 0; i < placement.positions.size(); ++i) {
+          memcpy(vals->data() + placement.positions[i] * val_width, reply_vals.data() + i * val_width,
+                 val_width * sizeof(Val));
+        }
+      }
+    }
+    return;
+  }
   size_t total_key = 0, total_val = 0;
-  for (const auto& s : recv_kvs_) {
+  bool contiguous = true;
+  for (const auto& s : recv_kvs) {
     third_party::Range range = third_party::FindRange(keys, s.keys.front(), s.keys.back() + 1);
-    CHECK_EQ(range.size(), s.keys.size()) << "unmatched keys size from one server";
+    contiguous = contiguous && range.size() == s.keys.size();
     total_key += s.keys.size();
     total_val += s.vals.size();
   }
   CHECK_EQ(total_key, keys.size()) << "lost some servers?";
-  std::sort(recv_kvs_.begin(), recv_kvs_.end(),
+  if (!contiguous) {
+    // Some keys are served by replicas, so the replies interleave in keys
+    vals->resize(total_val);
+    const size_t val_width = total_val / total_key;
+    for (const auto& s : recv_kvs) {
+      const Key* pos = keys.begin();
+      for (size_t i = 0; i < s.keys.size(); ++i) {
+        pos = std::lower_bound(pos, keys.end(), s.keys[i]);
+        CHECK(pos != keys.end() && *pos == s.keys[i]) << "unmatched keys from one server";
+        memcpy(vals->data() + (pos - keys.begin()) * val_width, s.vals.data() + i * val_width,
+               val_width * sizeof(Val));
+      }
+    }
+    return;
+  }
+  std::sort(recv_kvs.begin(), recv_kvs.end(),
             [](const KVPairs<Val>& a, const KVPairs<Val>& b) { return a.keys.front() < b.keys.front(); });
-  CHECK_NOTNULL(vals);
   vals->resize(total_val);
   Val* p_vals = vals->data();
-  for (const auto& s : recv_kvs_) {
+  for (const auto& s : recv_kvs) {
     memcpy(p_vals, s.vals.data(), s.vals.size() * sizeof(Val));
     p_vals += s.vals.size();
   }
-  recv_kvs_.clear();
+}
+
+template <typename Val>
+void KVTableBox<Val>::AddRuns(const uint32_t* positions, size_t num_keys, const third_party::SArray<Val>& vals,
+                              size_t val_width, KVView<Val>* view) {
+  CHECK_EQ(num_keys * val_width, vals.size());
+  size_t begin = 0;
+  for (size_t i = 1; i <= num_keys; ++i) {
+    if (i == num_keys || positions[i] != positions[i - 1] + 1) {
+      view->AddSegment(positions[begin] * val_width, vals.segment(begin * val_width, i * val_width));
+      begin = i;
+    }
+  }
+}
+
+template <typename Val>
+void KVTableBox<Val>::HandleFinishView(uint32_t request_id, const third_party::SArray<Key>& keys,
+                                       KVView<Val>* view) {
+  CHECK_NOTNULL(view);
+  view->Clear();
+  KeylessReplies recv_keyless;
+  std::vector<KVPairs<Val>> recv_kvs;
+  TakeReplies(request_id, &recv_keyless, &recv_kvs);
+  if (keys.empty()) {
+    view->Finish(0);
+    return;
+  }
+  size_t total_val = 0;
+  for (const auto& r : recv_keyless)
+    total_val += r.second.size();
+  for (const auto& s : recv_kvs)
+    total_val += s.vals.size();
+  CHECK_EQ(total_val % keys.size(), 0) << "lost some servers?";
+  const size_t val_width = total_val / keys.size();
+  for (const auto& r : recv_keyless) {
+    const Placement& placement = r.first;
+    if (placement.positions.empty()) {
+      view->AddSegment(placement.offset * val_width, r.second);
+    } else {
+      AddRuns(placement.positions.data(), placement.positions.size(), r.second, val_width, view);
+    }
+  }
+  for (const auto& s : recv_kvs) {
+    std::vector<uint32_t> positions(s.keys.size());
+    const Key* pos = keys.begin();
+    for (size_t i = 0; i < s.keys.size(); ++i) {
+      pos = std::lower_bound(pos, keys.end(), s.keys[i]);
+      CHECK(pos != keys.end() && *pos == s.keys[i]) << "unmatched keys from one server";
+      positions[i] = pos - keys.begin();
+    }
+    AddRuns(positions.data(), positions.size(), s.vals, val_width, view);
+  }
+  view->Finish(total_val);
 }
 
 template <typename Val>
 template <typename C>
 void KVTableBox<Val>::HandleChunkFinish(const third_party::SArray<Key>& keys, std::vector<C*>& vals) {
+  HandleChunkFinish_(keys, [&vals](size_t idx, size_t chunk_size) {
+    CHECK_LT(idx, vals.size());
+    vals[idx]->resize(chunk_size);
+    return vals[idx]->data();
+  });
+}
+
+template <typename Val>
+void KVTableBox<Val>::HandleChunkFinish(const third_party::SArray<Key>& keys, Val* vals, size_t chunk_size,
+                                        size_t row_stride) {
+  CHECK_NOTNULL(vals);
+  CHECK_LE(chunk_size, row_stride);
+  HandleChunkFinish_(keys, [&keys, vals, chunk_size, row_stride](size_t idx, size_t reply_chunk_size) {
+    CHECK_EQ(reply_chunk_size, chunk_size) << "unexpected chunk size";
+    CHECK_LT(idx, keys.size());
+    return vals + idx * row_stride;
+  });
+}
+
+template <typename Val>
+void KVTableBox<Val>::HandleChunkFinish(const third_party::SArray<Key>& keys, third_party::SArray<Val>* vals) {
+  CHECK_NOTNULL(vals);
+  HandleChunkFinish_(keys, [&keys, vals](size_t idx, size_t chunk_size) {
+    if (vals->size() != keys.size() * chunk_size)
+      vals->resize(keys.size() * chunk_size);
+    CHECK_LT(idx, keys.size());
+    return vals->data() + idx * chunk_size;
+  });
+}
+
+template <typename Val>
+template <typename RowFunc>
+void KVTableBox<Val>::HandleChunkFinish_(const third_party::SArray<Key>& keys, RowFunc get_row) {
+  KeylessReplies recv_keyless;
+  std::vector<KVPairs<Val>> recv_kvs;
+  TakeReplies(last_request_id_, &recv_keyless, &recv_kvs);
+  if (!recv_keyless.empty()) {
+    CHECK(recv_kvs.empty()) << "mixed key-less replies and replies with keys";
+    size_t total_val = 0;
+    for (const auto& r : recv_keyless)
+      total_val += r.second.size();
+    CHECK_EQ(total_val % keys.size(), 0) << "lost some servers?";
+    const size_t chunk_size = total_val / keys.size();
+    for (const auto& r : recv_keyless) {
+      const Placement& placement = r.first;
+      const auto& reply_vals = r.second;
+      const size_t num_keys = reply_vals.size() / chunk_size;
+      CHECK(placement.positions.empty() || placement.positions.size() == num_keys);
+      for (size_t i = 0; i < num_keys; ++i) {
+        size_t idx = placement.positions.empty() ? placement.offset + i : placement.positions[i];
+        memcpy(get_row(idx, chunk_size), reply_vals.data() + i * chunk_size, chunk_size * sizeof(Val));
+      }
+    }
+    return;
+  }
   size_t total_key = 0, total_val = 0;
-  for (const auto& s : recv_kvs_) {
+  for (const auto& s : recv_kvs) {
     third_party::Range range = third_party::FindRange(keys, s.keys.front(), s.keys.back() + 1);
     CHECK_EQ(range.size(), s.keys.size()) << "unmatched keys size from one server";
     total_key += s.keys.size();
@@ -198,19 +581,17 @@ void KVTableBox<Val>::HandleChunkFinish(const third_party::SArray<Key>& keys, st
   }
   size_t chunk_size = total_val / total_key;
   CHECK_EQ(total_key, keys.size()) << "lost some servers?";
-  std::sort(recv_kvs_.begin(), recv_kvs_.end(),
+  std::sort(recv_kvs.begin(), recv_kvs.end(),
             [](const KVPairs<Val>& a, const KVPairs<Val>& b) { return a.keys.front() < b.keys.front(); });
   int idx = 0;
-  for (const auto& s : recv_kvs_) {
+  for (const auto& s : recv_kvs) {
     int start = 0;
     for (int i = 0; i < s.keys.size(); ++ i) {
-      vals[idx]->resize(chunk_size);
-      memcpy(vals[idx]->data(), s.vals.data()+start, chunk_size*sizeof(Val));
+      memcpy(get_row(idx, chunk_size), s.vals.data()+start, chunk_size*sizeof(Val));
       start += chunk_size;
       idx += 1;
     }
   }
-  recv_kvs_.clear();
 }
 
 
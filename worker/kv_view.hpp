@@ -0,0 +1,84 @@
+#pragma once
+
+#include "base/third_party/sarray.h"
+
+#include "glog/logging.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace flexps {
+
+/*
+ * A read-only view of the values of a Get, see KVClientTable::GetView.
+ *
+ * The values are kept in the received reply buffers, each segment shares the buffer of a reply (or a part
+ * of it) without copying. Value i of the view is value i of the Get, i.e. value i % val_width of key
+ * i / val_width for val_width values per key.
+ *
+ * The view keeps the reply buffers alive, it stays valid after the next Get.
+ */
+template <typename Val>
+class KVView {
+ public:
+  // The values [offset, offset + vals.size()) of the view
+  struct Segment {
+    size_t offset;
+    third_party::SArray<Val> vals;
+  };
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // O(log(#segments))
+  const Val& operator[](size_t i) const {
+    CHECK_LT(i, size_);
+    auto it = std::upper_bound(segments_.begin(), segments_.end(), i,
+                               [](size_t idx, const Segment& s) { return idx < s.offset; });
+    --it;
+    return it->vals[i - it->offset];
+  }
+
+  // The segments in the order of their offsets, for iterating over the values without lookups
+  const std::vector<Segment>& GetSegments() const { return segments_; }
+
+  // Copy the values out, only when a contiguous array is needed
+  void CopyTo(Val* out) const {
+    for (const auto& s : segments_)
+      memcpy(out + s.offset, s.vals.data(), s.vals.size() * sizeof(Val));
+  }
+  std::vector<Val> Flatten() const {
+    std::vector<Val> vals(size_);
+    CopyTo(vals.data());
+    return vals;
+  }
+
+  void Clear() {
+    segments_.clear();
+    size_ = 0;
+  }
+  // Used to build the view, vals must not overlap the other segments
+  void AddSegment(size_t offset, const third_party::SArray<Val>& vals) {
+    if (!vals.empty())
+      segments_.push_back({offset, vals});
+  }
+  // Sort the segments added, CHECK that they cover [0, size) exactly
+  void Finish(size_t size) {
+    std::sort(segments_.begin(), segments_.end(),
+              [](const Segment& a, const Segment& b) { return a.offset < b.offset; });
+    size_t next = 0;
+    for (const auto& s : segments_) {
+      CHECK_EQ(s.offset, next) << "the segments of the view overlap or leave a gap";
+      next += s.vals.size();
+    }
+    CHECK_EQ(next, size) << "lost some servers?";
+    size_ = size;
+  }
+
+ private:
+  std::vector<Segment> segments_;
+  size_t size_ = 0;
+};
+
+}  // namespace flexps
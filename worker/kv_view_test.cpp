@@ -0,0 +1,46 @@
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+
+#include "worker/kv_view.hpp"
+
+namespace flexps {
+namespace {
+
+class TestKVView : public testing::Test {
+ public:
+  TestKVView() {}
+  ~TestKVView() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+TEST_F(TestKVView, Segments) {
+  third_party::SArray<int> a({1, 2, 3});
+  third_party::SArray<int> b({4, 5});
+  third_party::SArray<int> c({6});
+  KVView<int> view;
+  // Added out of order, b is split into two segments
+  view.AddSegment(4, b.segment(0, 1));
+  view.AddSegment(0, c);
+  view.AddSegment(1, a);
+  view.AddSegment(5, b.segment(1, 2));
+  view.Finish(6);
+  ASSERT_EQ(view.size(), 6);
+  std::vector<int> expected{6, 1, 2, 3, 4, 5};
+  for (size_t i = 0; i < expected.size(); ++i)
+    EXPECT_EQ(view[i], expected[i]);
+  EXPECT_EQ(view.Flatten(), expected);
+
+  ASSERT_EQ(view.GetSegments().size(), 4);
+  EXPECT_EQ(view.GetSegments()[1].offset, 1);
+  EXPECT_EQ(view.GetSegments()[1].vals.data(), a.data());
+  EXPECT_EQ(view.GetSegments()[3].vals.data(), b.data() + 1);
+
+  view.Clear();
+  EXPECT_TRUE(view.empty());
+}
+
+}  // namespace
+}  // namespace flexps
@@ -9,6 +9,9 @@ template <typename Val>
 struct KVPairs {
   third_party::SArray<Key> keys;
   third_party::SArray<Val> vals;
+  // The index of each key in the input it is sliced from. Set only by the partition managers whose
+  // slices are not contiguous segments of sorted input keys (see HashPartitionManager).
+  third_party::SArray<uint32_t> positions;
 };
 
 }  // namespace flexps
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "base/magic.hpp"
+#include "base/third_party/sarray.h"
+
+#include "glog/logging.h"
+
+#include <atomic>
+#include <cinttypes>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace flexps {
+
+/*
+ * The statistics of a NodeCache, in keys.
+ * bytes_saved counts the key sent and the value replied for each hit.
+ */
+struct NodeCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t bytes_saved = 0;
+
+  double GetHitRate() const { return hits + misses == 0 ? 0. : static_cast<double>(hits) / (hits + misses); }
+};
+
+class AbstractNodeCache {
+ public:
+  virtual ~AbstractNodeCache() {}
+  virtual NodeCacheStats GetStats() const = 0;
+  // Drop all the values, the clocks of a new task start from 0 again
+  virtual void Clear() = 0;
+};
+
+/*
+ * The parameter cache of an SSP table shared by the worker threads of a node, in the style of the
+ * process cache of Petuum/Bosen.
+ *
+ * A cached value is tagged with the min clock of the server that replied it, i.e. it has all the
+ * Adds of the clocks before. The Get of a worker at clock c may use it if the tag is at least
+ * c - staleness, the same bound as the server applies to the Get. So the worker threads of a node
+ * read the keys fetched by one another, and only the misses go to the servers.
+ * As allowed by SSP, a hit may miss the recent Adds of the worker itself.
+ *
+ * Thread-safe, the keys are sharded over kNumShards locks.
+ */
+template <typename Val>
+class NodeCache : public AbstractNodeCache {
+ public:
+  explicit NodeCache(int staleness) : staleness_(staleness) {}
+
+  /*
+   * Fill vals[i] of the keys[i] fresh enough for a worker at clock, and return the misses:
+   * the keys (a sorted subset if keys is sorted) and their positions in keys.
+   */
+  void Lookup(const third_party::SArray<Key>& keys, int clock, Val* vals, third_party::SArray<Key>* miss_keys,
+              std::vector<uint32_t>* miss_positions);
+  // Cache the values replied by the servers at the given min clock
+  void Update(const third_party::SArray<Key>& keys, const Val* vals, int clock);
+
+  virtual NodeCacheStats GetStats() const override;
+  virtual void Clear() override;
+
+  static const int kNumShards = 16;
+
+ private:
+  struct Entry {
+    int clock;
+    Val val;
+  };
+  struct Shard {
+    std::mutex mu;
+    std::unordered_map<Key, Entry> entries;
+  };
+  Shard& GetShard(Key key) { return shards_[key % kNumShards]; }
+
+  const int staleness_;
+  Shard shards_[kNumShards];
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+};
+
+template <typename Val>
+void NodeCache<Val>::Lookup(const third_party::SArray<Key>& keys, int clock, Val* vals,
+                            third_party::SArray<Key>* miss_keys, std::vector<uint32_t>* miss_positions) {
+  const int min_clock = clock - staleness_;
+  miss_keys->clear();
+  miss_positions->clear();
+  for (size_t i = 0; i < keys.size(); ++i) {
+    Shard& shard = GetShard(keys[i]);
+    std::lock_guard<std::mutex> lk(shard.mu);
+    auto it = shard.entries.find(keys[i]);
+    if (it != shard.entries.end() && it->second.clock >= min_clock) {
+      vals[i] = it->second.val;
+    } else {
+      miss_keys->push_back(keys[i]);
+      miss_positions->push_back(i);
+    }
+  }
+  hits_ += keys.size() - miss_keys->size();
+  misses_ += miss_keys->size();
+}
+
+template <typename Val>
+void NodeCache<Val>::Update(const third_party::SArray<Key>& keys, const Val* vals, int clock) {
+  for (size_t i = 0; i < keys.size(); ++i) {
+    Shard& shard = GetShard(keys[i]);
+    std::lock_guard<std::mutex> lk(shard.mu);
+    auto it = shard.entries.find(keys[i]);
+    if (it == shard.entries.end()) {
+      shard.entries.emplace(keys[i], Entry{clock, vals[i]});
+    } else if (it->second.clock <= clock) {  // replies may arrive out of order, keep the fresher one
+      it->second = Entry{clock, vals[i]};
+    }
+  }
+}
+
+template <typename Val>
+NodeCacheStats NodeCache<Val>::GetStats() const {
+  NodeCacheStats stats;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  stats.bytes_saved = stats.hits * (sizeof(Key) + sizeof(Val));
+  return stats;
+}
+
+template <typename Val>
+void NodeCache<Val>::Clear() {
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lk(shard.mu);
+    shard.entries.clear();
+  }
+}
+
+}  // namespace flexps
@@ -0,0 +1,98 @@
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+
+#include "worker/node_cache.hpp"
+
+#include <thread>
+
+namespace flexps {
+namespace {
+
+class TestNodeCache : public testing::Test {
+ public:
+  TestNodeCache() {}
+  ~TestNodeCache() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+TEST_F(TestNodeCache, LookupMisses) {
+  NodeCache<float> cache(2);
+  cache.Update(third_party::SArray<Key>({1, 3}), std::vector<float>({0.1, 0.3}).data(), 5);
+
+  third_party::SArray<Key> keys({1, 2, 3, 4});
+  std::vector<float> vals(keys.size());
+  third_party::SArray<Key> miss_keys;
+  std::vector<uint32_t> miss_positions;
+  cache.Lookup(keys, 7, vals.data(), &miss_keys, &miss_positions);
+  EXPECT_EQ(vals[0], 0.1f);
+  EXPECT_EQ(vals[2], 0.3f);
+  ASSERT_EQ(miss_keys.size(), 2);
+  EXPECT_EQ(miss_keys[0], 2);
+  EXPECT_EQ(miss_keys[1], 4);
+  EXPECT_EQ(miss_positions, std::vector<uint32_t>({1, 3}));
+
+  NodeCacheStats stats = cache.GetStats();
+  EXPECT_EQ(stats.hits, 2);
+  EXPECT_EQ(stats.misses, 2);
+  EXPECT_EQ(stats.bytes_saved, 2 * (sizeof(Key) + sizeof(float)));
+  EXPECT_EQ(stats.GetHitRate(), 0.5);
+}
+
+TEST_F(TestNodeCache, Staleness) {
+  NodeCache<int> cache(2);
+  cache.Update(third_party::SArray<Key>({1}), std::vector<int>({10}).data(), 3);
+
+  third_party::SArray<Key> keys({1});
+  int val = 0;
+  third_party::SArray<Key> miss_keys;
+  std::vector<uint32_t> miss_positions;
+  // A worker at clock 5 may read the values with all the Adds before clock 3
+  cache.Lookup(keys, 5, &val, &miss_keys, &miss_positions);
+  EXPECT_TRUE(miss_keys.empty());
+  EXPECT_EQ(val, 10);
+  // But not at clock 6
+  cache.Lookup(keys, 6, &val, &miss_keys, &miss_positions);
+  EXPECT_EQ(miss_keys.size(), 1);
+
+  // An older reply does not overwrite a fresher value
+  cache.Update(keys, std::vector<int>({20}).data(), 4);
+  cache.Update(keys, std::vector<int>({30}).data(), 2);
+  cache.Lookup(keys, 6, &val, &miss_keys, &miss_positions);
+  EXPECT_TRUE(miss_keys.empty());
+  EXPECT_EQ(val, 20);
+
+  cache.Clear();
+  cache.Lookup(keys, 0, &val, &miss_keys, &miss_positions);
+  EXPECT_EQ(miss_keys.size(), 1);
+}
+
+TEST_F(TestNodeCache, Concurrent) {
+  NodeCache<int> cache(0);
+  const int kNumThreads = 4;
+  const int kNumKeys = 1000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&cache, t]() {
+      third_party::SArray<Key> keys;
+      for (int i = 0; i < kNumKeys; ++i)
+        keys.push_back(i);
+      std::vector<int> vals(kNumKeys, t);
+      cache.Update(keys, vals.data(), t);
+      third_party::SArray<Key> miss_keys;
+      std::vector<uint32_t> miss_positions;
+      cache.Lookup(keys, t, vals.data(), &miss_keys, &miss_positions);
+      EXPECT_TRUE(miss_keys.empty());
+      for (auto val : vals)
+        EXPECT_GE(val, t);
+    });
+  }
+  for (auto& th : threads)
+    th.join();
+  EXPECT_EQ(cache.GetStats().hits, kNumThreads * kNumKeys);
+}
+
+}  // namespace
+}  // namespace flexps
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "base/third_party/range.h"
+#include "worker/abstract_partition_manager.hpp"
+#include "worker/simple_range_manager.hpp"
+
+#include "glog/logging.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace flexps {
+
+/*
+ * The layouts of a range partitioned table rebalanced online, see KVEngine::EnableOnlineRebalance.
+ *
+ * A new layout takes effect every rebalance_clocks clocks of a task: a thread slices its requests at clock k
+ * with the layout of version GetVersionAt(k) = base + k / rebalance_clocks, where base is the version at the
+ * start of the task (GetVersion()). The server threads switch to a version once all the worker threads have
+ * clocked to it and announce the new layout, the worker helper thread calls AddLayout() while the app threads
+ * are slicing. A thread needing a layout not announced yet waits in WaitLayout().
+ *
+ * Slice() and SliceChunk() use the latest layout, they are not for the KVClientTables of a running task.
+ */
+class OnlineRangePartitionManager : public AbstractPartitionManager {
+ public:
+  OnlineRangePartitionManager(std::unique_ptr<SimpleRangePartitionManager>&& layout, int rebalance_clocks)
+      : AbstractPartitionManager(layout->GetServerThreadIds()), rebalance_clocks_(rebalance_clocks) {
+    CHECK_GT(rebalance_clocks_, 0);
+    version_ = layout->GetVersion();
+    latest_version_ = version_;
+    layouts_[version_] = std::move(layout);
+  }
+
+  SlicedKVs Slice(const KVPairs<char>& kvs) const override { return GetLatestLayout()->Slice(kvs); }
+  SlicedKVs SliceChunk(const KVPairs<char>& kvs) const override { return GetLatestLayout()->SliceChunk(kvs); }
+
+  int GetRebalanceClocks() const { return rebalance_clocks_; }
+  // The version of the layout at clock of the running task
+  uint32_t GetVersionAt(int clock) const { return version_ + clock / rebalance_clocks_; }
+
+  // Return nullptr if version is not announced yet, thread-safe
+  const SimpleRangePartitionManager* GetLayout(uint32_t version) const {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = layouts_.find(version);
+    return it == layouts_.end() ? nullptr : it->second.get();
+  }
+
+  const SimpleRangePartitionManager* WaitLayout(uint32_t version) const {
+    std::unique_lock<std::mutex> lk(mu_);
+    cond_.wait(lk, [this, version] { return layouts_.find(version) != layouts_.end(); });
+    return layouts_.find(version)->second.get();
+  }
+
+  const SimpleRangePartitionManager* GetLatestLayout() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return layouts_.find(latest_version_)->second.get();
+  }
+
+  // Thread-safe
+  void AddLayout(uint32_t version, const std::vector<third_party::Range>& ranges) {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (layouts_.find(version) != layouts_.end())
+      return;
+    const auto* latest = layouts_.find(latest_version_)->second.get();
+    layouts_[version].reset(
+        new SimpleRangePartitionManager(ranges, server_thread_ids_, latest->GetChunkSize(), version));
+    latest_version_ = std::max(latest_version_, version);
+    cond_.notify_all();
+  }
+
+  // Start a task from version, waits until it is announced. Not thread-safe with the app threads.
+  void StartTask(uint32_t version) {
+    WaitLayout(version);
+    version_ = version;
+  }
+
+ private:
+  const int rebalance_clocks_;
+
+  mutable std::mutex mu_;
+  mutable std::condition_variable cond_;
+  std::map<uint32_t, std::unique_ptr<SimpleRangePartitionManager>> layouts_;
+  uint32_t latest_version_;
+};
+
+}  // namespace flexps
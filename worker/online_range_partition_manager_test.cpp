@@ -0,0 +1,73 @@
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "worker/online_range_partition_manager.hpp"
+
+#include <thread>
+
+namespace flexps {
+namespace {
+
+class TestOnlineRangePartitionManager : public testing::Test {
+ public:
+  TestOnlineRangePartitionManager() {}
+  ~TestOnlineRangePartitionManager() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+std::unique_ptr<SimpleRangePartitionManager> CreateLayout(uint32_t version) {
+  return std::unique_ptr<SimpleRangePartitionManager>(
+      new SimpleRangePartitionManager({{0, 10}, {10, 20}}, {0, 1}, 1, version));
+}
+
+TEST_F(TestOnlineRangePartitionManager, GetVersionAt) {
+  OnlineRangePartitionManager manager(CreateLayout(2), 3);
+  EXPECT_EQ(manager.GetVersion(), 2);
+  EXPECT_EQ(manager.GetVersionAt(0), 2);
+  EXPECT_EQ(manager.GetVersionAt(2), 2);
+  EXPECT_EQ(manager.GetVersionAt(3), 3);
+  EXPECT_EQ(manager.GetVersionAt(7), 4);
+  EXPECT_EQ(manager.GetLayout(3), nullptr);
+}
+
+TEST_F(TestOnlineRangePartitionManager, AddLayout) {
+  OnlineRangePartitionManager manager(CreateLayout(0), 1);
+  manager.AddLayout(1, {{0, 5}, {5, 20}});
+  // An announced version is not replaced
+  manager.AddLayout(1, {{0, 15}, {15, 20}});
+  const auto* layout = manager.GetLayout(1);
+  ASSERT_NE(layout, nullptr);
+  EXPECT_EQ(layout->GetVersion(), 1);
+  EXPECT_EQ(layout->GetRanges()[0].end(), 5);
+  EXPECT_EQ(manager.GetLatestLayout(), layout);
+
+  KVPairs<char> kvs;
+  kvs.keys = third_party::SArray<Key>({3, 7});
+  kvs.vals = third_party::SArray<char>({1, 2});
+  auto sliced = manager.Slice(kvs);  // the latest layout: {3} -> 0, {7} -> 1
+  ASSERT_EQ(sliced.size(), 2);
+  EXPECT_EQ(sliced[1].first, 1);
+  EXPECT_EQ(sliced[1].second.keys[0], 7);
+}
+
+TEST_F(TestOnlineRangePartitionManager, WaitLayout) {
+  OnlineRangePartitionManager manager(CreateLayout(0), 1);
+  std::thread th([&manager] {
+    const auto* layout = manager.WaitLayout(2);
+    EXPECT_EQ(layout->GetVersion(), 2);
+  });
+  manager.AddLayout(1, {{0, 5}, {5, 20}});
+  manager.AddLayout(2, {{0, 8}, {8, 20}});
+  th.join();
+
+  // The next task starts from version 2
+  manager.StartTask(2);
+  EXPECT_EQ(manager.GetVersion(), 2);
+  EXPECT_EQ(manager.GetVersionAt(1), 3);
+}
+
+}  // namespace
+}  // namespace flexps
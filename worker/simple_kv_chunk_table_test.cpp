@@ -159,5 +159,29 @@ TEST_F(TestSimpleKVChunkTable, VectorChunkGet) {
   th.join();
 }
 
+TEST_F(TestSimpleKVChunkTable, SArrayChunkGet) {
+  ThreadsafeQueue<Message> queue;
+  SimpleRangePartitionManager manager({{0, 40}, {40, 90}}, {0, 1}, 10);
+  FakeMailbox fake_mailbox;
+  std::thread th([&queue, &manager, &fake_mailbox]() {
+    SimpleKVChunkTable<float> table(kTestAppThreadId, kTestModelId, &queue, &manager, &fake_mailbox);
+    third_party::SArray<Key> keys = {3, 4, 5};
+    third_party::SArray<float> vals;
+    table.GetChunk(keys, &vals);  // {3, 4, 5} -> {3}, {4, 5}
+    EXPECT_EQ(std::vector<float>(vals.begin(), vals.end()), std::vector<float>({0.3, 0.3, 0.4, 0.4, 0.5, 0.5}));
+  });
+  Message m1, m2;
+  queue.WaitAndPop(&m1);
+  queue.WaitAndPop(&m2);
+  Message r1, r2;
+  r1.AddData(third_party::SArray<Key>({3}));
+  r1.AddData(third_party::SArray<float>({0.3, 0.3}));
+  r2.AddData(third_party::SArray<Key>({4, 5}));
+  r2.AddData(third_party::SArray<float>({0.4, 0.4, 0.5, 0.5}));
+  fake_mailbox.Send(r2);
+  fake_mailbox.Send(r1);
+  th.join();
+}
+
 }  // namespace
 }  // namespace flexps
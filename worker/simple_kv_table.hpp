@@ -98,12 +98,13 @@ void SimpleKVTable<Val>::Get_(const third_party::SArray<Key>& keys, C* vals) {
   KVPairs<char> kvs;
   kvs.keys = keys;
   // 1. slice
-  SlicedKVs sliced = kv_table_box_.Slice(kvs);
+  std::vector<int> replica_of;
+  SlicedKVs sliced = kv_table_box_.SliceGet(kvs, &replica_of);
   // 2. get num requests
   expected_responses = sliced.size();
   current_responses = 0;
   // 3. send
-  kv_table_box_.Send(sliced, false);
+  kv_table_box_.SendGet(keys, sliced, replica_of);
   // 4. wait request
   while (current_responses < expected_responses) {
     Message msg;
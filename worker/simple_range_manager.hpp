@@ -15,13 +15,16 @@ namespace flexps {
 class SimpleRangePartitionManager : public AbstractPartitionManager {
  public:
   SimpleRangePartitionManager(const std::vector<third_party::Range>& ranges,
-                              const std::vector<uint32_t>& server_thread_ids, uint32_t chunk_size = 1)
+                              const std::vector<uint32_t>& server_thread_ids, uint32_t chunk_size = 1,
+                              uint32_t version = 0)
       : AbstractPartitionManager(server_thread_ids), ranges_(ranges), chunk_size_(chunk_size) {
     CHECK_EQ(ranges_.size(), server_thread_ids_.size());
+    version_ = version;
   }
 
   size_t GetNumServers() const { return ranges_.size(); }
   const std::vector<third_party::Range>& GetRanges() const { return ranges_; }
+  uint32_t GetChunkSize() const { return chunk_size_; }
   const std::vector<uint32_t>& GetServerThreadIds() const { return server_thread_ids_; }
 
   // slice key-value pairs into <server_id, key_value_partition> pairs
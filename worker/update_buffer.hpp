@@ -0,0 +1,79 @@
+#pragma once
+
+#include "base/magic.hpp"
+#include "base/third_party/sarray.h"
+
+#include "glog/logging.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace flexps {
+
+/*
+ * max_delay_clocks: the Clocks are held with the buffered Adds, and both are sent at the latest at the
+ *   Clock() that ends the clock max_delay_clocks after the one the Adds are added in, the Adds first.
+ *   0 sends them at every Clock(), which merges the Adds of an iteration. A Get does not send them:
+ *   it carries the real clock of the thread (see KVTableBox::GetClock), which the servers check the
+ *   staleness against instead of the clocks they have received. As the Adds of a clock always reach
+ *   the servers before its Clock, and a held Clock is at most max_delay_clocks <= staleness behind,
+ *   the Gets of the other threads still see the Adds the staleness bound requires. With d > 0 the
+ *   Adds of a later clock may reach the servers before the Clock of an earlier one, which BSP does
+ *   not allow, see KVEngine::EnableUpdateBuffer.
+ * max_bytes: the buffered Adds are sent (without the held Clocks) once they take this many bytes of
+ *   keys and values.
+ */
+struct UpdateBufferOptions {
+  int max_delay_clocks = 0;
+  size_t max_bytes = 1 << 20;
+};
+
+/*
+ * The write-back buffer of the Adds of a worker thread, see KVClientTable::EnableUpdateBuffer.
+ * The Adds to the same key are summed, so a flush sends each key once.
+ *
+ * Not thread-safe, owned by one KVClientTable.
+ */
+template <typename Val>
+class UpdateBuffer {
+ public:
+  void Add(const third_party::SArray<Key>& keys, const third_party::SArray<Val>& vals) {
+    CHECK_EQ(keys.size(), vals.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      auto it = updates_.find(keys[i]);
+      if (it == updates_.end())
+        updates_.emplace(keys[i], vals[i]);
+      else
+        it->second += vals[i];
+    }
+    num_added_ += keys.size();
+  }
+
+  bool Empty() const { return updates_.empty(); }
+  size_t GetBytes() const { return updates_.size() * (sizeof(Key) + sizeof(Val)); }
+  // The number of key-value pairs added since the last Take()
+  size_t GetNumAdded() const { return num_added_; }
+
+  // Move out the merged Adds in key order
+  void Take(third_party::SArray<Key>* keys, third_party::SArray<Val>* vals) {
+    std::vector<std::pair<Key, Val>> updates(updates_.begin(), updates_.end());
+    std::sort(updates.begin(), updates.end(),
+              [](const std::pair<Key, Val>& a, const std::pair<Key, Val>& b) { return a.first < b.first; });
+    keys->resize(updates.size());
+    vals->resize(updates.size());
+    for (size_t i = 0; i < updates.size(); ++i) {
+      (*keys)[i] = updates[i].first;
+      (*vals)[i] = updates[i].second;
+    }
+    updates_.clear();
+    num_added_ = 0;
+  }
+
+ private:
+  std::unordered_map<Key, Val> updates_;
+  size_t num_added_ = 0;
+};
+
+}  // namespace flexps
@@ -0,0 +1,46 @@
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+
+#include "worker/update_buffer.hpp"
+
+namespace flexps {
+namespace {
+
+class TestUpdateBuffer : public testing::Test {
+ public:
+  TestUpdateBuffer() {}
+  ~TestUpdateBuffer() {}
+
+ protected:
+  void SetUp() {}
+  void TearDown() {}
+};
+
+TEST_F(TestUpdateBuffer, MergeAndTake) {
+  UpdateBuffer<float> buffer;
+  EXPECT_TRUE(buffer.Empty());
+  buffer.Add(third_party::SArray<Key>({7, 2, 5}), third_party::SArray<float>({0.5, 1.0, 2.0}));
+  buffer.Add(third_party::SArray<Key>({2, 9}), third_party::SArray<float>({1.5, 3.0}));
+  EXPECT_FALSE(buffer.Empty());
+  EXPECT_EQ(buffer.GetNumAdded(), 5);
+  EXPECT_EQ(buffer.GetBytes(), 4 * (sizeof(Key) + sizeof(float)));
+
+  third_party::SArray<Key> keys;
+  third_party::SArray<float> vals;
+  buffer.Take(&keys, &vals);
+  ASSERT_EQ(keys.size(), 4);
+  ASSERT_EQ(vals.size(), 4);
+  EXPECT_EQ(keys[0], 2);
+  EXPECT_EQ(keys[1], 5);
+  EXPECT_EQ(keys[2], 7);
+  EXPECT_EQ(keys[3], 9);
+  EXPECT_EQ(vals[0], 2.5f);
+  EXPECT_EQ(vals[1], 2.0f);
+  EXPECT_EQ(vals[2], 0.5f);
+  EXPECT_EQ(vals[3], 3.0f);
+  EXPECT_TRUE(buffer.Empty());
+  EXPECT_EQ(buffer.GetNumAdded(), 0);
+}
+
+}  // namespace
+}  // namespace flexps
@@ -14,6 +14,19 @@ ThreadsafeQueue<Message>* WorkerHelperThread::GetWorkQueue() { return &work_queu
 
 uint32_t WorkerHelperThread::GetHelperId() const { return helper_id_; }
 
+void WorkerHelperThread::RegisterReplicaSyncHandle(uint32_t model_id, const std::function<void(Message&)>& handle) {
+  RegisterHandle(Flag::kReplicaSync, model_id, handle);
+}
+
+void WorkerHelperThread::RegisterLayoutHandle(uint32_t model_id, const std::function<void(Message&)>& handle) {
+  RegisterHandle(Flag::kLayout, model_id, handle);
+}
+
+void WorkerHelperThread::RegisterHandle(Flag flag, uint32_t model_id, const std::function<void(Message&)>& handle) {
+  std::lock_guard<std::mutex> lk(handles_mu_);
+  handles_[std::make_pair(flag, model_id)] = handle;
+}
+
 void WorkerHelperThread::Main() {
   while (true) {
     Message msg;
@@ -22,6 +35,15 @@ void WorkerHelperThread::Main() {
     if (msg.meta.flag == Flag::kExit)
       break;
 
+    if (msg.meta.flag == Flag::kReplicaSync || msg.meta.flag == Flag::kLayout) {
+      std::lock_guard<std::mutex> lk(handles_mu_);
+      auto it = handles_.find(std::make_pair(msg.meta.flag, static_cast<uint32_t>(msg.meta.model_id)));
+      CHECK(it != handles_.end()) << "No " << FlagName[static_cast<int>(msg.meta.flag)] << " handle for model "
+                                  << msg.meta.model_id;
+      it->second(msg);
+      continue;
+    }
+
     CHECK_NOTNULL(receiver_);
     receiver_->AddResponse(msg.meta.recver, msg.meta.model_id, msg);
   }
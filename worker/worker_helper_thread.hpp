@@ -5,9 +5,11 @@
 #include "worker/abstract_receiver.hpp"
 
 #include <condition_variable>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <thread>
-#include <unordered_map>
 
 namespace flexps {
 
@@ -20,15 +22,24 @@ class WorkerHelperThread {
   void Stop();
   ThreadsafeQueue<Message>* GetWorkQueue();
   uint32_t GetHelperId() const;
+  // Handle the hot keys announced by the server threads (Flag::kReplicaSync) of model_id
+  void RegisterReplicaSyncHandle(uint32_t model_id, const std::function<void(Message&)>& handle);
+  // Handle the layouts announced by the server threads (Flag::kLayout) of model_id
+  void RegisterLayoutHandle(uint32_t model_id, const std::function<void(Message&)>& handle);
 
  private:
   void Main();
+  void RegisterHandle(Flag flag, uint32_t model_id, const std::function<void(Message&)>& handle);
 
   uint32_t helper_id_;
   std::thread work_thread_;
   ThreadsafeQueue<Message> work_queue_;
 
   AbstractReceiver* const receiver_;
+
+  // The handles of the announcements of the server threads, by flag and model_id
+  std::mutex handles_mu_;
+  std::map<std::pair<Flag, uint32_t>, std::function<void(Message&)>> handles_;
 };
 
 }  // namespace flexps